@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdint.h>
+#include <time.h>
 
 #if HAVE_IO_H
 #include <io.h>
@@ -59,6 +60,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/time.h"
 #include "libavutil/threadmessage.h"
+#include "libavutil/trace.h"
 #include "libavcodec/mathops.h"
 #include "libavformat/os_support.h"
 
@@ -131,6 +133,7 @@ static int64_t decode_error_stat[2];
 
 static int current_time;
 AVIOContext *progress_avio = NULL;
+AVIOContext *stats_avio = NULL;
 
 static uint8_t *subtitle_out;
 
@@ -456,6 +459,25 @@ static int decode_interrupt_cb(void *ctx)
 
 const AVIOInterruptCB int_cb = { decode_interrupt_cb, NULL };
 
+static void write_trace(void)
+{
+    AVIOContext *pb;
+    AVBPrint bp;
+
+    av_trace_set_enabled(0);
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (av_trace_export_json(&bp) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Out of memory exporting the trace\n");
+    } else if (avio_open2(&pb, trace_filename, AVIO_FLAG_WRITE, NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open trace file '%s'\n", trace_filename);
+    } else {
+        avio_write(pb, bp.str, bp.len);
+        avio_closep(&pb);
+    }
+    av_bprint_finalize(&bp, NULL);
+    av_freep(&trace_filename);
+}
+
 static void ffmpeg_cleanup(int ret)
 {
     int i, j;
@@ -558,6 +580,9 @@ static void ffmpeg_cleanup(int ret)
         fclose(vstats_file);
     av_freep(&vstats_filename);
 
+    if (trace_filename)
+        write_trace();
+
     av_freep(&input_streams);
     av_freep(&input_files);
     av_freep(&output_streams);
@@ -617,6 +642,33 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+static int64_t getthreadtime(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+#endif
+    return getutime();
+}
+
+static void stage_time_start(StageTime *t)
+{
+    if (stats_avio) {
+        t->wall_start = av_gettime_relative();
+        t->cpu_start  = getthreadtime();
+    }
+}
+
+static void stage_time_stop(StageTime *t)
+{
+    if (stats_avio) {
+        t->wall += av_gettime_relative() - t->wall_start;
+        t->cpu  += getthreadtime()       - t->cpu_start;
+    }
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
@@ -833,10 +885,12 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+    stage_time_start(&ost->encode_time);
     if (avcodec_encode_audio2(enc, &pkt, frame, &got_packet) < 0) {
         av_log(NULL, AV_LOG_FATAL, "Audio encoding failed (avcodec_encode_audio2)\n");
         exit_program(1);
     }
+    stage_time_stop(&ost->encode_time);
     update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
 
     if (got_packet) {
@@ -1060,6 +1114,7 @@ static void do_video_out(AVFormatContext *s,
 
     if (nb0_frames == 0 && ost->last_droped) {
         nb_frames_drop++;
+        ost->frames_drop++;
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
@@ -1068,9 +1123,11 @@ static void do_video_out(AVFormatContext *s,
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
             nb_frames_drop++;
+            ost->frames_drop++;
             return;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_droped) - (nb_frames > nb0_frames);
+        nb_frames_dup    += nb_frames - (nb0_frames && ost->last_droped) - (nb_frames > nb0_frames);
+        ost->frames_dup  += nb_frames - (nb0_frames && ost->last_droped) - (nb_frames > nb0_frames);
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
     }
     ost->last_droped = nb_frames == nb0_frames && next_picture;
@@ -1185,7 +1242,9 @@ static void do_video_out(AVFormatContext *s,
 
         ost->frames_encoded++;
 
+        stage_time_start(&ost->encode_time);
         ret = avcodec_encode_video2(enc, &pkt, in_picture, &got_packet);
+        stage_time_stop(&ost->encode_time);
         update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
@@ -1328,8 +1387,10 @@ static int reap_filters(int flush)
 
         while (1) {
             double float_pts = AV_NOPTS_VALUE; // this is identical to filtered_frame.pts but with higher precision
+            stage_time_start(&ost->filter_time);
             ret = av_buffersink_get_frame_flags(filter, filtered_frame,
                                                AV_BUFFERSINK_FLAG_NO_REQUEST);
+            stage_time_stop(&ost->filter_time);
             if (ret < 0) {
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
@@ -1516,6 +1577,83 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_stage_time(AVBPrint *buf, const char *name, const StageTime *t)
+{
+    av_bprintf(buf, ",\"%s_us\":%"PRId64",\"%s_cpu_us\":%"PRId64,
+               name, t->wall, name, t->cpu);
+}
+
+static void print_stats_json(int is_last_report, int64_t timer_start, int64_t cur_time)
+{
+    static int64_t last_time = -1;
+    double elapsed  = (cur_time - timer_start) / 1000000.0;
+    double interval = (cur_time - (last_time < 0 ? timer_start : last_time)) / 1000000.0;
+    AVBPrint buf;
+    int i, j;
+
+    last_time = cur_time;
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&buf, "{\"time\":%.3f,\"inputs\":[", elapsed);
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+        uint64_t nb_packets = 0, data_size = 0;
+
+        for (j = 0; j < f->nb_streams; j++) {
+            nb_packets += input_streams[f->ist_index + j]->nb_packets;
+            data_size  += input_streams[f->ist_index + j]->data_size;
+        }
+        av_bprintf(&buf, "%s{\"file\":%d,\"packets\":%"PRIu64",\"bytes\":%"PRIu64
+                   ",\"packet_rate\":%.1f,\"byte_rate\":%.1f",
+                   i ? "," : "", i, nb_packets, data_size,
+                   interval > 0 ? (nb_packets - f->stats_nb_packets) / interval : 0,
+                   interval > 0 ? (data_size  - f->stats_data_size)  / interval : 0);
+#if HAVE_PTHREADS
+        if (f->in_thread_queue)
+            av_bprintf(&buf, ",\"queue\":%d,\"queue_size\":%d",
+                       av_thread_message_queue_nb_elems(f->in_thread_queue),
+                       f->thread_queue_size);
+#endif
+        av_bprintf(&buf, "}");
+        f->stats_nb_packets = nb_packets;
+        f->stats_data_size  = data_size;
+    }
+
+    av_bprintf(&buf, "],\"input_streams\":[");
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        av_bprintf(&buf, "%s{\"file\":%d,\"index\":%d,\"packets\":%"PRIu64
+                   ",\"frames_decoded\":%"PRIu64,
+                   i ? "," : "", ist->file_index, ist->st->index,
+                   ist->nb_packets, ist->frames_decoded);
+        print_stage_time(&buf, "decode", &ist->decode_time);
+        print_stage_time(&buf, "filter", &ist->filter_time);
+        av_bprintf(&buf, "}");
+    }
+
+    av_bprintf(&buf, "],\"output_streams\":[");
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        av_bprintf(&buf, "%s{\"file\":%d,\"index\":%d,\"frames_encoded\":%"PRIu64
+                   ",\"packets\":%"PRIu64",\"bytes\":%"PRIu64,
+                   i ? "," : "", ost->file_index, ost->index,
+                   ost->frames_encoded, ost->packets_written, ost->data_size);
+        print_stage_time(&buf, "filter", &ost->filter_time);
+        print_stage_time(&buf, "encode", &ost->encode_time);
+        av_bprintf(&buf, ",\"dup_frames\":%"PRIu64",\"drop_frames\":%"PRIu64"}",
+                   ost->frames_dup, ost->frames_drop);
+    }
+
+    av_bprintf(&buf, "],\"dup_frames\":%d,\"drop_frames\":%d,\"progress\":\"%s\"}\n",
+               nb_frames_dup, nb_frames_drop, is_last_report ? "end" : "continue");
+    avio_write(stats_avio, buf.str, FFMIN(buf.len, buf.size - 1));
+    avio_flush(stats_avio);
+    av_bprint_finalize(&buf, NULL);
+    if (is_last_report)
+        avio_closep(&stats_avio);
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     char buf[1024];
@@ -1531,7 +1669,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     static int qp_histogram[52];
     int hours, mins, secs, us;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!print_stats && !is_last_report && !progress_avio && !stats_avio)
         return;
 
     if (!is_last_report) {
@@ -1623,8 +1761,10 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         if (av_stream_get_end_pts(ost->st) != AV_NOPTS_VALUE)
             pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
                                           ost->st->time_base, AV_TIME_BASE_Q));
-        if (is_last_report)
-            nb_frames_drop += ost->last_droped;
+        if (is_last_report) {
+            nb_frames_drop   += ost->last_droped;
+            ost->frames_drop += ost->last_droped;
+        }
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1688,6 +1828,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    if (stats_avio)
+        print_stats_json(is_last_report, timer_start, cur_time);
+
     if (is_last_report)
         print_final_stats(total_size);
 }
@@ -1738,7 +1881,9 @@ static void flush_encoders(void)
                 pkt.size = 0;
 
                 update_benchmark(NULL);
+                stage_time_start(&ost->encode_time);
                 ret = encode(enc, &pkt, NULL, &got_packet);
+                stage_time_stop(&ost->encode_time);
                 update_benchmark("flush %s %d.%d", desc, ost->file_index, ost->index);
                 if (ret < 0) {
                     av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
@@ -1955,7 +2100,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
+    stage_time_start(&ist->decode_time);
     ret = avcodec_decode_audio4(avctx, decoded_frame, got_output, pkt);
+    stage_time_stop(&ist->decode_time);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
 
     if (ret >= 0 && avctx->sample_rate <= 0) {
@@ -2052,8 +2199,10 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
                 break;
         } else
             f = decoded_frame;
+        stage_time_start(&ist->filter_time);
         err = av_buffersrc_add_frame_flags(ist->filters[i]->filter, f,
                                      AV_BUFFERSRC_FLAG_PUSH);
+        stage_time_stop(&ist->filter_time);
         if (err == AVERROR_EOF)
             err = 0; /* ignore */
         if (err < 0)
@@ -2081,8 +2230,10 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
     pkt->dts  = av_rescale_q(ist->dts, AV_TIME_BASE_Q, ist->st->time_base);
 
     update_benchmark(NULL);
+    stage_time_start(&ist->decode_time);
     ret = avcodec_decode_video2(ist->dec_ctx,
                                 decoded_frame, got_output, pkt);
+    stage_time_stop(&ist->decode_time);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
 
     // The following line may be required in some cases where there is no parser
@@ -2186,7 +2337,9 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
                 break;
         } else
             f = decoded_frame;
+        stage_time_start(&ist->filter_time);
         ret = av_buffersrc_add_frame_flags(ist->filters[i]->filter, f, AV_BUFFERSRC_FLAG_PUSH);
+        stage_time_stop(&ist->filter_time);
         if (ret == AVERROR_EOF) {
             ret = 0; /* ignore */
         } else if (ret < 0) {
@@ -3564,8 +3717,9 @@ static int init_input_threads(void)
         if (f->ctx->pb ? !f->ctx->pb->seekable :
             strcmp(f->ctx->iformat->name, "lavfi"))
             f->non_blocking = 1;
-        ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                            f->thread_queue_size, sizeof(AVPacket));
+        ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                             f->thread_queue_size, sizeof(AVPacket),
+                                             AV_THREAD_MESSAGE_QUEUE_SPSC);
         if (ret < 0)
             return ret;
 
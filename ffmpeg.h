@@ -249,6 +249,13 @@ typedef struct FilterGraph {
     int         nb_outputs;
 } FilterGraph;
 
+typedef struct StageTime {
+    int64_t wall;           ///< total wall clock time spent in the stage, in microseconds
+    int64_t cpu;            ///< total CPU time of the calling thread spent in the stage, in microseconds
+    int64_t wall_start;
+    int64_t cpu_start;
+} StageTime;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -341,6 +348,9 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+    // time spent decoding and sending the decoded frames to the filters
+    StageTime decode_time;
+    StageTime filter_time;
 } InputStream;
 
 typedef struct InputFile {
@@ -372,6 +382,10 @@ typedef struct InputFile {
     int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
 #endif
+
+    /* packets and bytes read at the last -stats_json report */
+    uint64_t stats_nb_packets;
+    uint64_t stats_data_size;
 } InputFile;
 
 enum forced_keyframes_const {
@@ -473,6 +487,12 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // time spent getting frames from the filters and encoding them
+    StageTime filter_time;
+    StageTime encode_time;
+    // number of frames duplicated/dropped for the output frame rate
+    uint64_t frames_dup;
+    uint64_t frames_drop;
 
     /* packet quality factor */
     int quality;
@@ -510,6 +530,7 @@ extern int        nb_filtergraphs;
 
 extern char *vstats_filename;
 extern char *sdp_filename;
+extern char *trace_filename;
 
 extern float audio_drift_threshold;
 extern float dts_delta_threshold;
@@ -535,6 +556,7 @@ extern int qp_hist;
 extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
+extern AVIOContext *stats_avio;
 extern float max_error_rate;
 extern int vdpau_api_ver;
 extern char *videotoolbox_pixfmt;
@@ -41,6 +41,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/time_internal.h"
+#include "libavutil/trace.h"
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
@@ -87,6 +88,7 @@ const HWAccel hwaccels[] = {
 
 char *vstats_filename;
 char *sdp_filename;
+char *trace_filename;
 
 float audio_drift_threshold = 0.1;
 float dts_delta_threshold   = 10;
@@ -442,6 +444,19 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_trace(void *optctx, const char *opt, const char *arg)
+{
+    int ret = av_trace_set_enabled(1);
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Tracing is not supported in this build\n");
+        return ret;
+    }
+    av_free(trace_filename);
+    trace_filename = av_strdup(arg);
+    return trace_filename ? 0 : AVERROR(ENOMEM);
+}
+
 /**
  * Parse a metadata specifier passed as 'arg' parameter.
  * @param arg  metadata string to parse
@@ -3026,6 +3041,24 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_stats_json(void *optctx, const char *opt, const char *arg)
+{
+    AVIOContext *avio = NULL;
+    int ret;
+
+    if (!strcmp(arg, "-"))
+        arg = "pipe:";
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open stats URL \"%s\": %s\n",
+               arg, av_err2str(ret));
+        return ret;
+    }
+    avio_closep(&stats_avio);
+    stats_avio = avio;
+    return 0;
+}
+
 #define OFFSET(x) offsetof(OptionsContext, x)
 const OptionDef options[] = {
     /* main options */
@@ -3102,6 +3135,8 @@ const OptionDef options[] = {
       "add timings for each task" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "stats_json",     HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_stats_json },
+      "write per stage statistics as JSON lines", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
       "enable or disable interaction on standard input" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
@@ -3354,6 +3389,8 @@ const OptionDef options[] = {
         "override the options from ffserver", "" },
     { "sdp_file", HAS_ARG | OPT_EXPERT | OPT_OUTPUT, { opt_sdp_file },
         "specify a file in which to print sdp information", "file" },
+    { "trace", HAS_ARG | OPT_EXPERT, { opt_trace },
+        "write a Chrome trace of the decoding, filtering, encoding and muxing to file", "file" },
 
     { "bsf", HAS_ARG | OPT_STRING | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(bitstream_filters) },
         "A comma-separated list of bitstream filters", "bitstream_filters" },
@@ -63,6 +63,9 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
 #include <errno.h>
 #include <time.h>
 #include <sys/wait.h>
@@ -127,12 +130,25 @@ typedef struct {
     int64_t time1, time2;
 } DataRateData;
 
+/* intrusive list of connections, used by the epoll event loop */
+typedef struct ConnectionList {
+    struct HTTPContext *first, *last;
+} ConnectionList;
+
+typedef struct ConnectionLink {
+    ConnectionList *list; /* list the connection is on, NULL if none */
+    struct HTTPContext *prev, *next;
+} ConnectionLink;
+
 /* context associated with one connection */
 typedef struct HTTPContext {
     enum HTTPState state;
     int fd; /* socket file descriptor */
     struct sockaddr_in from_addr; /* origin */
-    struct pollfd *poll_entry; /* used when polling */
+    int revents; /* poll events that occurred on fd */
+    int events;  /* poll events fd is registered for with epoll */
+    ConnectionLink queue; /* run or tick queue of the event loop */
+    ConnectionLink timer; /* request timeout list of the event loop */
     int64_t timeout;
     uint8_t *buffer_ptr, *buffer_end;
     int http_error;
@@ -208,6 +224,7 @@ static FFServerConfig config = {
 
 static void new_connection(int server_fd, int is_rtsp);
 static void close_connection(HTTPContext *c);
+static void wakeup_connection(HTTPContext *c);
 
 /* HTTP handling */
 static int handle_connection(HTTPContext *c);
@@ -570,16 +587,224 @@ static void start_multicast(void)
         }
 
         rtp_c->state = HTTPSTATE_SEND_DATA;
+        wakeup_connection(rtp_c);
     }
 }
 
+/* return the poll events a connection waits for in its current state */
+static int connection_events(HTTPContext *c, int *delay)
+{
+    switch(c->state) {
+    case HTTPSTATE_SEND_HEADER:
+    case RTSPSTATE_SEND_REPLY:
+    case RTSPSTATE_SEND_PACKET:
+        return POLLOUT;
+    case HTTPSTATE_SEND_DATA_HEADER:
+    case HTTPSTATE_SEND_DATA:
+    case HTTPSTATE_SEND_DATA_TRAILER:
+        if (!c->is_packetized) {
+            /* for TCP, we output as much as we can
+             * (may need to put a limit) */
+            return POLLOUT;
+        }
+        /* when ffserver is doing the timing, we work by
+         * looking at which packet needs to be sent every
+         * 10 ms (one tick wait XXX: 10 ms assumed) */
+        if (*delay > 10)
+            *delay = 10;
+        return 0;
+    case HTTPSTATE_WAIT_REQUEST:
+    case HTTPSTATE_RECEIVE_DATA:
+    case HTTPSTATE_WAIT_FEED:
+    case RTSPSTATE_WAIT_REQUEST:
+        /* need to catch errors */
+        return POLLIN;/* Maybe this will work */
+    default:
+        return 0;
+    }
+}
+
+#if HAVE_EPOLL_CREATE1
+static int epoll_to_poll(uint32_t events)
+{
+    return (events & EPOLLIN  ? POLLIN  : 0) |
+           (events & EPOLLOUT ? POLLOUT : 0) |
+           (events & EPOLLERR ? POLLERR : 0) |
+           (events & EPOLLHUP ? POLLHUP : 0);
+}
+
+/* keep the epoll registration of a connection in sync with its state */
+static int epoll_update(int epoll_fd, HTTPContext *c, int events)
+{
+    struct epoll_event ev = { 0 };
+    int op;
+
+    if (c->fd < 0 || events == c->events)
+        return 0;
+    if (!events) {
+        /* epoll always reports errors on registered descriptors,
+         * unregister so that an idle connection does not wake us up */
+        op = EPOLL_CTL_DEL;
+    } else {
+        op = c->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        ev.events   = (events & POLLIN  ? EPOLLIN  : 0) |
+                      (events & POLLOUT ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+    }
+    if (epoll_ctl(epoll_fd, op, c->fd, &ev) < 0) {
+        http_log("epoll_ctl failed: %s\n", strerror(errno));
+        return -1;
+    }
+    c->events = events;
+    return 0;
+}
+
+/* Connections handled in the current iteration of the event loop: the
+ * ones epoll reported, the ones whose timeout expired, the packetized
+ * ones, which send on a tick instead of on socket events, and the ones
+ * whose state was changed by another connection. The others are not
+ * looked at until one of these happens to them. */
+static ConnectionList run_queue;
+/* packetized connections to handle in the next iteration */
+static ConnectionList tick_queue;
+/* connections waiting for an HTTP and an RTSP request, each sorted by
+ * timeout; the timeouts of one list all have the same duration, so
+ * they are armed in the order they expire */
+static ConnectionList request_timers[2];
+
+#define QUEUE offsetof(HTTPContext, queue)
+#define TIMER offsetof(HTTPContext, timer)
+
+static ConnectionLink *connection_link(HTTPContext *c, size_t link)
+{
+    return (ConnectionLink *)((uint8_t *)c + link);
+}
+
+static void list_remove(HTTPContext *c, size_t link)
+{
+    ConnectionLink *l = connection_link(c, link);
+
+    if (!l->list)
+        return;
+    if (l->prev)
+        connection_link(l->prev, link)->next = l->next;
+    else
+        l->list->first = l->next;
+    if (l->next)
+        connection_link(l->next, link)->prev = l->prev;
+    else
+        l->list->last = l->prev;
+    l->list = NULL;
+    l->prev = l->next = NULL;
+}
+
+/* insert c after prev, or at the head of the list if prev is NULL */
+static void list_insert(ConnectionList *list, HTTPContext *prev,
+                        HTTPContext *c, size_t link)
+{
+    ConnectionLink *l = connection_link(c, link);
+
+    l->list = list;
+    l->prev = prev;
+    l->next = prev ? connection_link(prev, link)->next : list->first;
+    if (l->next)
+        connection_link(l->next, link)->prev = c;
+    else
+        list->last = c;
+    if (prev)
+        connection_link(prev, link)->next = c;
+    else
+        list->first = c;
+}
+
+/* handle the connection in the current or next iteration of the loop */
+static void wakeup_connection(HTTPContext *c)
+{
+    if (c->queue.list == &run_queue)
+        return;
+    list_remove(c, QUEUE);
+    list_insert(&run_queue, run_queue.last, c, QUEUE);
+}
+
+static void arm_request_timer(HTTPContext *c, ConnectionList *list)
+{
+    HTTPContext *prev = list->last;
+
+    if (c->timer.list == list)
+        return;
+    list_remove(c, TIMER);
+    while (prev && prev->timeout > c->timeout)
+        prev = prev->timer.prev;
+    list_insert(list, prev, c, TIMER);
+}
+
+/* drop a connection that is about to be freed from the loop lists */
+static void forget_connection(HTTPContext *c)
+{
+    list_remove(c, QUEUE);
+    list_remove(c, TIMER);
+}
+
+/* register what a connection waits for after it has been handled */
+static int schedule_connection(int epoll_fd, HTTPContext *c)
+{
+    int delay = 1000;
+    int events = connection_events(c, &delay);
+
+    if (epoll_update(epoll_fd, c, events) < 0)
+        return -1;
+
+    if (c->state == HTTPSTATE_WAIT_REQUEST)
+        arm_request_timer(c, &request_timers[0]);
+    else if (c->state == RTSPSTATE_WAIT_REQUEST)
+        arm_request_timer(c, &request_timers[1]);
+    else
+        list_remove(c, TIMER);
+
+    /* a shorter delay is only asked for by connections sending on ticks */
+    if (delay < 1000 && !c->queue.list)
+        list_insert(&tick_queue, tick_queue.last, c, QUEUE);
+    return 0;
+}
+#else
+static void wakeup_connection(HTTPContext *c)
+{
+}
+
+static void forget_connection(HTTPContext *c)
+{
+}
+#endif
+
 /* main loop of the HTTP server */
 static int http_server(void)
 {
     int server_fd = 0, rtsp_server_fd = 0;
     int ret, delay;
+    HTTPContext *c;
+#if HAVE_EPOLL_CREATE1
+    /* the listening sockets are told apart by these addresses */
+    static int server_tag, rtsp_server_tag;
+    struct epoll_event *events, ev = { 0 };
+    int i, nb_events, epoll_fd;
+    int server_ready, rtsp_server_ready;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        http_log("epoll_create1 failed: %s\n", strerror(errno));
+        return -1;
+    }
+    nb_events = config.nb_max_http_connections + 2;
+    events = av_mallocz_array(nb_events, sizeof(*events));
+    if (!events) {
+        http_log("Impossible to allocate an event table handling %d "
+                 "connections.\n", config.nb_max_http_connections);
+        close(epoll_fd);
+        return -1;
+    }
+#else
+    HTTPContext *c_next;
     struct pollfd *poll_table, *poll_entry;
-    HTTPContext *c, *c_next;
 
     poll_table = av_mallocz_array(config.nb_max_http_connections + 2,
                                   sizeof(*poll_table));
@@ -588,6 +813,7 @@ static int http_server(void)
                  "connections.\n", config.nb_max_http_connections);
         return -1;
     }
+#endif
 
     if (config.http_addr.sin_port) {
         server_fd = socket_open_listen(&config.http_addr);
@@ -614,6 +840,98 @@ static int http_server(void)
 
     start_multicast();
 
+#if HAVE_EPOLL_CREATE1
+    ev.events = EPOLLIN;
+    if (server_fd) {
+        ev.data.ptr = &server_tag;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0)
+            goto quit;
+    }
+    if (rtsp_server_fd) {
+        ev.data.ptr = &rtsp_server_tag;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, rtsp_server_fd, &ev) < 0)
+            goto quit;
+    }
+
+    for(;;) {
+        /* wait for an event on one connection. We poll at least every
+         * second, or every tick if there are packetized connections, and
+         * wake up when the first request timeout expires */
+        cur_time = av_gettime() / 1000;
+        delay = tick_queue.first ? 10 : 1000;
+        for (i = 0; i < FF_ARRAY_ELEMS(request_timers); i++) {
+            c = request_timers[i].first;
+            if (c)
+                delay = FFMIN(delay, FFMAX(c->timeout - cur_time + 1, 0));
+        }
+        do {
+            ret = epoll_wait(epoll_fd, events, nb_events, delay);
+            if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
+                ff_neterrno() != AVERROR(EINTR)) {
+                goto quit;
+            }
+        } while (ret < 0);
+
+        cur_time = av_gettime() / 1000;
+
+        if (need_to_start_children) {
+            need_to_start_children = 0;
+            start_children(config.first_feed);
+        }
+
+        /* collect the connections to handle */
+        while ((c = tick_queue.first)) {
+            list_remove(c, QUEUE);
+            wakeup_connection(c);
+        }
+        server_ready = rtsp_server_ready = 0;
+        for (i = 0; i < ret; i++) {
+            if (events[i].data.ptr == &server_tag) {
+                server_ready = 1;
+            } else if (events[i].data.ptr == &rtsp_server_tag) {
+                rtsp_server_ready = 1;
+            } else {
+                c = events[i].data.ptr;
+                c->revents = epoll_to_poll(events[i].events);
+                wakeup_connection(c);
+            }
+        }
+        for (i = 0; i < FF_ARRAY_ELEMS(request_timers); i++) {
+            while ((c = request_timers[i].first) &&
+                   (c->timeout - cur_time) < 0) {
+                list_remove(c, TIMER);
+                wakeup_connection(c);
+            }
+        }
+
+        /* now handle the events; closing a connection removes it and
+         * the connections it owns from the queue */
+        while ((c = run_queue.first)) {
+            list_remove(c, QUEUE);
+            if (handle_connection(c) < 0) {
+                log_connection(c);
+                /* close and free the connection */
+                close_connection(c);
+                continue;
+            }
+            c->revents = 0;
+            if (schedule_connection(epoll_fd, c) < 0)
+                goto quit;
+        }
+
+        /* new HTTP connection request ? */
+        if (server_ready)
+            new_connection(server_fd, 0);
+        /* new RTSP connection request ? */
+        if (rtsp_server_ready)
+            new_connection(rtsp_server_fd, 1);
+    }
+
+quit:
+    av_free(events);
+    close(epoll_fd);
+    return -1;
+#else
     for(;;) {
         poll_entry = poll_table;
         if (server_fd) {
@@ -631,48 +949,11 @@ static int http_server(void)
         c = first_http_ctx;
         delay = 1000;
         while (c) {
-            int fd;
-            fd = c->fd;
-            switch(c->state) {
-            case HTTPSTATE_SEND_HEADER:
-            case RTSPSTATE_SEND_REPLY:
-            case RTSPSTATE_SEND_PACKET:
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLOUT;
+            int events = connection_events(c, &delay);
+            if (events) {
+                poll_entry->fd = c->fd;
+                poll_entry->events = events;
                 poll_entry++;
-                break;
-            case HTTPSTATE_SEND_DATA_HEADER:
-            case HTTPSTATE_SEND_DATA:
-            case HTTPSTATE_SEND_DATA_TRAILER:
-                if (!c->is_packetized) {
-                    /* for TCP, we output as much as we can
-                     * (may need to put a limit) */
-                    c->poll_entry = poll_entry;
-                    poll_entry->fd = fd;
-                    poll_entry->events = POLLOUT;
-                    poll_entry++;
-                } else {
-                    /* when ffserver is doing the timing, we work by
-                     * looking at which packet needs to be sent every
-                     * 10 ms (one tick wait XXX: 10 ms assumed) */
-                    if (delay > 10)
-                        delay = 10;
-                }
-                break;
-            case HTTPSTATE_WAIT_REQUEST:
-            case HTTPSTATE_RECEIVE_DATA:
-            case HTTPSTATE_WAIT_FEED:
-            case RTSPSTATE_WAIT_REQUEST:
-                /* need to catch errors */
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLIN;/* Maybe this will work */
-                poll_entry++;
-                break;
-            default:
-                c->poll_entry = NULL;
-                break;
             }
             c = c->next;
         }
@@ -687,6 +968,13 @@ static int http_server(void)
             }
         } while (ret < 0);
 
+        /* the connections are still in the order they were polled */
+        poll_entry = poll_table + !!server_fd + !!rtsp_server_fd;
+        for(c = first_http_ctx; c; c = c->next) {
+            int events = connection_events(c, &delay);
+            c->revents = events ? poll_entry++->revents : 0;
+        }
+
         cur_time = av_gettime() / 1000;
 
         if (need_to_start_children) {
@@ -721,6 +1009,7 @@ static int http_server(void)
 quit:
     av_free(poll_table);
     return -1;
+#endif
 }
 
 /* start waiting for a new HTTP/RTSP request */
@@ -783,7 +1072,6 @@ static void new_connection(int server_fd, int is_rtsp)
         goto fail;
 
     c->fd = fd;
-    c->poll_entry = NULL;
     c->from_addr = from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
@@ -795,6 +1083,7 @@ static void new_connection(int server_fd, int is_rtsp)
     nb_connections++;
 
     start_wait_request(c, is_rtsp);
+    wakeup_connection(c);
 
     return;
 
@@ -813,6 +1102,8 @@ static void close_connection(HTTPContext *c)
     AVFormatContext *ctx;
     AVStream *st;
 
+    forget_connection(c);
+
     /* remove connection from list */
     cp = &first_http_ctx;
     while (*cp) {
@@ -901,11 +1192,11 @@ static int handle_connection(HTTPContext *c)
         /* timeout ? */
         if ((c->timeout - cur_time) < 0)
             return -1;
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->revents & (POLLERR | POLLHUP))
             return -1;
 
         /* no need to read if no events */
-        if (!(c->poll_entry->revents & POLLIN))
+        if (!(c->revents & POLLIN))
             return 0;
         /* read the data */
     read_loop:
@@ -939,11 +1230,11 @@ static int handle_connection(HTTPContext *c)
         break;
 
     case HTTPSTATE_SEND_HEADER:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->revents & (POLLERR | POLLHUP))
             return -1;
 
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->revents & POLLOUT))
             return 0;
         len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
         if (len < 0) {
@@ -976,11 +1267,11 @@ static int handle_connection(HTTPContext *c)
          * input streams set the speed). It may be better to verify
          * that we do not rely too much on the kernel queues */
         if (!c->is_packetized) {
-            if (c->poll_entry->revents & (POLLERR | POLLHUP))
+            if (c->revents & (POLLERR | POLLHUP))
                 return -1;
 
             /* no need to read if no events */
-            if (!(c->poll_entry->revents & POLLOUT))
+            if (!(c->revents & POLLOUT))
                 return 0;
         }
         if (http_send_data(c) < 0)
@@ -989,32 +1280,31 @@ static int handle_connection(HTTPContext *c)
         if (c->state == HTTPSTATE_SEND_DATA_TRAILER)
             return -1;
         /* Check if it is a single jpeg frame 123 */
-        if (c->stream->single_frame && c->data_count > c->cur_frame_bytes && c->cur_frame_bytes > 0) {
-            close_connection(c);
-        }
+        if (c->stream->single_frame && c->data_count > c->cur_frame_bytes && c->cur_frame_bytes > 0)
+            return -1;
         break;
     case HTTPSTATE_RECEIVE_DATA:
         /* no need to read if no events */
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->revents & (POLLERR | POLLHUP))
             return -1;
-        if (!(c->poll_entry->revents & POLLIN))
+        if (!(c->revents & POLLIN))
             return 0;
         if (http_receive_data(c) < 0)
             return -1;
         break;
     case HTTPSTATE_WAIT_FEED:
         /* no need to read if no events */
-        if (c->poll_entry->revents & (POLLIN | POLLERR | POLLHUP))
+        if (c->revents & (POLLIN | POLLERR | POLLHUP))
             return -1;
 
         /* nothing to do, we'll be waken up by incoming feed packets */
         break;
 
     case RTSPSTATE_SEND_REPLY:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->revents & (POLLERR | POLLHUP))
             goto close_connection;
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->revents & POLLOUT))
             return 0;
         len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
         if (len < 0) {
@@ -1033,12 +1323,12 @@ static int handle_connection(HTTPContext *c)
         }
         break;
     case RTSPSTATE_SEND_PACKET:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP)) {
+        if (c->revents & (POLLERR | POLLHUP)) {
             av_freep(&c->packet_buffer);
             return -1;
         }
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->revents & POLLOUT))
             return 0;
         len = send(c->fd, c->packet_buffer_ptr,
                     c->packet_buffer_end - c->packet_buffer_ptr, 0);
@@ -2488,6 +2778,7 @@ static int http_send_data(HTTPContext *c)
                          * send it later, so a new state is needed to
                          * "lock" the RTSP TCP connection */
                         rtsp_c->state = RTSPSTATE_SEND_PACKET;
+                        wakeup_connection(rtsp_c);
                         break;
                     } else
                         /* all data has been sent */
@@ -2682,8 +2973,10 @@ static int http_receive_data(HTTPContext *c)
             /* wake up any waiting connections */
             for(c1 = first_http_ctx; c1; c1 = c1->next) {
                 if (c1->state == HTTPSTATE_WAIT_FEED &&
-                    c1->stream->feed == c->stream->feed)
+                    c1->stream->feed == c->stream->feed) {
                     c1->state = HTTPSTATE_SEND_DATA;
+                    wakeup_connection(c1);
+                }
             }
         } else {
             /* We have a header in our hands that contains useful data */
@@ -2741,8 +3034,10 @@ static int http_receive_data(HTTPContext *c)
     /* wake up any waiting connections to stop waiting for feed */
     for(c1 = first_http_ctx; c1; c1 = c1->next) {
         if (c1->state == HTTPSTATE_WAIT_FEED &&
-            c1->stream->feed == c->stream->feed)
+            c1->stream->feed == c->stream->feed) {
             c1->state = HTTPSTATE_SEND_DATA_TRAILER;
+            wakeup_connection(c1);
+        }
     }
     return -1;
 }
@@ -3204,6 +3499,7 @@ static void rtsp_cmd_play(HTTPContext *c, const char *url, RTSPMessageHeader *h)
     }
 
     rtp_c->state = HTTPSTATE_SEND_DATA;
+    wakeup_connection(rtp_c);
 
     /* now everything is OK, so we can send the connection parameters */
     rtsp_reply_header(c, RTSP_STATUS_OK);
@@ -3231,6 +3527,7 @@ static void rtsp_cmd_interrupt(HTTPContext *c, const char *url,
         }
         rtp_c->state = HTTPSTATE_READY;
         rtp_c->first_pts = AV_NOPTS_VALUE;
+        wakeup_connection(rtp_c);
     }
 
     /* now everything is OK, so we can send the connection parameters */
@@ -3265,7 +3562,6 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
         goto fail;
 
     c->fd = -1;
-    c->poll_entry = NULL;
     c->from_addr = *from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
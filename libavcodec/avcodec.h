@@ -3348,6 +3348,11 @@ typedef struct AVCodec {
      */
     int priv_data_size;
     struct AVCodec *next;
+    /**
+     * Next codec in the same bucket of the registration hash tables.
+     */
+    struct AVCodec *next_by_id;
+    struct AVCodec *next_by_name;
     /**
      * @name Frame-level threading support functions
      * @{
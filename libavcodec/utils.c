@@ -41,6 +41,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/dict.h"
+#include "libavutil/trace.h"
 #include "avcodec.h"
 #include "libavutil/opt.h"
 #include "me_cmp.h"
@@ -181,6 +182,19 @@ int av_codec_is_decoder(const AVCodec *codec)
     return codec && codec->decode;
 }
 
+/* registered codecs hashed by id and by name, in registration order */
+static AVCodec *codecs_by_id[256];
+static AVCodec *codecs_by_name[512];
+
+static unsigned codec_name_hash(const char *name)
+{
+    unsigned hash = 0;
+
+    while (*name)
+        hash = hash * 31 + (uint8_t)*name++;
+    return hash % FF_ARRAY_ELEMS(codecs_by_name);
+}
+
 av_cold void avcodec_register(AVCodec *codec)
 {
     AVCodec **p;
@@ -192,6 +206,16 @@ av_cold void avcodec_register(AVCodec *codec)
         p = &(*p)->next;
     last_avcodec = &codec->next;
 
+    codec->next_by_id = NULL;
+    p = &codecs_by_id[codec->id % FF_ARRAY_ELEMS(codecs_by_id)];
+    while(*p || avpriv_atomic_ptr_cas((void * volatile *)p, NULL, codec))
+        p = &(*p)->next_by_id;
+
+    codec->next_by_name = NULL;
+    p = &codecs_by_name[codec_name_hash(codec->name)];
+    while(*p || avpriv_atomic_ptr_cas((void * volatile *)p, NULL, codec))
+        p = &(*p)->next_by_name;
+
     if (codec->init_static_data)
         codec->init_static_data(codec);
 }
@@ -1748,7 +1772,9 @@ int attribute_align_arg avcodec_encode_audio2(AVCodecContext *avctx,
 
     av_assert0(avctx->codec->encode2);
 
+    av_trace_begin("encode", avctx->codec->name);
     ret = avctx->codec->encode2(avctx, avpkt, frame, got_packet_ptr);
+    av_trace_end("encode", avctx->codec->name);
     if (!ret) {
         if (*got_packet_ptr) {
             if (!(avctx->codec->capabilities & AV_CODEC_CAP_DELAY)) {
@@ -1826,8 +1852,12 @@ int attribute_align_arg avcodec_encode_video2(AVCodecContext *avctx,
     *got_packet_ptr = 0;
 
     if(CONFIG_FRAME_THREAD_ENCODER &&
-       avctx->internal->frame_thread_encoder && (avctx->active_thread_type&FF_THREAD_FRAME))
-        return ff_thread_video_encode_frame(avctx, avpkt, frame, got_packet_ptr);
+       avctx->internal->frame_thread_encoder && (avctx->active_thread_type&FF_THREAD_FRAME)) {
+        av_trace_begin("encode", avctx->codec->name);
+        ret = ff_thread_video_encode_frame(avctx, avpkt, frame, got_packet_ptr);
+        av_trace_end("encode", avctx->codec->name);
+        return ret;
+    }
 
     if ((avctx->flags&AV_CODEC_FLAG_PASS1) && avctx->stats_out)
         avctx->stats_out[0] = '\0';
@@ -1849,7 +1879,9 @@ int attribute_align_arg avcodec_encode_video2(AVCodecContext *avctx,
 
     av_assert0(avctx->codec->encode2);
 
+    av_trace_begin("encode", avctx->codec->name);
     ret = avctx->codec->encode2(avctx, avpkt, frame, got_packet_ptr);
+    av_trace_end("encode", avctx->codec->name);
     av_assert0(ret <= 0);
 
     if (avpkt->data && avpkt->data == avctx->internal->byte_buffer) {
@@ -2090,6 +2122,7 @@ int attribute_align_arg avcodec_decode_video2(AVCodecContext *avctx, AVFrame *pi
         }
 
         avctx->internal->pkt = &tmp;
+        av_trace_begin("decode", avctx->codec->name);
         if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME)
             ret = ff_thread_decode_frame(avctx, picture, got_picture_ptr,
                                          &tmp);
@@ -2111,6 +2144,7 @@ int attribute_align_arg avcodec_decode_video2(AVCodecContext *avctx, AVFrame *pi
                 if (picture->format == AV_PIX_FMT_NONE)   picture->format              = avctx->pix_fmt;
             }
         }
+        av_trace_end("decode", avctx->codec->name);
 
 fail:
         emms_c(); //needed to avoid an emms_c() call before every return;
@@ -2191,6 +2225,7 @@ int attribute_align_arg avcodec_decode_audio4(AVCodecContext *avctx,
         }
 
         avctx->internal->pkt = &tmp;
+        av_trace_begin("decode", avctx->codec->name);
         if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME)
             ret = ff_thread_decode_frame(avctx, frame, got_frame_ptr, &tmp);
         else {
@@ -2198,6 +2233,7 @@ int attribute_align_arg avcodec_decode_audio4(AVCodecContext *avctx,
             av_assert0(ret <= tmp.size);
             frame->pkt_dts = avpkt->dts;
         }
+        av_trace_end("decode", avctx->codec->name);
         if (ret >= 0 && *got_frame_ptr) {
             avctx->frame_number++;
             av_frame_set_best_effort_timestamp(frame,
@@ -2428,7 +2464,9 @@ int avcodec_decode_subtitle2(AVCodecContext *avctx, AVSubtitle *sub,
             if (avctx->pkt_timebase.den && avpkt->pts != AV_NOPTS_VALUE)
                 sub->pts = av_rescale_q(avpkt->pts,
                                         avctx->pkt_timebase, AV_TIME_BASE_Q);
+            av_trace_begin("decode", avctx->codec->name);
             ret = avctx->codec->decode(avctx, sub, got_sub_ptr, &pkt_recoded);
+            av_trace_end("decode", avctx->codec->name);
             av_assert1((ret >= 0) >= !!*got_sub_ptr &&
                        !!*got_sub_ptr >= !!sub->num_rects);
 
@@ -2555,8 +2593,8 @@ static enum AVCodecID remap_deprecated_codec_id(enum AVCodecID id)
 static AVCodec *find_encdec(enum AVCodecID id, int encoder)
 {
     AVCodec *p, *experimental = NULL;
-    p = first_avcodec;
     id= remap_deprecated_codec_id(id);
+    p = codecs_by_id[id % FF_ARRAY_ELEMS(codecs_by_id)];
     while (p) {
         if ((encoder ? av_codec_is_encoder(p) : av_codec_is_decoder(p)) &&
             p->id == id) {
@@ -2565,7 +2603,7 @@ static AVCodec *find_encdec(enum AVCodecID id, int encoder)
             } else
                 return p;
         }
-        p = p->next;
+        p = p->next_by_id;
     }
     return experimental;
 }
@@ -2580,11 +2618,11 @@ AVCodec *avcodec_find_encoder_by_name(const char *name)
     AVCodec *p;
     if (!name)
         return NULL;
-    p = first_avcodec;
+    p = codecs_by_name[codec_name_hash(name)];
     while (p) {
         if (av_codec_is_encoder(p) && strcmp(name, p->name) == 0)
             return p;
-        p = p->next;
+        p = p->next_by_name;
     }
     return NULL;
 }
@@ -2599,11 +2637,11 @@ AVCodec *avcodec_find_decoder_by_name(const char *name)
     AVCodec *p;
     if (!name)
         return NULL;
-    p = first_avcodec;
+    p = codecs_by_name[codec_name_hash(name)];
     while (p) {
         if (av_codec_is_decoder(p) && strcmp(name, p->name) == 0)
             return p;
-        p = p->next;
+        p = p->next_by_name;
     }
     return NULL;
 }
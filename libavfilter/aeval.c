@@ -70,6 +70,8 @@ typedef struct {
     uint64_t n;
     double var_values[VAR_VARS_NB];
     double *channel_values;
+    double *n_values;           ///< N of each sample of a frame, for aevalsrc
+    double *t_values;           ///< T of each sample of a frame, for aevalsrc
     int64_t out_channel_layout;
 } EvalContext;
 
@@ -218,6 +220,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
     av_freep(&eval->expr);
     av_freep(&eval->channel_values);
+    av_freep(&eval->n_values);
+    av_freep(&eval->t_values);
 }
 
 static int config_props(AVFilterLink *outlink)
@@ -232,6 +236,13 @@ static int config_props(AVFilterLink *outlink)
     eval->var_values[VAR_NB_IN_CHANNELS] = NAN;
     eval->var_values[VAR_NB_OUT_CHANNELS] = outlink->channels;
 
+    av_freep(&eval->n_values);
+    av_freep(&eval->t_values);
+    eval->n_values = av_malloc_array(eval->nb_samples, sizeof(*eval->n_values));
+    eval->t_values = av_malloc_array(eval->nb_samples, sizeof(*eval->t_values));
+    if (!eval->n_values || !eval->t_values)
+        return AVERROR(ENOMEM);
+
     av_get_channel_layout_string(buf, sizeof(buf), 0, eval->chlayout);
 
     av_log(outlink->src, AV_LOG_VERBOSE,
@@ -275,6 +286,10 @@ static int request_frame(AVFilterLink *outlink)
 {
     EvalContext *eval = outlink->src->priv;
     AVFrame *samplesref;
+    const double *const_arrays[VAR_VARS_NB] = {
+        [VAR_N] = eval->n_values,
+        [VAR_T] = eval->t_values,
+    };
     int i, j;
     int64_t t = av_rescale(eval->n, AV_TIME_BASE, eval->sample_rate);
 
@@ -285,16 +300,14 @@ static int request_frame(AVFilterLink *outlink)
     if (!samplesref)
         return AVERROR(ENOMEM);
 
-    /* evaluate expression for each single sample and for each channel */
+    /* evaluate expression for all the samples of each channel */
     for (i = 0; i < eval->nb_samples; i++, eval->n++) {
-        eval->var_values[VAR_N] = eval->n;
-        eval->var_values[VAR_T] = eval->var_values[VAR_N] * (double)1/eval->sample_rate;
-
-        for (j = 0; j < eval->nb_channels; j++) {
-            *((double *) samplesref->extended_data[j] + i) =
-                av_expr_eval(eval->expr[j], eval->var_values, NULL);
-        }
+        eval->n_values[i] = eval->n;
+        eval->t_values[i] = eval->n_values[i] * (double)1/eval->sample_rate;
     }
+    for (j = 0; j < eval->nb_channels; j++)
+        av_expr_eval_batch(eval->expr[j], (double *)samplesref->extended_data[j],
+                           eval->nb_samples, eval->var_values, const_arrays, NULL);
 
     samplesref->pts = eval->pts;
     samplesref->sample_rate = eval->sample_rate;
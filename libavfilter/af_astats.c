@@ -21,6 +21,7 @@
 
 #include <float.h>
 
+#include "libavutil/float_dsp.h"
 #include "libavutil/opt.h"
 #include "audio.h"
 #include "avfilter.h"
@@ -50,6 +51,7 @@ typedef struct {
     int metadata;
     int reset_count;
     int nb_frames;
+    AVFloatDSPContext *fdsp;
 } AudioStatsContext;
 
 #define OFFSET(x) offsetof(AudioStatsContext, x)
@@ -134,30 +136,33 @@ static unsigned bit_depth(uint64_t mask)
     return result;
 }
 
-static inline void update_stat(AudioStatsContext *s, ChannelStats *p, double d)
+static av_always_inline void update_stat(AudioStatsContext *s, ChannelStats *p,
+                                        double d, int minmax)
 {
-    if (d < p->min) {
-        p->min = d;
-        p->min_run = 1;
-        p->min_runs = 0;
-        p->min_count = 1;
-    } else if (d == p->min) {
-        p->min_count++;
-        p->min_run = d == p->last ? p->min_run + 1 : 1;
-    } else if (p->last == p->min) {
-        p->min_runs += p->min_run * p->min_run;
-    }
+    if (minmax) {
+        if (d < p->min) {
+            p->min = d;
+            p->min_run = 1;
+            p->min_runs = 0;
+            p->min_count = 1;
+        } else if (d == p->min) {
+            p->min_count++;
+            p->min_run = d == p->last ? p->min_run + 1 : 1;
+        } else if (p->last == p->min) {
+            p->min_runs += p->min_run * p->min_run;
+        }
 
-    if (d > p->max) {
-        p->max = d;
-        p->max_run = 1;
-        p->max_runs = 0;
-        p->max_count = 1;
-    } else if (d == p->max) {
-        p->max_count++;
-        p->max_run = d == p->last ? p->max_run + 1 : 1;
-    } else if (p->last == p->max) {
-        p->max_runs += p->max_run * p->max_run;
+        if (d > p->max) {
+            p->max = d;
+            p->max_run = 1;
+            p->max_runs = 0;
+            p->max_count = 1;
+        } else if (d == p->max) {
+            p->max_count++;
+            p->max_run = d == p->last ? p->max_run + 1 : 1;
+        } else if (p->last == p->max) {
+            p->max_runs += p->max_run * p->max_run;
+        }
     }
 
     p->sigma_x += d;
@@ -261,6 +266,39 @@ static void set_metadata(AudioStatsContext *s, AVDictionary **metadata)
     set_meta(metadata, 0, "Overall.Number_of_samples", "%f", nb_samples / s->nb_channels);
 }
 
+#define BLOCK_SIZE 256
+
+/**
+ * Update the statistics of one channel of planar input. Blocks of samples
+ * that lie strictly between the current extremes cannot change the min/max
+ * statistics beyond their first sample, which ends a run at an extreme if
+ * there is one, so the per-sample min/max tracking is skipped for them.
+ */
+static void update_stats_planar(AudioStatsContext *s, ChannelStats *p,
+                                const double *src, int nb_samples)
+{
+    int i = 0, j;
+
+    if (!((intptr_t)src & 31)) {
+        for (; i + BLOCK_SIZE <= nb_samples; i += BLOCK_SIZE) {
+            double min, max;
+
+            s->fdsp->vector_dminmax(src + i, BLOCK_SIZE, &min, &max);
+            if (min > p->min && max < p->max) {
+                update_stat(s, p, src[i], 1);
+                for (j = 1; j < BLOCK_SIZE; j++)
+                    update_stat(s, p, src[i + j], 0);
+            } else {
+                for (j = 0; j < BLOCK_SIZE; j++)
+                    update_stat(s, p, src[i + j], 1);
+            }
+        }
+    }
+
+    for (; i < nb_samples; i++)
+        update_stat(s, p, src[i], 1);
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
 {
     AudioStatsContext *s = inlink->dst->priv;
@@ -272,11 +310,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
     switch (inlink->format) {
     case AV_SAMPLE_FMT_DBLP:
         for (c = 0; c < channels; c++) {
-            ChannelStats *p = &s->chstats[c];
-            src = (const double *)buf->extended_data[c];
-
-            for (i = 0; i < buf->nb_samples; i++, src++)
-                update_stat(s, p, *src);
+            update_stats_planar(s, &s->chstats[c],
+                                (const double *)buf->extended_data[c],
+                                buf->nb_samples);
         }
         break;
     case AV_SAMPLE_FMT_DBL:
@@ -284,7 +320,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
 
         for (i = 0; i < buf->nb_samples; i++) {
             for (c = 0; c < channels; c++, src++)
-                update_stat(s, &s->chstats[c], *src);
+                update_stat(s, &s->chstats[c], *src, 1);
         }
         break;
     }
@@ -377,6 +413,17 @@ static void print_stats(AVFilterContext *ctx)
     av_log(ctx, AV_LOG_INFO, "Number of samples: %"PRId64"\n", nb_samples / s->nb_channels);
 }
 
+static av_cold int init(AVFilterContext *ctx)
+{
+    AudioStatsContext *s = ctx->priv;
+
+    s->fdsp = avpriv_float_dsp_alloc(0);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     AudioStatsContext *s = ctx->priv;
@@ -384,6 +431,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     if (s->nb_channels)
         print_stats(ctx);
     av_freep(&s->chstats);
+    av_freep(&s->fdsp);
 }
 
 static const AVFilterPad astats_inputs[] = {
@@ -410,6 +458,7 @@ AVFilter ff_af_astats = {
     .query_formats = query_formats,
     .priv_size     = sizeof(AudioStatsContext),
     .priv_class    = &astats_class,
+    .init          = init,
     .uninit        = uninit,
     .inputs        = astats_inputs,
     .outputs       = astats_outputs,
@@ -31,6 +31,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/trace.h"
 
 #include "audio.h"
 #include "avfilter.h"
@@ -474,17 +475,29 @@ int avfilter_process_command(AVFilterContext *filter, const char *cmd, const cha
 static AVFilter *first_filter;
 static AVFilter **last_filter = &first_filter;
 
+/* registered filters hashed by name, in registration order */
+static AVFilter *filters_by_name[256];
+
+static unsigned filter_name_hash(const char *name)
+{
+    unsigned hash = 0;
+
+    while (*name)
+        hash = hash * 31 + (uint8_t)*name++;
+    return hash % FF_ARRAY_ELEMS(filters_by_name);
+}
+
 #if !FF_API_NOCONST_GET_NAME
 const
 #endif
 AVFilter *avfilter_get_by_name(const char *name)
 {
-    const AVFilter *f = NULL;
+    const AVFilter *f;
 
     if (!name)
         return NULL;
 
-    while ((f = avfilter_next(f)))
+    for (f = filters_by_name[filter_name_hash(name)]; f; f = f->next_by_name)
         if (!strcmp(f->name, name))
             return (AVFilter *)f;
 
@@ -504,6 +517,11 @@ int avfilter_register(AVFilter *filter)
         f = &(*f)->next;
     last_filter = &filter->next;
 
+    filter->next_by_name = NULL;
+    f = &filters_by_name[filter_name_hash(filter->name)];
+    while(*f || avpriv_atomic_ptr_cas((void * volatile *)f, NULL, filter))
+        f = &(*f)->next_by_name;
+
     return 0;
 }
 
@@ -1079,7 +1097,9 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
             (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
             filter_frame = default_filter_frame;
     }
+    av_trace_begin("filter", link->dst->filter->name);
     ret = filter_frame(link, out);
+    av_trace_end("filter", link->dst->filter->name);
     link->frame_count++;
     ff_update_link_current_pts(link, pts);
     return ret;
@@ -271,6 +271,12 @@ typedef struct AVFilter {
      */
     struct AVFilter *next;
 
+    /**
+     * Used by the filter registration system to hash filters by name. Must
+     * not be touched by any other code.
+     */
+    struct AVFilter *next_by_name;
+
     /**
      * Make the filter instance process a command.
      *
@@ -41,6 +41,8 @@ typedef struct {
     int hsub, vsub;             ///< chroma subsampling
     int planes;                 ///< number of planes
     int is_rgb;
+    double *x_values;           ///< X of each pixel of a line
+    double *line_values;        ///< evaluated line
 } GEQContext;
 
 enum { Y = 0, U, V, A, G, B, R };
@@ -192,12 +194,22 @@ static int geq_config_props(AVFilterLink *inlink)
 {
     GEQContext *geq = inlink->dst->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int i;
 
     av_assert0(desc);
 
     geq->hsub = desc->log2_chroma_w;
     geq->vsub = desc->log2_chroma_h;
     geq->planes = desc->nb_components;
+
+    av_freep(&geq->x_values);
+    av_freep(&geq->line_values);
+    geq->x_values    = av_malloc_array(inlink->w, sizeof(*geq->x_values));
+    geq->line_values = av_malloc_array(inlink->w, sizeof(*geq->line_values));
+    if (!geq->x_values || !geq->line_values)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < inlink->w; i++)
+        geq->x_values[i] = i;
     return 0;
 }
 
@@ -211,6 +223,7 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
         [VAR_N] = inlink->frame_count,
         [VAR_T] = in->pts == AV_NOPTS_VALUE ? NAN : in->pts * av_q2d(inlink->time_base),
     };
+    const double *const_arrays[VAR_VARS_NB] = { [VAR_X] = geq->x_values };
 
     geq->picref = in;
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
@@ -234,10 +247,10 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
 
         for (y = 0; y < h; y++) {
             values[VAR_Y] = y;
-            for (x = 0; x < w; x++) {
-                values[VAR_X] = x;
-                dst[x] = av_expr_eval(geq->e[plane], values, geq);
-            }
+            av_expr_eval_batch(geq->e[plane], geq->line_values, w,
+                               values, const_arrays, geq);
+            for (x = 0; x < w; x++)
+                dst[x] = geq->line_values[x];
             dst += linesize;
         }
     }
@@ -253,6 +266,8 @@ static av_cold void geq_uninit(AVFilterContext *ctx)
 
     for (i = 0; i < FF_ARRAY_ELEMS(geq->e); i++)
         av_expr_free(geq->e[i]);
+    av_freep(&geq->x_values);
+    av_freep(&geq->line_values);
 }
 
 static const AVFilterPad geq_inputs[] = {
@@ -207,6 +207,10 @@ static int config_props(AVFilterLink *inlink)
     uint8_t rgba_map[4]; /* component index -> RGBA color index map */
     int min[4], max[4];
     int val, color, ret;
+    int nb_vals = 1 << desc->comp[0].depth;
+    double *vals, *clipvals, *negvals, *res;
+    const double *const_arrays[VAR_VARS_NB] = { NULL };
+    unsigned func_calls[FF_ARRAY_ELEMS(funcs1) - 1];
 
     s->hsub = desc->log2_chroma_w;
     s->vsub = desc->log2_chroma_h;
@@ -274,8 +278,17 @@ static int config_props(AVFilterLink *inlink)
         s->step = av_get_bits_per_pixel(desc) >> 3;
     }
 
+    vals = av_malloc_array(nb_vals, 4 * sizeof(*vals));
+    if (!vals)
+        return AVERROR(ENOMEM);
+    clipvals = vals     + nb_vals;
+    negvals  = clipvals + nb_vals;
+    res      = negvals  + nb_vals;
+    const_arrays[VAR_VAL]     = vals;
+    const_arrays[VAR_CLIPVAL] = clipvals;
+    const_arrays[VAR_NEGVAL]  = negvals;
+
     for (color = 0; color < desc->nb_components; color++) {
-        double res;
         int comp = s->is_rgb ? rgba_map[color] : color;
 
         /* create the parsed expression */
@@ -287,33 +300,55 @@ static int config_props(AVFilterLink *inlink)
             av_log(ctx, AV_LOG_ERROR,
                    "Error when parsing the expression '%s' for the component %d and color %d.\n",
                    s->comp_expr_str[comp], comp, color);
-            return AVERROR(EINVAL);
+            ret = AVERROR(EINVAL);
+            goto end;
         }
 
         /* compute the lut */
         s->var_values[VAR_MAXVAL] = max[color];
         s->var_values[VAR_MINVAL] = min[color];
 
-        for (val = 0; val < (1 << desc->comp[0].depth); val++) {
-            s->var_values[VAR_VAL] = val;
-            s->var_values[VAR_CLIPVAL] = av_clip(val, min[color], max[color]);
-            s->var_values[VAR_NEGVAL] =
-                av_clip(min[color] + max[color] - s->var_values[VAR_VAL],
-                        min[color], max[color]);
+        for (val = 0; val < nb_vals; val++) {
+            vals[val]     = val;
+            clipvals[val] = av_clip(val, min[color], max[color]);
+            negvals[val]  = av_clip(min[color] + max[color] - vals[val],
+                                    min[color], max[color]);
+        }
 
-            res = av_expr_eval(s->comp_expr[color], s->var_values, s);
-            if (isnan(res)) {
+        /* gammaval() and gammaval709() read the current value from the context,
+         * so they need the values to be evaluated one at a time */
+        memset(func_calls, 0, sizeof(func_calls));
+        av_expr_count_func(s->comp_expr[color], func_calls,
+                           FF_ARRAY_ELEMS(func_calls), 1);
+        if (func_calls[1] || func_calls[2]) {
+            for (val = 0; val < nb_vals; val++) {
+                s->var_values[VAR_VAL]     = vals[val];
+                s->var_values[VAR_CLIPVAL] = clipvals[val];
+                s->var_values[VAR_NEGVAL]  = negvals[val];
+                res[val] = av_expr_eval(s->comp_expr[color], s->var_values, s);
+            }
+        } else {
+            av_expr_eval_batch(s->comp_expr[color], res, nb_vals,
+                               s->var_values, const_arrays, s);
+        }
+
+        for (val = 0; val < nb_vals; val++) {
+            if (isnan(res[val])) {
                 av_log(ctx, AV_LOG_ERROR,
                        "Error when evaluating the expression '%s' for the value %d for the component %d.\n",
                        s->comp_expr_str[color], val, comp);
-                return AVERROR(EINVAL);
+                ret = AVERROR(EINVAL);
+                goto end;
             }
-            s->lut[comp][val] = av_clip((int)res, min[color], max[color]);
+            s->lut[comp][val] = av_clip((int)res[val], min[color], max[color]);
             av_log(ctx, AV_LOG_DEBUG, "val[%d][%d] = %d\n", comp, val, s->lut[comp][val]);
         }
     }
+    ret = 0;
 
-    return 0;
+end:
+    av_free(vals);
+    return ret;
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
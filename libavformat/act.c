@@ -202,6 +202,10 @@ AVInputFormat ff_act_demuxer = {
     .long_name      = "ACT Voice file format",
     .priv_data_size = sizeof(ACTContext),
     .read_probe     = probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "RIFF", 4 },
+        { 0 }
+    },
     .read_header    = read_header,
     .read_packet    = read_packet,
 };
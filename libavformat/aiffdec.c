@@ -389,6 +389,10 @@ AVInputFormat ff_aiff_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("Audio IFF"),
     .priv_data_size = sizeof(AIFFInputContext),
     .read_probe     = aiff_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "FORM", 4 },
+        { 0 }
+    },
     .read_header    = aiff_read_header,
     .read_packet    = aiff_read_packet,
     .read_seek      = ff_pcm_read_seek,
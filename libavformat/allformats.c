@@ -395,6 +395,7 @@ void av_register_all(void)
     REGISTER_PROTOCOL(UDP,              udp);
     REGISTER_PROTOCOL(UDPLITE,          udplite);
     REGISTER_PROTOCOL(UNIX,             unix);
+    REGISTER_PROTOCOL(URING,            uring);
 
     /* external libraries */
     REGISTER_MUXER   (CHROMAPRINT,      chromaprint);
@@ -464,6 +464,10 @@ AVInputFormat ff_ape_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("Monkey's Audio"),
     .priv_data_size = sizeof(APEContext),
     .read_probe     = ape_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "MAC ", 4 },
+        { 0 }
+    },
     .read_header    = ape_read_header,
     .read_packet    = ape_read_packet,
     .read_close     = ape_read_close,
@@ -1684,6 +1684,10 @@ AVInputFormat ff_asf_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("ASF (Advanced / Active Streaming Format)"),
     .priv_data_size = sizeof(ASFContext),
     .read_probe     = asf_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, (const char *)ff_asf_header, sizeof(ff_asf_header) },
+        { 0 }
+    },
     .read_header    = asf_read_header,
     .read_packet    = asf_read_packet,
     .read_close     = asf_read_close,
@@ -153,6 +153,10 @@ AVInputFormat ff_au_demuxer = {
     .name        = "au",
     .long_name   = NULL_IF_CONFIG_SMALL("Sun AU"),
     .read_probe  = au_probe,
+    .signatures  = (const FFProbeSignature[]) {
+        { 0, ".snd", 4 },
+        { 0 }
+    },
     .read_header = au_read_header,
     .read_packet = ff_pcm_read_packet,
     .read_seek   = ff_pcm_read_seek,
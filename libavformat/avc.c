@@ -20,6 +20,9 @@
  */
 
 #include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavcodec/get_bits.h"
+#include "libavcodec/golomb.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avc.h"
@@ -208,3 +211,179 @@ const uint8_t *ff_avc_mp4_find_startcode(const uint8_t *start,
 
     return start + res;
 }
+
+const AVRational ff_avc_sample_aspect_ratio[17] = {
+    {   0,  1 }, {   1,  1 }, {  12, 11 }, {  10, 11 },
+    {  16, 11 }, {  40, 33 }, {  24, 11 }, {  20, 11 },
+    {  32, 11 }, {  80, 33 }, {  18, 11 }, {  15, 11 },
+    {  64, 33 }, { 160, 99 }, {   4,  3 }, {   3,  2 },
+    {   2,  1 },
+};
+
+static int avc_skip_scaling_list(GetBitContext *gb, int size)
+{
+    int i, last = 8, next = 8;
+
+    for (i = 0; i < size && next; i++) {
+        int delta = get_se_golomb_long(gb);
+        if (delta < -128 || delta > 127)
+            return AVERROR_INVALIDDATA;
+        next = (last + delta) & 0xff;
+        last = next ? next : last;
+    }
+    return 0;
+}
+
+static int avc_decode_sps(H264SPS *sps, const uint8_t *nal, int size)
+{
+    GetBitContext gb;
+    uint8_t *rbsp;
+    int i, j, ret, len = 0;
+    unsigned mb_width, map_height, crop[4] = { 0 };
+    int crop_unit_x, crop_unit_y;
+
+    rbsp = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!rbsp)
+        return AVERROR(ENOMEM);
+    /* remove the NAL header and the emulation prevention bytes */
+    for (i = 1; i < size; i++) {
+        if (i + 2 < size && !nal[i] && !nal[i + 1] && nal[i + 2] == 3) {
+            rbsp[len++] = nal[i++];
+            rbsp[len++] = nal[i++];
+        } else
+            rbsp[len++] = nal[i];
+    }
+    ret = init_get_bits8(&gb, rbsp, len);
+    if (ret < 0)
+        goto end;
+
+    memset(sps, 0, sizeof(*sps));
+    sps->profile_idc          = get_bits(&gb, 8);
+    sps->constraint_set_flags = get_bits(&gb, 8);
+    sps->level_idc            = get_bits(&gb, 8);
+    sps->id                   = get_ue_golomb_long(&gb);
+    sps->chroma_format_idc    = 1;
+    sps->bit_depth            = 8;
+    sps->sar                  = (AVRational){ 0, 1 };
+
+    switch (sps->profile_idc) {
+    case 100: case 110: case 122: case 244: case  44:
+    case  83: case  86: case 118: case 128: case 138:
+    case 139: case 134: case 135:
+        sps->chroma_format_idc = get_ue_golomb_long(&gb);
+        if (sps->chroma_format_idc > 3) {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        if (sps->chroma_format_idc == 3)
+            skip_bits1(&gb);                // separate_colour_plane_flag
+        sps->bit_depth = get_ue_golomb_long(&gb) + 8;
+        get_ue_golomb_long(&gb);            // bit_depth_chroma_minus8
+        skip_bits1(&gb);                    // qpprime_y_zero_transform_bypass_flag
+        if (get_bits1(&gb)) {               // seq_scaling_matrix_present_flag
+            for (j = 0; j < (sps->chroma_format_idc != 3 ? 8 : 12); j++) {
+                if (get_bits1(&gb) &&
+                    (ret = avc_skip_scaling_list(&gb, j < 6 ? 16 : 64)) < 0)
+                    goto end;
+            }
+        }
+        break;
+    }
+
+    get_ue_golomb_long(&gb);                // log2_max_frame_num_minus4
+    switch (get_ue_golomb_long(&gb)) {     // pic_order_cnt_type
+    case 0:
+        get_ue_golomb_long(&gb);            // log2_max_pic_order_cnt_lsb_minus4
+        break;
+    case 1:
+        skip_bits1(&gb);                    // delta_pic_order_always_zero_flag
+        get_se_golomb_long(&gb);            // offset_for_non_ref_pic
+        get_se_golomb_long(&gb);            // offset_for_top_to_bottom_field
+        j = get_ue_golomb_long(&gb);        // num_ref_frames_in_pic_order_cnt_cycle
+        if (j > 255) {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        while (j--)
+            get_se_golomb_long(&gb);        // offset_for_ref_frame
+        break;
+    }
+    get_ue_golomb_long(&gb);                // max_num_ref_frames
+    skip_bits1(&gb);                        // gaps_in_frame_num_value_allowed_flag
+    mb_width   = get_ue_golomb_long(&gb) + 1;
+    map_height = get_ue_golomb_long(&gb) + 1;
+    sps->frame_mbs_only_flag = get_bits1(&gb);
+    if (!sps->frame_mbs_only_flag)
+        skip_bits1(&gb);                    // mb_adaptive_frame_field_flag
+    skip_bits1(&gb);                        // direct_8x8_inference_flag
+    if (get_bits1(&gb)) {                   // frame_cropping_flag
+        for (j = 0; j < 4; j++)
+            crop[j] = get_ue_golomb_long(&gb);
+    }
+
+    crop_unit_x = sps->chroma_format_idc == 1 || sps->chroma_format_idc == 2 ? 2 : 1;
+    crop_unit_y = (sps->chroma_format_idc == 1 ? 2 : 1) * (2 - sps->frame_mbs_only_flag);
+    if (mb_width > 1024 || map_height > 1024 ||
+        crop[0] + crop[1] >= mb_width * 16 / crop_unit_x ||
+        crop[2] + crop[3] >= map_height * (2 - sps->frame_mbs_only_flag) * 16 / crop_unit_y) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    sps->width  = mb_width * 16 - crop_unit_x * (crop[0] + crop[1]);
+    sps->height = map_height * (2 - sps->frame_mbs_only_flag) * 16 -
+                  crop_unit_y * (crop[2] + crop[3]);
+
+    if (get_bits1(&gb)) {                   // vui_parameters_present_flag
+        if (get_bits1(&gb)) {               // aspect_ratio_info_present_flag
+            int aspect_ratio_idc = get_bits(&gb, 8);
+            if (aspect_ratio_idc == 255) {
+                sps->sar.num = get_bits(&gb, 16);
+                sps->sar.den = get_bits(&gb, 16);
+            } else if (aspect_ratio_idc < FF_ARRAY_ELEMS(ff_avc_sample_aspect_ratio))
+                sps->sar = ff_avc_sample_aspect_ratio[aspect_ratio_idc];
+        }
+        if (get_bits1(&gb))                 // overscan_info_present_flag
+            skip_bits1(&gb);                // overscan_appropriate_flag
+        sps->video_signal_type_present_flag = get_bits1(&gb);
+        if (sps->video_signal_type_present_flag) {
+            skip_bits(&gb, 3);              // video_format
+            sps->full_range = get_bits1(&gb);
+            sps->colour_description_present_flag = get_bits1(&gb);
+            if (sps->colour_description_present_flag) {
+                sps->colour_primaries         = get_bits(&gb, 8);
+                sps->transfer_characteristics = get_bits(&gb, 8);
+                sps->matrix_coefficients      = get_bits(&gb, 8);
+            }
+        }
+    }
+
+    ret = get_bits_left(&gb) < 0 ? AVERROR_INVALIDDATA : 0;
+end:
+    av_free(rbsp);
+    return ret;
+}
+
+int ff_avc_decode_extradata_sps(H264SPS *sps, const uint8_t *extradata, int size)
+{
+    const uint8_t *p = extradata, *end = extradata + size, *nal_end;
+
+    if (size >= 8 && extradata[0] == 1) {
+        int sps_size = AV_RB16(extradata + 6);
+        if (!(extradata[5] & 0x1f) || sps_size > size - 8)
+            return AVERROR_INVALIDDATA;
+        return avc_decode_sps(sps, extradata + 8, sps_size);
+    }
+
+    p = ff_avc_find_startcode(p, end);
+    while (p < end) {
+        while (p < end && !*p)
+            p++;
+        if (++p >= end)
+            break;
+        nal_end = ff_avc_find_startcode(p, end);
+        if ((*p & 0x1f) == 7)
+            return avc_decode_sps(sps, p, nal_end - p);
+        p = nal_end;
+    }
+    return AVERROR_INVALIDDATA;
+}
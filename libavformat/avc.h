@@ -23,8 +23,34 @@
 #define AVFORMAT_AVC_H
 
 #include <stdint.h>
+#include "libavutil/rational.h"
 #include "avio.h"
 
+typedef struct H264SPS {
+    uint8_t id;
+    uint8_t profile_idc;
+    uint8_t level_idc;
+    uint8_t constraint_set_flags;
+    uint8_t chroma_format_idc;
+    uint8_t bit_depth;
+    uint8_t frame_mbs_only_flag;
+    int width;                  ///< frame width after cropping
+    int height;                 ///< frame height after cropping
+    AVRational sar;
+    uint8_t video_signal_type_present_flag;
+    uint8_t full_range;
+    uint8_t colour_description_present_flag;
+    uint8_t colour_primaries;
+    uint8_t transfer_characteristics;
+    uint8_t matrix_coefficients;
+} H264SPS;
+
+/**
+ * Sample aspect ratios of the aspect_ratio_idc values of the H.264 and
+ * HEVC VUI.
+ */
+extern const AVRational ff_avc_sample_aspect_ratio[17];
+
 int ff_avc_parse_nal_units(AVIOContext *s, const uint8_t *buf, int size);
 int ff_avc_parse_nal_units_buf(const uint8_t *buf_in, uint8_t **buf, int *size);
 int ff_isom_write_avcc(AVIOContext *pb, const uint8_t *data, int len);
@@ -34,4 +60,13 @@ const uint8_t *ff_avc_mp4_find_startcode(const uint8_t *start,
                                          const uint8_t *end,
                                          int nal_length_size);
 
+/**
+ * Parse the first SPS of H.264 extradata, up to the video signal type
+ * of its VUI.
+ *
+ * @param extradata extradata in avcC or Annex B format
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_avc_decode_extradata_sps(H264SPS *sps, const uint8_t *extradata, int size);
+
 #endif /* AVFORMAT_AVC_H */
@@ -753,6 +753,15 @@ typedef struct AVInputFormat {
      * @see avdevice_capabilities_free() for more details.
      */
     int (*free_device_capabilities)(struct AVFormatContext *s, struct AVDeviceCapabilitiesQuery *caps);
+
+    /**
+     * List of byte signatures, terminated by an entry with a size of 0.
+     * Demuxers whose read_probe() recognizes files by a fixed signature
+     * with a score of PROBE_SIGNATURE_SCORE or more can list it here, their
+     * read_probe() is then tried first on matching data and the probe of
+     * all the other demuxers is skipped when it is conclusive.
+     */
+    const struct FFProbeSignature *signatures;
 } AVInputFormat;
 /**
  * @}
@@ -992,6 +1001,11 @@ typedef struct AVStream {
         int64_t fps_last_dts;
         int     fps_last_dts_idx;
 
+        /**
+         * The codec parameters were complete before any packet was read,
+         * the stream is not decoded with AVFMT_FLAG_FAST_INFO.
+         */
+        int params_from_header;
     } *info;
 
     int pts_wrap_bits; /**< number of bits in pts (used for wrapping control) */
@@ -1392,6 +1406,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Don't merge side data but keep it separate.
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
+#define AVFMT_FLAG_FAST_INFO  0x100000 ///< Take the codec parameters from the headers instead of decoding in avformat_find_stream_info() when possible
 
     /**
      * Maximum size of the data read from input for determining
@@ -1916,6 +1916,11 @@ AVInputFormat ff_avi_demuxer = {
     .priv_data_size = sizeof(AVIContext),
     .extensions     = "avi",
     .read_probe     = avi_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "RIFF", 4 },
+        { 0, "ON2 ", 4 },
+        { 0 }
+    },
     .read_header    = avi_read_header,
     .read_packet    = avi_read_packet,
     .read_close     = avi_read_close,
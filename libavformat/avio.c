@@ -32,6 +32,19 @@
 #include "url.h"
 
 static URLProtocol *first_protocol = NULL;
+static URLProtocol **last_protocol = &first_protocol;
+
+/* registered protocols hashed by name, in registration order */
+static URLProtocol *protocols_by_name[64];
+
+static unsigned protocol_name_hash(const char *name)
+{
+    unsigned hash = 0;
+
+    while (*name)
+        hash = hash * 31 + (uint8_t)*name++;
+    return hash % FF_ARRAY_ELEMS(protocols_by_name);
+}
 
 URLProtocol *ffurl_protocol_next(const URLProtocol *prev)
 {
@@ -98,11 +111,18 @@ const char *avio_enum_protocols(void **opaque, int output)
 int ffurl_register_protocol(URLProtocol *protocol)
 {
     URLProtocol **p;
-    p = &first_protocol;
+    p = last_protocol;
     while (*p)
         p = &(*p)->next;
     *p             = protocol;
     protocol->next = NULL;
+    last_protocol  = &protocol->next;
+
+    p = &protocols_by_name[protocol_name_hash(protocol->name)];
+    while (*p)
+        p = &(*p)->next_by_name;
+    *p                     = protocol;
+    protocol->next_by_name = NULL;
     return 0;
 }
 
@@ -256,15 +276,15 @@ static struct URLProtocol *url_find_protocol(const char *filename)
     if ((ptr = strchr(proto_nested, '+')))
         *ptr = '\0';
 
-    while (up = ffurl_protocol_next(up)) {
+    for (up = protocols_by_name[protocol_name_hash(proto_str)]; up; up = up->next_by_name)
         if (!strcmp(proto_str, up->name))
-            break;
+            return up;
+    for (up = protocols_by_name[protocol_name_hash(proto_nested)]; up; up = up->next_by_name)
         if (up->flags & URL_PROTOCOL_FLAG_NESTED_SCHEME &&
             !strcmp(proto_nested, up->name))
-            break;
-    }
+            return up;
 
-    return up;
+    return NULL;
 }
 
 int ffurl_alloc(URLContext **puc, const char *filename, int flags,
@@ -437,6 +437,10 @@ AVInputFormat ff_caf_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("Apple CAF (Core Audio Format)"),
     .priv_data_size = sizeof(CafContext),
     .read_probe     = probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "caff", 4 },
+        { 0 }
+    },
     .read_header    = read_header,
     .read_packet    = read_packet,
     .read_seek      = read_seek,
@@ -18,11 +18,14 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -62,6 +65,14 @@ typedef struct {
     int eof;
     ConcatMatchMode stream_match_mode;
     unsigned auto_convert;
+    int preopen;
+#if HAVE_THREADS
+    pthread_t preopen_thread;
+    int preopen_running;
+    unsigned preopen_fileno;    ///< file being opened by preopen_thread
+    AVFormatContext *preopen_avf;
+    int preopen_ret;
+#endif
 } ConcatContext;
 
 static int concat_probe(AVProbeData *probe)
@@ -285,30 +296,115 @@ static int match_streams(AVFormatContext *avf)
     return 0;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+/**
+ * Open and probe a file and seek to its inpoint.
+ * This only reads the file entry and avf, so it can run in the background.
+ */
+static int open_input(AVFormatContext *avf, ConcatFile *file,
+                      AVFormatContext **pctx)
 {
-    ConcatContext *cat = avf->priv_data;
-    ConcatFile *file = &cat->files[fileno];
+    AVFormatContext *ctx;
     int ret;
 
-    if (cat->avf)
-        avformat_close_input(&cat->avf);
-
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
+    ctx = avformat_alloc_context();
+    if (!ctx)
         return AVERROR(ENOMEM);
 
-    cat->avf->interrupt_callback = avf->interrupt_callback;
+    ctx->interrupt_callback = avf->interrupt_callback;
 
-    if ((ret = ff_copy_whitelists(cat->avf, avf)) < 0)
+    if ((ret = ff_copy_whitelists(ctx, avf)) < 0) {
+        avformat_free_context(ctx);
         return ret;
+    }
 
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, NULL)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
+    if ((ret = avformat_open_input(&ctx, file->url, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(ctx, NULL)) < 0) {
         av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
-        avformat_close_input(&cat->avf);
+        avformat_close_input(&ctx);
         return ret;
     }
+    if (file->inpoint != AV_NOPTS_VALUE) {
+        ret = avformat_seek_file(ctx, -1, INT64_MIN, file->inpoint, file->inpoint, 0);
+        if (ret < 0) {
+            avformat_close_input(&ctx);
+            return ret;
+        }
+    }
+    *pctx = ctx;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *preopen_thread(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    cat->preopen_ret = open_input(avf, &cat->files[cat->preopen_fileno],
+                                  &cat->preopen_avf);
+    return NULL;
+}
+#endif
+
+/**
+ * Wait for the background opening of a file to finish.
+ * @return 1 and the opened context (or the error) if it was fileno,
+ *         0 if nothing was opened for fileno
+ */
+static int preopen_wait(ConcatContext *cat, unsigned fileno,
+                        AVFormatContext **pctx, int *ret)
+{
+#if HAVE_THREADS
+    if (!cat->preopen_running)
+        return 0;
+    pthread_join(cat->preopen_thread, NULL);
+    cat->preopen_running = 0;
+    if (cat->preopen_fileno == fileno) {
+        *pctx = cat->preopen_avf;
+        *ret  = cat->preopen_ret;
+        cat->preopen_avf = NULL;
+        return 1;
+    }
+    avformat_close_input(&cat->preopen_avf);
+#endif
+    return 0;
+}
+
+static void preopen_start(AVFormatContext *avf, unsigned fileno)
+{
+#if HAVE_THREADS
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    if (!cat->preopen || fileno >= cat->nb_files)
+        return;
+    cat->preopen_fileno = fileno;
+    cat->preopen_avf    = NULL;
+    ret = pthread_create(&cat->preopen_thread, NULL, preopen_thread, avf);
+    if (ret) {
+        av_log(avf, AV_LOG_WARNING, "pthread_create failed: %s, "
+               "the next file will be opened when needed\n", strerror(ret));
+        return;
+    }
+    cat->preopen_running = 1;
+#endif
+}
+
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    AVFormatContext *ctx = NULL;
+    int ret;
+
+    if (cat->avf)
+        avformat_close_input(&cat->avf);
+
+    if (!preopen_wait(cat, fileno, &ctx, &ret))
+        ret = open_input(avf, file, &ctx);
+    if (ret < 0)
+        return ret;
+    cat->avf = ctx;
     cat->cur_file = file;
     if (file->start_time == AV_NOPTS_VALUE)
         file->start_time = !fileno ? 0 :
@@ -318,18 +414,19 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
     file->file_inpoint = (file->inpoint == AV_NOPTS_VALUE) ? file->file_start_time : file->inpoint;
     if ((ret = match_streams(avf)) < 0)
         return ret;
-    if (file->inpoint != AV_NOPTS_VALUE) {
-       if ((ret = avformat_seek_file(cat->avf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
-           return ret;
-    }
+    preopen_start(avf, fileno + 1);
     return 0;
 }
 
 static int concat_read_close(AVFormatContext *avf)
 {
     ConcatContext *cat = avf->priv_data;
+    AVFormatContext *ctx = NULL;
     unsigned i;
+    int ret;
 
+    /* nb_files matches no file, a pending preopened one is closed */
+    preopen_wait(cat, cat->nb_files, &ctx, &ret);
     if (cat->avf)
         avformat_close_input(&cat->avf);
     for (i = 0; i < cat->nb_files; i++) {
@@ -704,6 +801,8 @@ static const AVOption options[] = {
       OFFSET(safe), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 1, DEC },
     { "auto_convert", "automatically convert bitstream format",
       OFFSET(auto_convert), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, DEC },
+    { "preopen", "open the next file in the background",
+      OFFSET(preopen), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { NULL }
 };
 
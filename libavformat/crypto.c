@@ -26,7 +26,7 @@
 #include "internal.h"
 #include "url.h"
 
-#define MAX_BUFFER_BLOCKS 150
+#define MAX_BUFFER_BLOCKS 2048
 #define BLOCKSIZE 16
 
 typedef struct CryptoContext {
@@ -175,7 +175,8 @@ err:
 static int crypto_read(URLContext *h, uint8_t *buf, int size)
 {
     CryptoContext *c = h->priv_data;
-    int blocks;
+    uint8_t *out;
+    int blocks, len;
 retry:
     if (c->outdata > 0) {
         size = FFMIN(size, c->outdata);
@@ -202,10 +203,17 @@ retry:
         return AVERROR_EOF;
     if (!c->eof)
         blocks--;
-    av_aes_crypt(c->aes_decrypt, c->outbuffer, c->inbuffer + c->indata_used,
+    // Decrypt as many whole blocks as fit straight into the caller's
+    // buffer, in a single call, and only go through outbuffer for reads
+    // smaller than a block.
+    if (size >= BLOCKSIZE) {
+        blocks = FFMIN(blocks, size / BLOCKSIZE);
+        out    = buf;
+    } else
+        out    = c->outbuffer;
+    av_aes_crypt(c->aes_decrypt, out, c->inbuffer + c->indata_used,
                  blocks, c->decrypt_iv, 1);
-    c->outdata      = BLOCKSIZE * blocks;
-    c->outptr       = c->outbuffer;
+    len             = BLOCKSIZE * blocks;
     c->indata_used += BLOCKSIZE * blocks;
     if (c->indata_used >= sizeof(c->inbuffer)/2) {
         memmove(c->inbuffer, c->inbuffer + c->indata_used,
@@ -213,11 +221,18 @@ retry:
         c->indata     -= c->indata_used;
         c->indata_used = 0;
     }
-    if (c->eof) {
+    if (c->eof && c->indata - c->indata_used < BLOCKSIZE) {
         // Remove PKCS7 padding at the end
-        int padding = c->outbuffer[c->outdata - 1];
-        c->outdata -= padding;
+        int padding = out[len - 1];
+        len -= padding;
+    }
+    if (out == buf) {
+        if (len > 0)
+            return len;
+        goto retry;
     }
+    c->outdata = len;
+    c->outptr  = c->outbuffer;
     goto retry;
 }
 
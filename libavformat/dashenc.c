@@ -74,6 +74,11 @@ typedef struct OutputStream {
     char bandwidth_str[64];
 
     char codec_str[100];
+
+    /* chunked mode: the media segment is opened on its first packet */
+    char filename[1024], full_path[1024];
+    int64_t seg_start_pos;
+    int64_t frag_start_pts;
 } OutputStream;
 
 typedef struct DASHContext {
@@ -81,6 +86,7 @@ typedef struct DASHContext {
     int window_size;
     int extra_window_size;
     int min_seg_duration;
+    int64_t frag_duration;
     int remove_at_exit;
     int use_template;
     int use_timeline;
@@ -193,6 +199,18 @@ static void dash_free(AVFormatContext *s)
     av_freep(&c->streams);
 }
 
+// ISO/IEC 23009-1:2014 5.3.9.5.3, a chunked segment can be requested once
+// its first chunk is complete.
+static void write_availability_time_offset(AVIOContext *out, DASHContext *c)
+{
+    int64_t seg_duration = c->last_duration ? c->last_duration : c->min_seg_duration;
+
+    if (!c->frag_duration || seg_duration <= c->frag_duration)
+        return;
+    avio_printf(out, "availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\" ",
+                (double)(seg_duration - c->frag_duration) / AV_TIME_BASE);
+}
+
 static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c)
 {
     int i, start_index = 0, start_number = 1;
@@ -206,6 +224,7 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
+        write_availability_time_offset(out, c);
         avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
         if (c->use_timeline) {
             int64_t cur_time = 0;
@@ -234,7 +253,9 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         avio_printf(out, "\t\t\t\t</SegmentTemplate>\n");
     } else if (c->single_file) {
         avio_printf(out, "\t\t\t\t<BaseURL>%s</BaseURL>\n", os->initfile);
-        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n", AV_TIME_BASE, c->last_duration, start_number);
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" ", AV_TIME_BASE, c->last_duration);
+        write_availability_time_offset(out, c);
+        avio_printf(out, "startNumber=\"%d\">\n", start_number);
         avio_printf(out, "\t\t\t\t\t<Initialization range=\"%"PRId64"-%"PRId64"\" />\n", os->init_start_pos, os->init_start_pos + os->init_range_length - 1);
         for (i = start_index; i < os->nb_segments; i++) {
             Segment *seg = os->segments[i];
@@ -245,7 +266,9 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         }
         avio_printf(out, "\t\t\t\t</SegmentList>\n");
     } else {
-        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n", AV_TIME_BASE, c->last_duration, start_number);
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" ", AV_TIME_BASE, c->last_duration);
+        write_availability_time_offset(out, c);
+        avio_printf(out, "startNumber=\"%d\">\n", start_number);
         avio_printf(out, "\t\t\t\t\t<Initialization sourceURL=\"%s\" />\n", os->initfile);
         for (i = start_index; i < os->nb_segments; i++) {
             Segment *seg = os->segments[i];
@@ -442,8 +465,10 @@ static int write_manifest(AVFormatContext *s, int final)
     char temp_filename[1024];
     int ret, i;
     AVDictionaryEntry *title = av_dict_get(s->metadata, "title", NULL, 0);
+    const char *proto = avio_find_protocol_name(s->filename);
+    int use_rename = proto && !strcmp(proto, "file");
 
-    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", s->filename);
+    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
     ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
@@ -537,7 +562,7 @@ static int write_manifest(AVFormatContext *s, int final)
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
     avio_close(out);
-    return ff_rename(temp_filename, s->filename, s);
+    return use_rename ? ff_rename(temp_filename, s->filename, s) : 0;
 }
 
 static int dash_write_header(AVFormatContext *s)
@@ -725,6 +750,52 @@ static void write_styp(AVIOContext *pb)
     ffio_wfourcc(pb, "msix");
 }
 
+static void flush_init_segment(DASHContext *c, OutputStream *os)
+{
+    av_write_frame(os->ctx, NULL);
+    os->init_range_length = avio_tell(os->ctx->pb);
+    if (!c->single_file) {
+        ffurl_close(os->out);
+        os->out = NULL;
+    }
+}
+
+/* In chunked mode, open the media segment as soon as its first packet has
+ * been muxed, so that chunks can be written to it while it is produced. */
+static int start_chunked_segment(AVFormatContext *s, int stream)
+{
+    DASHContext *c = s->priv_data;
+    OutputStream *os = &c->streams[stream];
+    int ret;
+
+    if (!os->init_range_length)
+        flush_init_segment(c, os);
+
+    os->seg_start_pos   = avio_tell(os->ctx->pb);
+    os->frag_start_pts = os->start_pts;
+
+    if (c->single_file) {
+        if (snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->initfile) >= sizeof(os->full_path))
+            goto too_long;
+        return 0;
+    }
+
+    dash_fill_tmpl_params(os->filename, sizeof(os->filename), c->media_seg_name, stream, os->segment_index, os->bit_rate, os->start_pts);
+    if (snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->filename) >= sizeof(os->full_path))
+        goto too_long;
+    // Clients fetch the segment while it grows, so no temporary file is used.
+    ret = ffurl_open(&os->out, os->full_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+    if (ret < 0)
+        return ret;
+    write_styp(os->ctx->pb);
+    avio_flush(os->ctx->pb);
+    return 0;
+
+too_long:
+    av_log(s, AV_LOG_ERROR, "Segment path too long\n");
+    return AVERROR(EINVAL);
+}
+
 static void find_index_range(AVFormatContext *s, const char *full_path,
                              int64_t pos, int *index_length)
 {
@@ -800,27 +871,33 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                 continue;
         }
 
-        if (!os->init_range_length) {
-            av_write_frame(os->ctx, NULL);
-            os->init_range_length = avio_tell(os->ctx->pb);
-            if (!c->single_file) {
-                ffurl_close(os->out);
-                os->out = NULL;
-            }
-        }
+        if (c->frag_duration) {
+            av_strlcpy(filename, os->filename, sizeof(filename));
+            av_strlcpy(full_path, os->full_path, sizeof(full_path));
+            start_pos = os->seg_start_pos;
+        } else {
+            if (!os->init_range_length)
+                flush_init_segment(c, os);
 
-        start_pos = avio_tell(os->ctx->pb);
+            start_pos = avio_tell(os->ctx->pb);
 
-        if (!c->single_file) {
-            dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path);
-            ret = ffurl_open(&os->out, temp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
-            if (ret < 0)
+            if (!c->single_file) {
+                dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
+                if (snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename) >= sizeof(full_path) ||
+                    snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path) >= sizeof(temp_path)) {
+                    av_log(s, AV_LOG_ERROR, "Segment path too long\n");
+                    ret = AVERROR(EINVAL);
+                    break;
+                }
+                ret = ffurl_open(&os->out, temp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+                if (ret < 0)
+                    break;
+                write_styp(os->ctx->pb);
+            } else if (snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile) >= sizeof(full_path)) {
+                av_log(s, AV_LOG_ERROR, "Segment path too long\n");
+                ret = AVERROR(EINVAL);
                 break;
-            write_styp(os->ctx->pb);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
+            }
         }
 
         av_write_frame(os->ctx, NULL);
@@ -833,9 +910,11 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         } else {
             ffurl_close(os->out);
             os->out = NULL;
-            ret = ff_rename(temp_path, full_path, s);
-            if (ret < 0)
-                break;
+            if (!c->frag_duration) {
+                ret = ff_rename(temp_path, full_path, s);
+                if (ret < 0)
+                    break;
+            }
         }
         add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, start_pos, range_length, index_length);
         av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
@@ -939,7 +1018,24 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
     else
         os->max_pts = FFMAX(os->max_pts, pkt->pts + pkt->duration);
     os->packets_written++;
-    return ff_write_chained(os->ctx, 0, pkt, s, 0);
+    if ((ret = ff_write_chained(os->ctx, 0, pkt, s, 0)) < 0)
+        return ret;
+
+    if (c->frag_duration) {
+        if (os->packets_written == 1 &&
+            (ret = start_chunked_segment(s, pkt->stream_index)) < 0)
+            return ret;
+
+        // Emit a moof/mdat pair as soon as enough data has been buffered,
+        // it is immediately available to clients reading the segment.
+        if (av_compare_ts(os->max_pts - os->frag_start_pts, st->time_base,
+                          c->frag_duration, AV_TIME_BASE_Q) >= 0) {
+            av_write_frame(os->ctx, NULL);
+            avio_flush(os->ctx->pb);
+            os->frag_start_pts = os->max_pts;
+        }
+    }
+    return 0;
 }
 
 static int dash_write_trailer(AVFormatContext *s)
@@ -981,6 +1077,7 @@ static const AVOption options[] = {
     { "window_size", "number of segments kept in the manifest", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "extra_window_size", "number of segments kept outside of the manifest before removing from disk", OFFSET(extra_window_size), AV_OPT_TYPE_INT, { .i64 = 5 }, 0, INT_MAX, E },
     { "min_seg_duration", "minimum segment duration (in microseconds)", OFFSET(min_seg_duration), AV_OPT_TYPE_INT64, { .i64 = 5000000 }, 0, INT_MAX, E },
+    { "frag_duration", "duration of the chunks written as soon as they are complete within a segment (in microseconds), 0 to write whole segments", OFFSET(frag_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT_MAX, E },
     { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
     { "use_template", "Use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
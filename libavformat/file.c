@@ -19,8 +19,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE     /* syscall() for io_uring */
 #include "libavutil/avstring.h"
+#include "libavutil/atomic.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
 #if HAVE_DIRENT_H
@@ -35,6 +39,11 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -75,11 +84,18 @@ typedef struct FileContext {
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+    int use_io_uring;
+    int io_uring_depth;
+    int io_uring_block_size;
+    struct FileRing *ring;
 } FileContext;
 
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "use io_uring for reads and writes", offsetof(FileContext, use_io_uring), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "set number of io_uring requests in flight", offsetof(FileContext, io_uring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_block_size", "set size of io_uring requests", offsetof(FileContext, io_uring_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 28, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -102,11 +118,451 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_LINUX_IO_URING_H
+/*
+ * io_uring backend of the file protocol.
+ *
+ * Reading keeps io_uring_depth blocks of io_uring_block_size bytes in flight
+ * ahead of the read position. Writes are gathered in blocks that are
+ * submitted when full, so that the caller only waits when all the blocks are
+ * in flight. All the requests use explicit offsets, the position of the
+ * descriptor is not used.
+ */
+
+typedef struct FileRingBlock {
+    uint8_t *buf;
+    int64_t offset;
+    int size;                   ///< bytes requested, or gathered for writing
+    int res;                    ///< result of the request
+    int pos;                    ///< bytes already returned by file_read()
+    int pending;
+} FileRingBlock;
+
+typedef struct FileRing {
+    int fd;
+    int write;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+
+    FileRingBlock *blocks;
+    int nb_blocks;
+    int block_size;
+    int head;                   ///< oldest block in use
+    int count;                  ///< blocks in flight (and done, when reading)
+    int64_t next_offset;        ///< offset of the next block
+    int64_t pos;                ///< logical position
+    int error;
+} FileRing;
+
+static int ring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                      unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   NULL, 0);
+}
+
+/**
+ * Check that the kernel implements the opcode used by the ring. Kernels
+ * before 5.6 accept io_uring_setup() but fail every IORING_OP_READ and
+ * IORING_OP_WRITE request; they do not know IORING_REGISTER_PROBE either.
+ */
+static int ring_probe(int fd, int write)
+{
+    int op = write ? IORING_OP_WRITE : IORING_OP_READ;
+    struct io_uring_probe *probe;
+    int ret;
+
+    probe = av_mallocz(sizeof(*probe) + 256 * sizeof(*probe->ops));
+    if (!probe)
+        return AVERROR(ENOMEM);
+    ret = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256);
+    if (ret < 0)
+        ret = AVERROR(errno);
+    else if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        ret = AVERROR(ENOSYS);
+    av_free(probe);
+    return ret;
+}
+
+static unsigned load_acquire(unsigned *p)
+{
+    return avpriv_atomic_int_get((volatile int *)p);
+}
+
+static void store_release(unsigned *p, unsigned v)
+{
+    avpriv_atomic_int_set((volatile int *)p, v);
+}
+
+static void ring_free(FileRing **pring)
+{
+    FileRing *r = *pring;
+    int i;
+
+    if (!r)
+        return;
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+        munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr)
+        munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    if (r->blocks)
+        for (i = 0; i < r->nb_blocks; i++)
+            av_free(r->blocks[i].buf);
+    av_freep(&r->blocks);
+    av_freep(pring);
+}
+
+static int ring_alloc(FileRing **pring, int depth, int block_size, int write)
+{
+    struct io_uring_params p = { 0 };
+    FileRing *r;
+    uint8_t *sq, *cq;
+    int i, ret;
+
+    r = av_mallocz(sizeof(*r));
+    if (!r)
+        return AVERROR(ENOMEM);
+    *pring = r;
+    r->write      = write;
+    r->nb_blocks  = depth;
+    r->block_size = block_size;
+
+    r->fd = ring_setup(depth, &p);
+    if (r->fd < 0) {
+        r->fd = -1;
+        return AVERROR(errno);
+    }
+    if ((ret = ring_probe(r->fd, write)) < 0)
+        return ret;
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_size = r->cq_size = FFMAX(r->sq_size, r->cq_size);
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        return AVERROR(errno);
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            return AVERROR(errno);
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        return AVERROR(errno);
+    }
+
+    sq = r->sq_ptr;
+    cq = r->cq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    r->blocks = av_mallocz_array(depth, sizeof(*r->blocks));
+    if (!r->blocks)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < depth; i++) {
+        r->blocks[i].buf = av_malloc(block_size);
+        if (!r->blocks[i].buf)
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int ring_submit(FileRing *r, int fd, int index)
+{
+    FileRingBlock *b = &r->blocks[index];
+    unsigned tail = *r->sq_tail, idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    int ret;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = r->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = fd;
+    sqe->addr      = (uintptr_t)b->buf;
+    sqe->len       = b->size;
+    sqe->off       = b->offset;
+    sqe->user_data = index;
+    r->sq_array[idx] = idx;
+    store_release(r->sq_tail, tail + 1);
+    b->pending = 1;
+
+    while ((ret = ring_enter(r->fd, 1, 0, 0)) < 0 && errno == EINTR);
+    if (ret < 0) {
+        /* the kernel consumed nothing, take the entry back so that
+         * waiting for the block does not hang */
+        ret = AVERROR(errno);
+        store_release(r->sq_tail, tail);
+        b->pending = 0;
+        return ret;
+    }
+    return 0;
+}
+
+static void ring_complete(FileRing *r, int fd, FileRingBlock *b, int res)
+{
+    b->pending = 0;
+    b->res     = res;
+    /* finish short writes synchronously, they should not happen on
+     * regular files anyway */
+    while (r->write && b->res >= 0 && b->res < b->size) {
+        ssize_t len = pwrite(fd, b->buf + b->res, b->size - b->res,
+                             b->offset + b->res);
+        if (len <= 0)
+            b->res = len < 0 ? AVERROR(errno) : AVERROR(EIO);
+        else
+            b->res += len;
+    }
+    if (r->write && b->res < 0 && !r->error)
+        r->error = b->res;
+}
+
+/**
+ * Reap completions until the given block is complete.
+ */
+static int ring_wait(FileRing *r, int fd, int index)
+{
+    while (r->blocks[index].pending) {
+        unsigned head = *r->cq_head;
+
+        if (head == load_acquire(r->cq_tail)) {
+            if (ring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+                errno != EINTR)
+                return AVERROR(errno);
+            continue;
+        }
+        for (; head != load_acquire(r->cq_tail); head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            ring_complete(r, fd, &r->blocks[cqe->user_data], cqe->res);
+        }
+        store_release(r->cq_head, head);
+    }
+    return 0;
+}
+
+/**
+ * Wait for all the requests and forget about the blocks read ahead.
+ */
+static int ring_drain(FileRing *r, int fd)
+{
+    int i, ret;
+
+    for (i = 0; i < r->nb_blocks; i++)
+        if ((ret = ring_wait(r, fd, i)) < 0)
+            return ret;
+    r->head  = 0;
+    r->count = 0;
+    return 0;
+}
+
+static int ring_read(FileContext *c, unsigned char *buf, int size)
+{
+    FileRing *r = c->ring;
+    FileRingBlock *b;
+    int ret, len;
+
+    while (r->count < r->nb_blocks) {
+        int index = (r->head + r->count) % r->nb_blocks;
+        b = &r->blocks[index];
+        b->offset = r->next_offset;
+        b->size   = r->block_size;
+        b->pos    = 0;
+        if ((ret = ring_submit(r, c->fd, index)) < 0)
+            return ret;
+        r->next_offset += r->block_size;
+        r->count++;
+    }
+
+    b = &r->blocks[r->head];
+    if ((ret = ring_wait(r, c->fd, r->head)) < 0)
+        return ret;
+    if (b->res <= 0) {
+        /* error or end of file, read again from here next time */
+        ret = b->res ? b->res : AVERROR_EOF;
+        if ((len = ring_drain(r, c->fd)) < 0)
+            return len;
+        r->next_offset = r->pos;
+        return ret;
+    }
+
+    len = FFMIN(size, b->res - b->pos);
+    memcpy(buf, b->buf + b->pos, len);
+    b->pos += len;
+    r->pos += len;
+    if (b->pos == b->res) {
+        if (b->res < b->size) {
+            /* short read, the blocks after it are not valid */
+            if ((ret = ring_drain(r, c->fd)) < 0)
+                return ret;
+            r->next_offset = r->pos;
+        } else {
+            r->head = (r->head + 1) % r->nb_blocks;
+            r->count--;
+        }
+    }
+    return len;
+}
+
+static int ring_flush(FileContext *c)
+{
+    FileRing *r = c->ring;
+    int ret, index = (r->head + r->count) % r->nb_blocks;
+
+    if (r->count < r->nb_blocks && r->blocks[index].size) {
+        if ((ret = ring_submit(r, c->fd, index)) < 0)
+            return ret;
+        r->count++;
+    }
+    if ((ret = ring_drain(r, c->fd)) < 0)
+        return ret;
+    r->blocks[0].size   = 0;
+    r->blocks[0].offset = r->pos;
+    return r->error;
+}
+
+static int ring_write(FileContext *c, const unsigned char *buf, int size)
+{
+    FileRing *r = c->ring;
+    FileRingBlock *b;
+    int ret, len, index;
+
+    if (r->error)
+        return r->error;
+
+    if (r->count == r->nb_blocks) {
+        /* all the blocks are in flight, wait for the oldest one */
+        if ((ret = ring_wait(r, c->fd, r->head)) < 0)
+            return ret;
+        if (r->error)
+            return r->error;
+        r->blocks[r->head].size = 0;
+        r->head = (r->head + 1) % r->nb_blocks;
+        r->count--;
+        b = &r->blocks[(r->head + r->count) % r->nb_blocks];
+        b->size   = 0;
+        b->offset = r->pos;
+    }
+
+    index = (r->head + r->count) % r->nb_blocks;
+    b     = &r->blocks[index];
+    len   = FFMIN(size, r->block_size - b->size);
+    memcpy(b->buf + b->size, buf, len);
+    b->size += len;
+    r->pos  += len;
+
+    if (b->size == r->block_size) {
+        if ((ret = ring_submit(r, c->fd, index)) < 0)
+            return ret;
+        r->count++;
+        if (r->count < r->nb_blocks) {
+            b = &r->blocks[(r->head + r->count) % r->nb_blocks];
+            b->size   = 0;
+            b->offset = r->pos;
+        }
+    }
+    return len;
+}
+
+static int64_t ring_seek(FileContext *c, int64_t pos, int whence)
+{
+    FileRing *r = c->ring;
+    struct stat st;
+    int ret;
+
+    if (r->write) {
+        if ((ret = ring_flush(c)) < 0)
+            return ret;
+    } else if (whence != AVSEEK_SIZE) {
+        if ((ret = ring_drain(r, c->fd)) < 0)
+            return ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += r->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    r->pos = r->next_offset = pos;
+    if (r->write)
+        r->blocks[0].offset = pos;
+    return pos;
+}
+
+static void ring_open(URLContext *h, int flags)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int ret;
+
+    if ((flags & AVIO_FLAG_READ) && (flags & AVIO_FLAG_WRITE)) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring is not used for read-write access\n");
+        return;
+    }
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring is only used for regular files\n");
+        return;
+    }
+    ret = ring_alloc(&c->ring, c->io_uring_depth, c->io_uring_block_size,
+                     flags & AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring unavailable (%s), "
+               "using plain reads and writes\n", av_err2str(ret));
+        ring_free(&c->ring);
+        return;
+    }
+    c->ring->pos = c->ring->next_offset = lseek(c->fd, 0, SEEK_CUR);
+    c->ring->blocks[0].offset = c->ring->pos;
+}
+#endif /* HAVE_LINUX_IO_URING_H */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring)
+        return ring_read(c, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -116,6 +572,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring)
+        return ring_write(c, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -223,6 +683,11 @@ static int file_open(URLContext *h, const char *filename, int flags)
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_LINUX_IO_URING_H
+    if (c->use_io_uring)
+        ring_open(h, flags);
+#endif
+
     return 0;
 }
 
@@ -232,6 +697,11 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring)
+        return ring_seek(c, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -246,7 +716,20 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    return close(c->fd);
+    int ret = 0;
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring) {
+        if (c->ring->write)
+            ret = ring_flush(c);
+        else
+            ring_drain(c->ring, c->fd);
+        ring_free(&c->ring);
+    }
+#endif
+    if (close(c->fd) < 0 && ret >= 0)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 static int file_open_dir(URLContext *h)
@@ -353,6 +836,38 @@ URLProtocol ff_file_protocol = {
 
 #endif /* CONFIG_FILE_PROTOCOL */
 
+#if CONFIG_URING_PROTOCOL
+
+static const AVClass uring_class = {
+    .class_name = "uring",
+    .item_name  = av_default_item_name,
+    .option     = file_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+static int uring_open(URLContext *h, const char *filename, int flags)
+{
+    FileContext *c = h->priv_data;
+
+    av_strstart(filename, "uring:", &filename);
+    c->use_io_uring = 1;
+    return file_open(h, filename, flags);
+}
+
+URLProtocol ff_uring_protocol = {
+    .name                = "uring",
+    .url_open            = uring_open,
+    .url_read            = file_read,
+    .url_write           = file_write,
+    .url_seek            = file_seek,
+    .url_close           = file_close,
+    .url_get_file_handle = file_get_handle,
+    .priv_data_size      = sizeof(FileContext),
+    .priv_data_class     = &uring_class,
+};
+
+#endif /* CONFIG_URING_PROTOCOL */
+
 #if CONFIG_PIPE_PROTOCOL
 
 static int pipe_open(URLContext *h, const char *filename, int flags)
@@ -1178,6 +1178,10 @@ AVInputFormat ff_flv_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("FLV (Flash Video)"),
     .priv_data_size = sizeof(FLVContext),
     .read_probe     = flv_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "FLV", 3 },
+        { 0 }
+    },
     .read_header    = flv_read_header,
     .read_packet    = flv_read_packet,
     .read_seek      = flv_read_seek,
@@ -1198,6 +1202,10 @@ AVInputFormat ff_live_flv_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("live RTMP FLV (Flash Video)"),
     .priv_data_size = sizeof(FLVContext),
     .read_probe     = live_flv_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "FLV", 3 },
+        { 0 }
+    },
     .read_header    = flv_read_header,
     .read_packet    = flv_read_packet,
     .read_seek      = flv_read_seek,
@@ -20,6 +20,7 @@
  */
 
 #include "libavutil/atomic.h"
+#include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/opt.h"
@@ -42,6 +43,85 @@ static AVOutputFormat *first_oformat = NULL;
 static AVInputFormat **last_iformat = &first_iformat;
 static AVOutputFormat **last_oformat = &first_oformat;
 
+typedef struct ProbeIndexEntry {
+    const FFProbeSignature *sig;
+    AVInputFormat *fmt;
+    struct ProbeIndexEntry *next;
+} ProbeIndexEntry;
+
+/**
+ * Input formats with byte signatures, indexed by the offset and the first
+ * byte of the signatures.
+ */
+static ProbeIndexEntry *probe_index[PROBE_SIGNATURE_MAX_OFFSET][256];
+
+typedef struct FormatNameEntry {
+    const char *name;           ///< one of the comma-separated format names
+    int len;
+    void *fmt;
+    struct FormatNameEntry *next;
+} FormatNameEntry;
+
+/**
+ * Registered formats hashed by each of their names, in registration order.
+ * The lookups fall back to walking the format lists if an entry could not
+ * be allocated.
+ */
+static FormatNameEntry *iformats_by_name[256];
+static FormatNameEntry *oformats_by_name[256];
+static int iformats_by_name_incomplete;
+static int oformats_by_name_incomplete;
+
+static unsigned format_name_hash(const char *name, int len)
+{
+    unsigned hash = 0;
+
+    while (len--)
+        hash = hash * 31 + av_tolower(*name++);
+    return hash % FF_ARRAY_ELEMS(iformats_by_name);
+}
+
+static void add_format_names(FormatNameEntry **table, int *incomplete,
+                             void *fmt, const char *names)
+{
+    while (names && *names) {
+        FormatNameEntry *entry, **p;
+        int len = strcspn(names, ",");
+
+        entry = av_mallocz(sizeof(*entry));
+        if (!entry) {
+            *incomplete = 1;
+            return;
+        }
+        entry->name = names;
+        entry->len  = len;
+        entry->fmt  = fmt;
+
+        p = &table[format_name_hash(names, len)];
+        while(*p || avpriv_atomic_ptr_cas((void * volatile *)p, NULL, entry))
+            p = &(*p)->next;
+
+        names += len + !!names[len];
+    }
+}
+
+/**
+ * @return the first entry after entry in the hash chain of name whose
+ *         name matches, or NULL
+ */
+static const FormatNameEntry *next_format_name(FormatNameEntry **table,
+                                               const FormatNameEntry *entry,
+                                               const char *name)
+{
+    int len = strlen(name);
+
+    entry = entry ? entry->next : table[format_name_hash(name, len)];
+    for (; entry; entry = entry->next)
+        if (entry->len == len && !av_strncasecmp(entry->name, name, len))
+            return entry;
+    return NULL;
+}
+
 AVInputFormat *av_iformat_next(const AVInputFormat *f)
 {
     if (f)
@@ -61,11 +141,31 @@ AVOutputFormat *av_oformat_next(const AVOutputFormat *f)
 void av_register_input_format(AVInputFormat *format)
 {
     AVInputFormat **p = last_iformat;
+    const FFProbeSignature *sig;
 
     format->next = NULL;
     while(*p || avpriv_atomic_ptr_cas((void * volatile *)p, NULL, format))
         p = &(*p)->next;
     last_iformat = &format->next;
+
+    add_format_names(iformats_by_name, &iformats_by_name_incomplete,
+                     format, format->name);
+
+    for (sig = format->signatures; sig && sig->size; sig++) {
+        ProbeIndexEntry *entry, **head;
+
+        av_assert0(sig->offset >= 0 && sig->offset < PROBE_SIGNATURE_MAX_OFFSET);
+        /* failing to index a format only makes probing it slower */
+        entry = av_mallocz(sizeof(*entry));
+        if (!entry)
+            break;
+        entry->sig = sig;
+        entry->fmt = format;
+        head = &probe_index[sig->offset][(uint8_t)sig->magic[0]];
+        do {
+            entry->next = *head;
+        } while (avpriv_atomic_ptr_cas((void * volatile *)head, entry->next, entry) != entry->next);
+    }
 }
 
 void av_register_output_format(AVOutputFormat *format)
@@ -76,6 +176,9 @@ void av_register_output_format(AVOutputFormat *format)
     while(*p || avpriv_atomic_ptr_cas((void * volatile *)p, NULL, format))
         p = &(*p)->next;
     last_oformat = &format->next;
+
+    add_format_names(oformats_by_name, &oformats_by_name_incomplete,
+                     format, format->name);
 }
 
 int av_match_ext(const char *filename, const char *extensions)
@@ -91,10 +194,27 @@ int av_match_ext(const char *filename, const char *extensions)
     return 0;
 }
 
+static int guess_format_score(AVOutputFormat *fmt, const char *short_name,
+                              const char *filename, const char *mime_type)
+{
+    int score = 0;
+
+    if (fmt->name && short_name && av_match_name(short_name, fmt->name))
+        score += 100;
+    if (fmt->mime_type && mime_type && !strcmp(fmt->mime_type, mime_type))
+        score += 10;
+    if (filename && fmt->extensions &&
+        av_match_ext(filename, fmt->extensions)) {
+        score += 5;
+    }
+    return score;
+}
+
 AVOutputFormat *av_guess_format(const char *short_name, const char *filename,
                                 const char *mime_type)
 {
     AVOutputFormat *fmt = NULL, *fmt_found;
+    const FormatNameEntry *entry = NULL;
     int score_max, score;
 
     /* specific test for image sequences */
@@ -108,16 +228,22 @@ AVOutputFormat *av_guess_format(const char *short_name, const char *filename,
     /* Find the proper file type. */
     fmt_found = NULL;
     score_max = 0;
-    while ((fmt = av_oformat_next(fmt))) {
-        score = 0;
-        if (fmt->name && short_name && av_match_name(short_name, fmt->name))
-            score += 100;
-        if (fmt->mime_type && mime_type && !strcmp(fmt->mime_type, mime_type))
-            score += 10;
-        if (filename && fmt->extensions &&
-            av_match_ext(filename, fmt->extensions)) {
-            score += 5;
+
+    /* a matching short name always wins, only those formats need a score */
+    if (short_name && !oformats_by_name_incomplete && !strchr(short_name, ',')) {
+        while ((entry = next_format_name(oformats_by_name, entry, short_name))) {
+            score = guess_format_score(entry->fmt, short_name, filename, mime_type);
+            if (score > score_max) {
+                score_max = score;
+                fmt_found = entry->fmt;
+            }
         }
+        if (fmt_found)
+            return fmt_found;
+    }
+
+    while ((fmt = av_oformat_next(fmt))) {
+        score = guess_format_score(fmt, short_name, filename, mime_type);
         if (score > score_max) {
             score_max = score;
             fmt_found = fmt;
@@ -160,12 +286,84 @@ enum AVCodecID av_guess_codec(AVOutputFormat *fmt, const char *short_name,
 AVInputFormat *av_find_input_format(const char *short_name)
 {
     AVInputFormat *fmt = NULL;
+
+    if (short_name && !iformats_by_name_incomplete && !strchr(short_name, ',')) {
+        const FormatNameEntry *entry = next_format_name(iformats_by_name, NULL, short_name);
+        return entry ? entry->fmt : NULL;
+    }
+
     while ((fmt = av_iformat_next(fmt)))
         if (av_match_name(short_name, fmt->name))
             return fmt;
     return NULL;
 }
 
+static int probe_format(AVInputFormat *fmt1, AVProbeData *lpd, int nodat)
+{
+    int score = 0;
+
+    if (fmt1->read_probe) {
+        score = fmt1->read_probe(lpd);
+        if (score)
+            av_log(NULL, AV_LOG_TRACE, "Probing %s score:%d size:%d\n", fmt1->name, score, lpd->buf_size);
+        if (fmt1->extensions && av_match_ext(lpd->filename, fmt1->extensions)) {
+            if      (nodat == 0) score = FFMAX(score, 1);
+            else if (nodat == 1) score = FFMAX(score, AVPROBE_SCORE_EXTENSION / 2 - 1);
+            else                 score = FFMAX(score, AVPROBE_SCORE_EXTENSION);
+        }
+    } else if (fmt1->extensions) {
+        if (av_match_ext(lpd->filename, fmt1->extensions))
+            score = AVPROBE_SCORE_EXTENSION;
+    }
+    if (av_match_name(lpd->mime_type, fmt1->mime_type))
+        score = FFMAX(score, AVPROBE_SCORE_MIME);
+    return score;
+}
+
+/**
+ * Probe the formats whose signature matches the start of the data.
+ * @return the format if it alone reached PROBE_SIGNATURE_SCORE, NULL otherwise
+ */
+static AVInputFormat *probe_signatures(AVProbeData *lpd, int is_opened,
+                                       int *score_ret)
+{
+    AVInputFormat *probed[16], *fmt = NULL;
+    int i, offset, nb_probed = 0, score, score_max = 0;
+
+    for (offset = 0; offset < FFMIN(lpd->buf_size, PROBE_SIGNATURE_MAX_OFFSET); offset++) {
+        const ProbeIndexEntry *entry = probe_index[offset][lpd->buf[offset]];
+
+        for (; entry; entry = entry->next) {
+            const FFProbeSignature *sig = entry->sig;
+
+            if (lpd->buf_size - offset < sig->size ||
+                memcmp(lpd->buf + offset, sig->magic, sig->size) ||
+                !is_opened == !(entry->fmt->flags & AVFMT_NOFILE))
+                continue;
+            for (i = 0; i < nb_probed; i++)
+                if (probed[i] == entry->fmt)
+                    break;
+            if (i < nb_probed)
+                continue;
+            if (nb_probed == FF_ARRAY_ELEMS(probed))
+                return NULL;
+            probed[nb_probed++] = entry->fmt;
+
+            score = probe_format(entry->fmt, lpd, 0);
+            if (score > score_max) {
+                score_max = score;
+                fmt       = entry->fmt;
+            } else if (score == score_max)
+                fmt = NULL;
+        }
+    }
+
+    if (score_max < PROBE_SIGNATURE_SCORE)
+        return NULL;
+    *score_ret = score_max;
+    return fmt;
+}
+
 AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened,
                                       int *score_ret)
 {
@@ -188,26 +386,15 @@ AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened,
             nodat = 1;
     }
 
+    /* a conclusive signature match makes probing every format unneeded */
+    if (!nodat && (fmt = probe_signatures(&lpd, is_opened, score_ret)))
+        return fmt;
+
     fmt = NULL;
     while ((fmt1 = av_iformat_next(fmt1))) {
         if (!is_opened == !(fmt1->flags & AVFMT_NOFILE) && strcmp(fmt1->name, "image2"))
             continue;
-        score = 0;
-        if (fmt1->read_probe) {
-            score = fmt1->read_probe(&lpd);
-            if (score)
-                av_log(NULL, AV_LOG_TRACE, "Probing %s score:%d size:%d\n", fmt1->name, score, lpd.buf_size);
-            if (fmt1->extensions && av_match_ext(lpd.filename, fmt1->extensions)) {
-                if      (nodat == 0) score = FFMAX(score, 1);
-                else if (nodat == 1) score = FFMAX(score, AVPROBE_SCORE_EXTENSION / 2 - 1);
-                else                 score = FFMAX(score, AVPROBE_SCORE_EXTENSION);
-            }
-        } else if (fmt1->extensions) {
-            if (av_match_ext(lpd.filename, fmt1->extensions))
-                score = AVPROBE_SCORE_EXTENSION;
-        }
-        if (av_match_name(lpd.mime_type, fmt1->mime_type))
-            score = FFMAX(score, AVPROBE_SCORE_MIME);
+        score = probe_format(fmt1, &lpd, nodat);
         if (score > score_max) {
             score_max = score;
             fmt       = fmt1;
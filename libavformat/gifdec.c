@@ -339,6 +339,10 @@ AVInputFormat ff_gif_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("CompuServe Graphics Interchange Format (GIF)"),
     .priv_data_size = sizeof(GIFDemuxContext),
     .read_probe     = gif_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "GIF8", 4 },
+        { 0 }
+    },
     .read_header    = gif_read_header,
     .read_packet    = gif_read_packet,
     .flags          = AVFMT_GENERIC_INDEX,
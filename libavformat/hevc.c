@@ -56,6 +56,7 @@ typedef struct HEVCDecoderConfigurationRecord {
     uint8_t  lengthSizeMinusOne;
     uint8_t  numOfArrays;
     HVCCNALUnitArray *array;
+    HEVCSPSInfo *sps_info;      ///< if set, filled with the parsed SPS fields
 } HEVCDecoderConfigurationRecord;
 
 typedef struct HVCCProfileTierLevel {
@@ -277,25 +278,32 @@ static void hvcc_parse_vui(GetBitContext *gb,
                            HEVCDecoderConfigurationRecord *hvcc,
                            unsigned int max_sub_layers_minus1)
 {
+    HEVCSPSInfo dummy, *info = hvcc->sps_info ? hvcc->sps_info : &dummy;
     unsigned int min_spatial_segmentation_idc;
 
-    if (get_bits1(gb))              // aspect_ratio_info_present_flag
-        if (get_bits(gb, 8) == 255) // aspect_ratio_idc
-            skip_bits_long(gb, 32); // sar_width u(16), sar_height u(16)
+    if (get_bits1(gb)) {            // aspect_ratio_info_present_flag
+        unsigned aspect_ratio_idc = get_bits(gb, 8);
+        if (aspect_ratio_idc == 255) {
+            info->sar.num = get_bits(gb, 16);
+            info->sar.den = get_bits(gb, 16);
+        } else if (aspect_ratio_idc < FF_ARRAY_ELEMS(ff_avc_sample_aspect_ratio))
+            info->sar = ff_avc_sample_aspect_ratio[aspect_ratio_idc];
+    }
 
     if (get_bits1(gb))  // overscan_info_present_flag
         skip_bits1(gb); // overscan_appropriate_flag
 
-    if (get_bits1(gb)) {  // video_signal_type_present_flag
-        skip_bits(gb, 4); // video_format u(3), video_full_range_flag u(1)
+    info->video_signal_type_present_flag = get_bits1(gb);
+    if (info->video_signal_type_present_flag) {
+        skip_bits(gb, 3); // video_format
+        info->full_range = get_bits1(gb);
 
-        if (get_bits1(gb)) // colour_description_present_flag
-            /*
-             * colour_primaries         u(8)
-             * transfer_characteristics u(8)
-             * matrix_coeffs            u(8)
-             */
-            skip_bits(gb, 24);
+        info->colour_description_present_flag = get_bits1(gb);
+        if (info->colour_description_present_flag) {
+            info->colour_primaries         = get_bits(gb, 8);
+            info->transfer_characteristics = get_bits(gb, 8);
+            info->matrix_coefficients      = get_bits(gb, 8);
+        }
     }
 
     if (get_bits1(gb)) {        // chroma_loc_info_present_flag
@@ -486,6 +494,7 @@ static int hvcc_parse_sps(GetBitContext *gb,
 {
     unsigned int i, sps_max_sub_layers_minus1, log2_max_pic_order_cnt_lsb_minus4;
     unsigned int num_short_term_ref_pic_sets, num_delta_pocs[MAX_SHORT_TERM_RPS_COUNT];
+    unsigned int width, height, conf_win[4] = { 0 };
 
     skip_bits(gb, 4); // sps_video_parameter_set_id
 
@@ -513,14 +522,26 @@ static int hvcc_parse_sps(GetBitContext *gb,
     if (hvcc->chromaFormat == 3)
         skip_bits1(gb); // separate_colour_plane_flag
 
-    get_ue_golomb_long(gb); // pic_width_in_luma_samples
-    get_ue_golomb_long(gb); // pic_height_in_luma_samples
+    width  = get_ue_golomb_long(gb); // pic_width_in_luma_samples
+    height = get_ue_golomb_long(gb); // pic_height_in_luma_samples
 
-    if (get_bits1(gb)) {        // conformance_window_flag
-        get_ue_golomb_long(gb); // conf_win_left_offset
-        get_ue_golomb_long(gb); // conf_win_right_offset
-        get_ue_golomb_long(gb); // conf_win_top_offset
-        get_ue_golomb_long(gb); // conf_win_bottom_offset
+    if (get_bits1(gb)) {                      // conformance_window_flag
+        conf_win[0] = get_ue_golomb_long(gb); // conf_win_left_offset
+        conf_win[1] = get_ue_golomb_long(gb); // conf_win_right_offset
+        conf_win[2] = get_ue_golomb_long(gb); // conf_win_top_offset
+        conf_win[3] = get_ue_golomb_long(gb); // conf_win_bottom_offset
+    }
+
+    if (hvcc->sps_info) {
+        unsigned int unit_x = hvcc->chromaFormat == 1 || hvcc->chromaFormat == 2 ? 2 : 1;
+        unsigned int unit_y = hvcc->chromaFormat == 1 ? 2 : 1;
+
+        if (!width || !height ||
+            (conf_win[0] + conf_win[1]) * (uint64_t)unit_x >= width ||
+            (conf_win[2] + conf_win[3]) * (uint64_t)unit_y >= height)
+            return AVERROR_INVALIDDATA;
+        hvcc->sps_info->width  = width  - unit_x * (conf_win[0] + conf_win[1]);
+        hvcc->sps_info->height = height - unit_y * (conf_win[2] + conf_win[3]);
     }
 
     hvcc->bitDepthLumaMinus8          = get_ue_golomb_long(gb);
@@ -1150,3 +1171,88 @@ end:
     av_free(start);
     return ret;
 }
+
+static int hevc_decode_sps(HEVCSPSInfo *info, const uint8_t *nal, int size)
+{
+    HEVCDecoderConfigurationRecord hvcc;
+    GetBitContext gbc;
+    uint8_t nal_type;
+    uint8_t *rbsp;
+    uint32_t rbsp_size;
+    int ret;
+
+    rbsp = nal_unit_extract_rbsp(nal, size, &rbsp_size);
+    if (!rbsp)
+        return AVERROR(ENOMEM);
+
+    ret = init_get_bits8(&gbc, rbsp, rbsp_size);
+    if (ret < 0)
+        goto end;
+
+    hvcc_init(&hvcc);
+    memset(info, 0, sizeof(*info));
+    info->sar = (AVRational){ 0, 1 };
+    hvcc.sps_info = info;
+
+    nal_unit_parse_header(&gbc, &nal_type);
+    ret = hvcc_parse_sps(&gbc, &hvcc);
+    if (ret >= 0 && get_bits_left(&gbc) < 0)
+        ret = AVERROR_INVALIDDATA;
+
+    info->profile_idc       = hvcc.general_profile_idc;
+    info->level_idc         = hvcc.general_level_idc;
+    info->chroma_format_idc = hvcc.chromaFormat;
+    info->bit_depth         = hvcc.bitDepthLumaMinus8 + 8;
+
+end:
+    av_free(rbsp);
+    return ret;
+}
+
+int ff_hevc_decode_extradata_sps(HEVCSPSInfo *info, const uint8_t *extradata,
+                                 int size)
+{
+    const uint8_t *p = extradata, *end = extradata + size, *nal_end;
+
+    if (size >= 23 && extradata[0] == 1) {
+        int i, j, nb_arrays = extradata[22];
+
+        p += 23;
+        for (i = 0; i < nb_arrays; i++) {
+            int type, nb_nalus;
+
+            if (end - p < 3)
+                return AVERROR_INVALIDDATA;
+            type     = p[0] & 0x3f;
+            nb_nalus = AV_RB16(p + 1);
+            p       += 3;
+            for (j = 0; j < nb_nalus; j++) {
+                int nal_size;
+
+                if (end - p < 2)
+                    return AVERROR_INVALIDDATA;
+                nal_size = AV_RB16(p);
+                p       += 2;
+                if (nal_size > end - p)
+                    return AVERROR_INVALIDDATA;
+                if (type == NAL_SPS)
+                    return hevc_decode_sps(info, p, nal_size);
+                p += nal_size;
+            }
+        }
+        return AVERROR_INVALIDDATA;
+    }
+
+    p = ff_avc_find_startcode(p, end);
+    while (p < end) {
+        while (p < end && !*p)
+            p++;
+        if (++p >= end)
+            break;
+        nal_end = ff_avc_find_startcode(p, end);
+        if (((*p >> 1) & 0x3f) == NAL_SPS)
+            return hevc_decode_sps(info, p, nal_end - p);
+        p = nal_end;
+    }
+    return AVERROR_INVALIDDATA;
+}
@@ -27,8 +27,25 @@
 #define AVFORMAT_HEVC_H
 
 #include <stdint.h>
+#include "libavutil/rational.h"
 #include "avio.h"
 
+typedef struct HEVCSPSInfo {
+    uint8_t profile_idc;
+    uint8_t level_idc;
+    uint8_t chroma_format_idc;
+    uint8_t bit_depth;
+    int width;                  ///< frame width after the conformance window
+    int height;                 ///< frame height after the conformance window
+    AVRational sar;
+    uint8_t video_signal_type_present_flag;
+    uint8_t full_range;
+    uint8_t colour_description_present_flag;
+    uint8_t colour_primaries;
+    uint8_t transfer_characteristics;
+    uint8_t matrix_coefficients;
+} HEVCSPSInfo;
+
 /**
  * Writes Annex B formatted HEVC NAL units to the provided AVIOContext.
  *
@@ -95,4 +112,14 @@ int ff_hevc_annexb2mp4_buf(const uint8_t *buf_in, uint8_t **buf_out,
 int ff_isom_write_hvcc(AVIOContext *pb, const uint8_t *data,
                        int size, int ps_array_completeness);
 
+/**
+ * Parse the first SPS of HEVC extradata, up to the video signal type of
+ * its VUI.
+ *
+ * @param extradata extradata in hvcC or Annex B format
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_hevc_decode_extradata_sps(HEVCSPSInfo *info, const uint8_t *extradata,
+                                 int size);
+
 #endif /* AVFORMAT_HEVC_H */
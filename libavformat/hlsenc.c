@@ -35,8 +35,10 @@
 #include "libavutil/time_internal.h"
 
 #include "avformat.h"
+#include "avio_internal.h"
 #include "internal.h"
 #include "os_support.h"
+#include "segwriter.h"
 
 #define KEYSIZE 16
 #define LINE_BUFFER_SIZE 1024
@@ -115,6 +117,8 @@ typedef struct HLSContext {
 
     char *method;
 
+    int async_queue_size;   ///< number of pending jobs of the background writer, 0 to disable it
+    SegmentWriter *writer;
 } HLSContext;
 
 static int hls_delete_old_segments(HLSContext *hls) {
@@ -379,7 +383,6 @@ static int hls_window(AVFormatContext *s, int last)
     int ret = 0;
     AVIOContext *out = NULL;
     AVIOContext *sub_out = NULL;
-    char temp_filename[1024];
     int64_t sequence = FFMAX(hls->start_sequence, hls->sequence - hls->nb_entries);
     int version = hls->flags & HLS_SINGLE_FILE ? 4 : 3;
     const char *proto = avio_find_protocol_name(s->filename);
@@ -393,9 +396,7 @@ static int hls_window(AVFormatContext *s, int last)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporarly partial files\n");
 
     set_http_options(&options, hls);
-    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
-    if ((ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE,
-                          &s->interrupt_callback, &options)) < 0)
+    if ((ret = avio_open_dyn_buf(&out)) < 0)
         goto fail;
 
     for (en = hls->segments; en; en = en->next) {
@@ -445,8 +446,7 @@ static int hls_window(AVFormatContext *s, int last)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
     if( hls->vtt_m3u8_name ) {
-        if ((ret = avio_open2(&sub_out, hls->vtt_m3u8_name, AVIO_FLAG_WRITE,
-                          &s->interrupt_callback, &options)) < 0)
+        if ((ret = avio_open_dyn_buf(&sub_out)) < 0)
             goto fail;
         avio_printf(sub_out, "#EXTM3U\n");
         avio_printf(sub_out, "#EXT-X-VERSION:%d\n", version);
@@ -474,12 +474,18 @@ static int hls_window(AVFormatContext *s, int last)
 
     }
 
+    /* the playlists are published by the writer once the segments they
+     * reference have been closed */
+    ret = ff_segwriter_publish(hls->writer, s, s->filename, &out, use_rename,
+                               &s->interrupt_callback, options);
+    if (ret >= 0 && sub_out)
+        ret = ff_segwriter_publish(hls->writer, s, hls->vtt_m3u8_name, &sub_out,
+                                   use_rename, &s->interrupt_callback, options);
+
 fail:
     av_dict_free(&options);
-    avio_closep(&out);
-    avio_closep(&sub_out);
-    if (ret >= 0 && use_rename)
-        ff_rename(temp_filename, s->filename, s);
+    ffio_free_dyn_buf(&out);
+    ffio_free_dyn_buf(&sub_out);
     return ret;
 }
 
@@ -689,6 +695,15 @@ static int hls_write_header(AVFormatContext *s)
     if ((ret = hls_mux_init(s)) < 0)
         goto fail;
 
+    if (hls->async_queue_size) {
+        ret = ff_segwriter_open(&hls->writer, s, hls->async_queue_size);
+        if (ret == AVERROR(ENOSYS))
+            av_log(s, AV_LOG_WARNING,
+                   "Asynchronous writing requires thread support, writing synchronously\n");
+        else if (ret < 0)
+            goto fail;
+    }
+
     if ((ret = hls_start(s)) < 0)
         goto fail;
 
@@ -718,6 +733,7 @@ fail:
 
     av_dict_free(&options);
     if (ret < 0) {
+        ff_segwriter_close(&hls->writer);
         av_freep(&hls->basename);
         av_freep(&hls->vtt_basename);
         if (hls->avf)
@@ -783,11 +799,12 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 av_opt_set(hls->avf->priv_data, "mpegts_flags", "resend_headers", 0);
             hls->number++;
         } else {
-            avio_closep(&oc->pb);
-            if (hls->vtt_avf)
-                avio_close(hls->vtt_avf->pb);
+            ret = ff_segwriter_close_io(hls->writer, s, &hls->avf->pb);
+            if (ret >= 0 && hls->vtt_avf)
+                ret = ff_segwriter_close_io(hls->writer, s, &hls->vtt_avf->pb);
 
-            ret = hls_start(s);
+            if (ret >= 0)
+                ret = hls_start(s);
         }
 
         if (ret < 0)
@@ -812,6 +829,12 @@ static int hls_write_trailer(struct AVFormatContext *s)
     HLSContext *hls = s->priv_data;
     AVFormatContext *oc = hls->avf;
     AVFormatContext *vtt_oc = hls->vtt_avf;
+    int ret;
+
+    /* wait for the pending segments and playlists before writing the last ones */
+    ret = ff_segwriter_close(&hls->writer);
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Failure occurred in the background writer\n");
 
     av_write_trailer(oc);
     if (oc->pb) {
@@ -840,7 +863,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
 
     hls_free_segments(hls->segments);
     hls_free_segments(hls->old_segments);
-    return 0;
+    return ret;
 }
 
 #define OFFSET(x) offsetof(HLSContext, x)
@@ -865,6 +888,7 @@ static const AVOption options[] = {
     {"omit_endlist", "Do not append an endlist when ending stream", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_OMIT_ENDLIST }, 0, UINT_MAX,   E, "flags"},
     { "use_localtime",          "set filename expansion with strftime at segment creation", OFFSET(use_localtime), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 1, E },
     {"method", "set the HTTP method", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
+    {"hls_async_queue_size", "close segments and write playlists in a background thread with the given number of pending jobs, 0 to disable", OFFSET(async_queue_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E},
 
     { NULL },
 };
@@ -60,6 +60,8 @@ typedef struct VideoDemuxData {
     int start_number_range;
     int frame_size;
     int ts_from_file;
+    int readahead;          /**< number of files read ahead in the background */
+    struct ImageReadahead *ra;
 } VideoDemuxData;
 
 typedef struct IdStrMap {
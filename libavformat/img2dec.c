@@ -29,6 +29,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
@@ -361,6 +362,336 @@ int ff_img_read_header(AVFormatContext *s1)
     return 0;
 }
 
+/**
+ * Get the name of the file of an image of the sequence.
+ * @param buf  buffer of size 1024 that may be used to build the name
+ */
+static int get_image_filename(VideoDemuxData *s, int number, char *buf,
+                              char **filename)
+{
+    *filename = buf;
+    if (s->pattern_type == PT_NONE) {
+        av_strlcpy(buf, s->path, 1024);
+    } else if (s->use_glob) {
+#if HAVE_GLOB
+        *filename = s->globstate.gl_pathv[number];
+#endif
+    } else {
+        if (av_get_frame_filename(buf, 1024, s->path, number) < 0 && number > 1)
+            return AVERROR(EIO);
+    }
+    return 0;
+}
+
+static void probe_image_codec(AVCodecContext *codec, const uint8_t *buf,
+                              int size, const char *filename)
+{
+    AVProbeData pd = { 0 };
+    AVInputFormat *ifmt;
+    int score = 0;
+
+    pd.buf = (uint8_t *)buf;
+    pd.buf_size = size;
+    pd.filename = filename;
+
+    ifmt = av_probe_input_format3(&pd, 1, &score);
+    if (ifmt && ifmt->read_packet == ff_img_read_packet && ifmt->raw_codec_id)
+        codec->codec_id = ifmt->raw_codec_id;
+}
+
+#if HAVE_THREADS
+enum ReadaheadSlotState {
+    SLOT_QUEUED,
+    SLOT_BUSY,
+    SLOT_DONE,
+};
+
+typedef struct ReadaheadSlot {
+    int number;                 ///< image number
+    unsigned generation;        ///< bumped when the slot is reassigned
+    enum ReadaheadSlotState state;
+    char filename_bytes[1024];
+    char *filename;
+    AVPacket pkt;
+    int size;                   ///< size of the first plane file
+    int64_t mtime;              ///< file timestamp for ts_from_file
+    int ret;
+} ReadaheadSlot;
+
+typedef struct ImageReadahead {
+    AVFormatContext *s1;
+    ReadaheadSlot *slots;
+    int nb_slots;
+    int head;                   ///< slot of the next image to return
+    int nb_queued;              ///< slots in use from head
+    int next_number;            ///< next image number to queue, -1 at the end
+    pthread_t *threads;
+    int nb_threads;
+    int quit;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} ImageReadahead;
+
+/**
+ * Read all the planes of an image into a packet.
+ * This only touches its arguments so it can run on the readahead threads.
+ */
+static int read_image_files(AVFormatContext *s1, VideoDemuxData *s,
+                            char *filename, AVPacket *pkt, int *psize,
+                            int64_t *mtime)
+{
+    AVIOContext *f[3] = { NULL };
+    int size[3] = { 0 };
+    int i, ret = 0;
+
+    for (i = 0; i < 3; i++) {
+        if (avio_open2(&f[i], filename, AVIO_FLAG_READ,
+                       &s1->interrupt_callback, NULL) < 0) {
+            if (i >= 1)
+                break;
+            av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n",
+                   filename);
+            return AVERROR(EIO);
+        }
+        size[i] = avio_size(f[i]);
+
+        if (!s->split_planes)
+            break;
+        filename[strlen(filename) - 1] = 'U' + i;
+    }
+    *psize = size[0];
+
+    if (s->ts_from_file) {
+        struct stat img_stat;
+        if (stat(filename, &img_stat)) {
+            ret = AVERROR(EIO);
+            goto fail;
+        }
+        *mtime = (int64_t)img_stat.st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+        if (s->ts_from_file == 2)
+            *mtime = 1000000000 * *mtime + img_stat.st_mtim.tv_nsec;
+#endif
+    }
+
+    if ((ret = av_new_packet(pkt, size[0] + size[1] + size[2])) < 0)
+        goto fail;
+    pkt->size = 0;
+    for (i = 0; i < 3 && f[i]; i++) {
+        int len = avio_read(f[i], pkt->data + pkt->size, size[i]);
+        if (len < 0 || (!i && !len)) {
+            ret = len ? len : AVERROR_EOF;
+            av_packet_unref(pkt);
+            goto fail;
+        }
+        pkt->size += len;
+    }
+
+fail:
+    for (i = 0; i < 3; i++)
+        avio_closep(&f[i]);
+    return ret;
+}
+
+static void *readahead_thread(void *arg)
+{
+    ImageReadahead *ra = arg;
+    VideoDemuxData *s = ra->s1->priv_data;
+    AVPacket pkt;
+    char filename[1024];
+    int64_t mtime = 0;
+    int i, size = 0, ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->quit) {
+        ReadaheadSlot *slot = NULL;
+        unsigned generation;
+
+        /* take the oldest queued image to keep them coming in order */
+        for (i = 0; i < ra->nb_queued; i++) {
+            ReadaheadSlot *sl = &ra->slots[(ra->head + i) % ra->nb_slots];
+            if (sl->state == SLOT_QUEUED) {
+                slot = sl;
+                break;
+            }
+        }
+        if (!slot) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        slot->state = SLOT_BUSY;
+        generation  = slot->generation;
+        av_strlcpy(filename, slot->filename, sizeof(filename));
+        pthread_mutex_unlock(&ra->mutex);
+
+        av_init_packet(&pkt);
+        ret = read_image_files(ra->s1, s, filename, &pkt, &size, &mtime);
+
+        pthread_mutex_lock(&ra->mutex);
+        if (slot->generation == generation) {
+            slot->pkt   = pkt;
+            slot->size  = size;
+            slot->mtime = mtime;
+            slot->ret   = ret;
+            slot->state = SLOT_DONE;
+            pthread_cond_broadcast(&ra->cond);
+        } else {
+            /* the slot was reassigned by a seek in the meantime */
+            av_packet_unref(&pkt);
+        }
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+static void readahead_free(VideoDemuxData *s)
+{
+    ImageReadahead *ra = s->ra;
+    int i;
+
+    if (!ra)
+        return;
+
+    pthread_mutex_lock(&ra->mutex);
+    ra->quit = 1;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+    for (i = 0; i < ra->nb_threads; i++)
+        pthread_join(ra->threads[i], NULL);
+
+    for (i = 0; i < ra->nb_slots; i++)
+        av_packet_unref(&ra->slots[i].pkt);
+    pthread_mutex_destroy(&ra->mutex);
+    pthread_cond_destroy(&ra->cond);
+    av_freep(&ra->threads);
+    av_freep(&ra->slots);
+    av_freep(&s->ra);
+}
+
+static int readahead_init(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImageReadahead *ra;
+    int i, ret;
+
+    ra = s->ra = av_mallocz(sizeof(*ra));
+    if (!ra)
+        return AVERROR(ENOMEM);
+    ra->s1       = s1;
+    ra->nb_slots = s->readahead;
+    ra->slots    = av_mallocz_array(ra->nb_slots, sizeof(*ra->slots));
+    ra->threads  = av_mallocz_array(ra->nb_slots, sizeof(*ra->threads));
+    if (!ra->slots || !ra->threads) {
+        av_freep(&ra->slots);
+        av_freep(&ra->threads);
+        av_freep(&s->ra);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < ra->nb_slots; i++)
+        av_init_packet(&ra->slots[i].pkt);
+    pthread_mutex_init(&ra->mutex, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+
+    for (i = 0; i < ra->nb_slots; i++) {
+        ret = pthread_create(&ra->threads[i], NULL, readahead_thread, ra);
+        if (ret) {
+            av_log(s1, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+            readahead_free(s);
+            return AVERROR(ret);
+        }
+        ra->nb_threads++;
+    }
+    return 0;
+}
+
+/**
+ * Queue images until all the slots are used.
+ * Must be called with the mutex locked.
+ */
+static void readahead_fill(VideoDemuxData *s)
+{
+    ImageReadahead *ra = s->ra;
+
+    while (ra->nb_queued < ra->nb_slots && ra->next_number >= 0) {
+        ReadaheadSlot *slot = &ra->slots[(ra->head + ra->nb_queued) % ra->nb_slots];
+
+        av_packet_unref(&slot->pkt);
+        slot->generation++;
+        slot->number = ra->next_number;
+        slot->ret    = get_image_filename(s, slot->number, slot->filename_bytes,
+                                          &slot->filename);
+        slot->state  = slot->ret < 0 ? SLOT_DONE : SLOT_QUEUED;
+        ra->nb_queued++;
+
+        if (++ra->next_number > s->img_last)
+            ra->next_number = s->loop ? s->img_first : -1;
+    }
+    pthread_cond_broadcast(&ra->cond);
+}
+
+static int readahead_read_packet(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoDemuxData *s = s1->priv_data;
+    AVCodecContext *codec = s1->streams[0]->codec;
+    ImageReadahead *ra;
+    ReadaheadSlot *slot;
+    char filename[1024];
+    int64_t mtime;
+    int size, ret;
+
+    if (!s->ra && (ret = readahead_init(s1)) < 0)
+        return ret;
+    ra = s->ra;
+
+    pthread_mutex_lock(&ra->mutex);
+    if (!ra->nb_queued || ra->slots[ra->head].number != s->img_number) {
+        /* first read or seek, restart from the requested image */
+        ra->nb_queued   = 0;
+        ra->next_number = s->img_number;
+    }
+    readahead_fill(s);
+
+    slot = &ra->slots[ra->head];
+    while (slot->state != SLOT_DONE)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+    *pkt  = slot->pkt;
+    av_init_packet(&slot->pkt);
+    ret   = slot->ret;
+    size  = slot->size;
+    mtime = slot->mtime;
+    av_strlcpy(filename, slot->filename, sizeof(filename));
+
+    ra->head = (ra->head + 1) % ra->nb_slots;
+    ra->nb_queued--;
+    readahead_fill(s);
+    pthread_mutex_unlock(&ra->mutex);
+
+    if (ret < 0)
+        return ret;
+
+    if (codec->codec_id == AV_CODEC_ID_NONE)
+        probe_image_codec(codec, pkt->data, FFMIN(pkt->size, PROBE_BUF_MIN),
+                          filename);
+    if (codec->codec_id == AV_CODEC_ID_RAWVIDEO && !codec->width)
+        infer_size(&codec->width, &codec->height, size);
+
+    pkt->stream_index = 0;
+    pkt->flags       |= AV_PKT_FLAG_KEY;
+    if (s->ts_from_file) {
+        pkt->pts = mtime;
+        av_add_index_entry(s1->streams[0], s->img_number, pkt->pts, 0, 0, AVINDEX_KEYFRAME);
+    } else {
+        pkt->pts = s->pts;
+    }
+
+    s->img_count++;
+    s->img_number++;
+    s->pts++;
+    return 0;
+}
+#endif
+
 int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -378,18 +709,12 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
-        if (s->pattern_type == PT_NONE) {
-            av_strlcpy(filename_bytes, s->path, sizeof(filename_bytes));
-        } else if (s->use_glob) {
-#if HAVE_GLOB
-            filename = s->globstate.gl_pathv[s->img_number];
+#if HAVE_THREADS
+        if (s->readahead > 0)
+            return readahead_read_packet(s1, pkt);
 #endif
-        } else {
-        if (av_get_frame_filename(filename_bytes, sizeof(filename_bytes),
-                                  s->path,
-                                  s->img_number) < 0 && s->img_number > 1)
-            return AVERROR(EIO);
-        }
+        if ((res = get_image_filename(s, s->img_number, filename_bytes, &filename)) < 0)
+            return res;
         for (i = 0; i < 3; i++) {
             if (avio_open2(&f[i], filename, AVIO_FLAG_READ,
                            &s1->interrupt_callback, NULL) < 0) {
@@ -407,24 +732,15 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
 
         if (codec->codec_id == AV_CODEC_ID_NONE) {
-            AVProbeData pd = { 0 };
-            AVInputFormat *ifmt;
             uint8_t header[PROBE_BUF_MIN + AVPROBE_PADDING_SIZE];
             int ret;
-            int score = 0;
 
             ret = avio_read(f[0], header, PROBE_BUF_MIN);
             if (ret < 0)
                 return ret;
             memset(header + ret, 0, sizeof(header) - ret);
             avio_skip(f[0], -ret);
-            pd.buf = header;
-            pd.buf_size = ret;
-            pd.filename = filename;
-
-            ifmt = av_probe_input_format3(&pd, 1, &score);
-            if (ifmt && ifmt->read_packet == ff_img_read_packet && ifmt->raw_codec_id)
-                codec->codec_id = ifmt->raw_codec_id;
+            probe_image_codec(codec, header, ret, filename);
         }
 
         if (codec->codec_id == AV_CODEC_ID_RAWVIDEO && !codec->width)
@@ -516,8 +832,11 @@ fail:
 
 static int img_read_close(struct AVFormatContext* s1)
 {
-#if HAVE_GLOB
     VideoDemuxData *s = s1->priv_data;
+#if HAVE_THREADS
+    readahead_free(s);
+#endif
+#if HAVE_GLOB
     if (s->use_glob) {
         globfree(&s->globstate);
     }
@@ -566,6 +885,7 @@ const AVOption ff_img_options[] = {
     { "none", "none",                   0, AV_OPT_TYPE_CONST,    {.i64 = 0   }, 0, 2,       DEC, "ts_type" },
     { "sec",  "second precision",       0, AV_OPT_TYPE_CONST,    {.i64 = 1   }, 0, 2,       DEC, "ts_type" },
     { "ns",   "nano second precision",  0, AV_OPT_TYPE_CONST,    {.i64 = 2   }, 0, 2,       DEC, "ts_type" },
+    { "readahead",    "set number of files read in the background", OFFSET(readahead), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 256, DEC },
     { NULL },
 };
 
@@ -20,12 +20,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/time_internal.h"
 #include "avformat.h"
 #include "avio_internal.h"
@@ -41,8 +44,158 @@ typedef struct VideoMuxData {
     int update;
     int use_strftime;
     const char *muxer;
+    int writers;            /**< number of background writer threads */
+    int writer_queue_size;
+    struct ImageWriterPool *pool;
 } VideoMuxData;
 
+static int write_image(AVFormatContext *s, AVIOContext **pb, AVPacket *pkt);
+static int write_image_file(AVFormatContext *s, char *filename, AVPacket *pkt);
+
+#if HAVE_THREADS
+typedef struct ImageWriteJob {
+    char filename[1024];
+    AVPacket pkt;
+} ImageWriteJob;
+
+typedef struct ImageWriterPool {
+    AVFormatContext *s;
+    ImageWriteJob *jobs;        ///< ring of queued images
+    int nb_jobs;
+    int head;
+    int count;
+    pthread_t *threads;
+    int nb_threads;
+    int quit;
+    int error;                  ///< first write error
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} ImageWriterPool;
+
+static void *writer_thread(void *arg)
+{
+    ImageWriterPool *pool = arg;
+    ImageWriteJob job;
+    int ret;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->count && !pool->quit)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        if (!pool->count)
+            break;
+        job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->nb_jobs;
+        pool->count--;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+
+        ret = write_image_file(pool->s, job.filename, &job.pkt);
+        av_packet_unref(&job.pkt);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (ret < 0 && !pool->error) {
+            pool->error = ret;
+            pthread_cond_broadcast(&pool->cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/**
+ * Wait for the queued images to be written and stop the writers.
+ * @return the first write error
+ */
+static int writer_pool_free(VideoMuxData *img)
+{
+    ImageWriterPool *pool = img->pool;
+    int i, ret;
+
+    if (!pool)
+        return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+    ret = pool->error;
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond);
+    av_freep(&pool->threads);
+    av_freep(&pool->jobs);
+    av_freep(&img->pool);
+    return ret;
+}
+
+static int writer_pool_init(AVFormatContext *s)
+{
+    VideoMuxData *img = s->priv_data;
+    ImageWriterPool *pool;
+    int i, ret, nb_threads = img->writers;
+
+    /* the same file may be written twice, keep the writes in order */
+    if (img->update || img->use_strftime)
+        nb_threads = 1;
+
+    pool = img->pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return AVERROR(ENOMEM);
+    pool->s       = s;
+    pool->nb_jobs = FFMAX(img->writer_queue_size, 1);
+    pool->jobs    = av_mallocz_array(pool->nb_jobs, sizeof(*pool->jobs));
+    pool->threads = av_mallocz_array(nb_threads, sizeof(*pool->threads));
+    if (!pool->jobs || !pool->threads) {
+        av_freep(&pool->jobs);
+        av_freep(&pool->threads);
+        av_freep(&img->pool);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&pool->threads[i], NULL, writer_thread, pool);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+            writer_pool_free(img);
+            return AVERROR(ret);
+        }
+        pool->nb_threads++;
+    }
+    return 0;
+}
+
+static int writer_pool_submit(ImageWriterPool *pool, const char *filename,
+                              AVPacket *pkt)
+{
+    ImageWriteJob *job;
+    int ret;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->count == pool->nb_jobs && !pool->error)
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    if (pool->error) {
+        ret = pool->error;
+        goto end;
+    }
+    job = &pool->jobs[(pool->head + pool->count) % pool->nb_jobs];
+    av_init_packet(&job->pkt);
+    if ((ret = av_packet_ref(&job->pkt, pkt)) < 0)
+        goto end;
+    av_strlcpy(job->filename, filename, sizeof(job->filename));
+    pool->count++;
+    pthread_cond_broadcast(&pool->cond);
+end:
+    pthread_mutex_unlock(&pool->mutex);
+    return ret;
+}
+#endif
+
 static int write_header(AVFormatContext *s)
 {
     VideoMuxData *img = s->priv_data;
@@ -68,17 +221,53 @@ static int write_header(AVFormatContext *s)
                              &&(desc->flags & AV_PIX_FMT_FLAG_PLANAR)
                              && desc->nb_components >= 3;
     }
+#if HAVE_THREADS
+    if (!img->is_pipe && img->writers > 0)
+        return writer_pool_init(s);
+#endif
     return 0;
 }
 
+/**
+ * Open the files of an image and write it.
+ * This does not modify the muxer state so it can run on the writer threads.
+ */
+static int write_image_file(AVFormatContext *s, char *filename, AVPacket *pkt)
+{
+    VideoMuxData *img = s->priv_data;
+    AVIOContext *pb[4] = { NULL };
+    AVCodecContext *codec = s->streams[pkt->stream_index]->codec;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(codec->pix_fmt);
+    int i, ret;
+
+    for (i = 0; i < 4; i++) {
+        if (avio_open2(&pb[i], filename, AVIO_FLAG_WRITE,
+                       &s->interrupt_callback, NULL) < 0) {
+            av_log(s, AV_LOG_ERROR, "Could not open file : %s\n", filename);
+            ret = AVERROR(EIO);
+            goto fail;
+        }
+
+        if (!img->split_planes || i+1 >= desc->nb_components)
+            break;
+        filename[strlen(filename) - 1] = "UVAx"[i];
+    }
+
+    ret = write_image(s, pb, pkt);
+    if (ret >= 0)
+        return avio_closep(&pb[0]);
+fail:
+    for (i = 0; i < 4; i++)
+        avio_closep(&pb[i]);
+    return ret;
+}
+
 static int write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     VideoMuxData *img = s->priv_data;
     AVIOContext *pb[4];
     char filename[1024];
-    AVCodecContext *codec = s->streams[pkt->stream_index]->codec;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(codec->pix_fmt);
-    int i;
+    int ret;
 
     if (!img->is_pipe) {
         if (img->update) {
@@ -99,20 +288,28 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
                    img->img_number, img->path);
             return AVERROR(EINVAL);
         }
-        for (i = 0; i < 4; i++) {
-            if (avio_open2(&pb[i], filename, AVIO_FLAG_WRITE,
-                           &s->interrupt_callback, NULL) < 0) {
-                av_log(s, AV_LOG_ERROR, "Could not open file : %s\n", filename);
-                return AVERROR(EIO);
-            }
-
-            if (!img->split_planes || i+1 >= desc->nb_components)
-                break;
-            filename[strlen(filename) - 1] = "UVAx"[i];
-        }
+#if HAVE_THREADS
+        if (img->pool)
+            ret = writer_pool_submit(img->pool, filename, pkt);
+        else
+#endif
+        ret = write_image_file(s, filename, pkt);
     } else {
         pb[0] = s->pb;
+        ret = write_image(s, pb, pkt);
     }
+    if (ret < 0)
+        return ret;
+
+    img->img_number++;
+    return 0;
+}
+
+static int write_image(AVFormatContext *s, AVIOContext **pb, AVPacket *pkt)
+{
+    VideoMuxData *img = s->priv_data;
+    AVCodecContext *codec = s->streams[pkt->stream_index]->codec;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(codec->pix_fmt);
 
     if (img->split_planes) {
         int ysize = codec->width * codec->height;
@@ -165,12 +362,16 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_write(pb[0], pkt->data, pkt->size);
     }
     avio_flush(pb[0]);
-    if (!img->is_pipe) {
-        avio_closep(&pb[0]);
-    }
+    return 0;
+}
 
-    img->img_number++;
+static int write_trailer(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    return writer_pool_free(s->priv_data);
+#else
     return 0;
+#endif
 }
 
 static int query_codec(enum AVCodecID id, int std_compliance)
@@ -191,6 +392,8 @@ static const AVOption muxoptions[] = {
     { "update",       "continuously overwrite one file", OFFSET(update),  AV_OPT_TYPE_INT, { .i64 = 0 }, 0,       1, ENC },
     { "start_number", "set first number in the sequence", OFFSET(img_number), AV_OPT_TYPE_INT,  { .i64 = 1 }, 0, INT_MAX, ENC },
     { "strftime",     "use strftime for filename", OFFSET(use_strftime), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, ENC },
+    { "writers",      "set number of background writer threads", OFFSET(writers), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, ENC },
+    { "writer_queue_size", "set number of images queued for the writers", OFFSET(writer_queue_size), AV_OPT_TYPE_INT, { .i64 = 16 }, 1, INT_MAX, ENC },
     { NULL },
 };
 
@@ -212,6 +415,7 @@ AVOutputFormat ff_image2_muxer = {
     .video_codec    = AV_CODEC_ID_MJPEG,
     .write_header   = write_header,
     .write_packet   = write_packet,
+    .write_trailer  = write_trailer,
     .query_codec    = query_codec,
     .flags          = AVFMT_NOTIMESTAMPS | AVFMT_NODIMENSIONS | AVFMT_NOFILE,
     .priv_class     = &img2mux_class,
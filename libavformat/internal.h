@@ -44,6 +44,20 @@ typedef struct AVCodecTag {
     unsigned int tag;
 } AVCodecTag;
 
+/**
+ * Bytes found at a fixed offset at the start of a file of a given format,
+ * see AVInputFormat.signatures.
+ */
+typedef struct FFProbeSignature {
+    int offset;                 ///< offset of the signature, < PROBE_SIGNATURE_MAX_OFFSET
+    const char *magic;
+    int size;                   ///< size of magic in bytes, 0 terminates a list
+} FFProbeSignature;
+
+#define PROBE_SIGNATURE_MAX_OFFSET 8
+/** minimum score of a signature match for skipping the full probe */
+#define PROBE_SIGNATURE_SCORE (AVPROBE_SCORE_MAX - 1)
+
 typedef struct CodecMime{
     char str[32];
     enum AVCodecID id;
@@ -113,6 +127,26 @@ struct AVFormatInternal {
     int inject_global_side_data;
 
     int avoid_negative_ts_use_pts;
+
+    /**
+     * Unused packet list nodes, recycled by the packet buffers and the
+     * interleaving queue instead of being freed.
+     */
+    struct AVPacketList *packet_pool;
+    int nb_packet_pool;
+
+    /**
+     * Per-stream packet queues of ff_interleave_packet_per_dts(), the last
+     * packet of each queue being AVStream.last_in_packet_buffer.
+     * Muxing only.
+     */
+    struct AVPacketList **interleave_queue;
+    /**
+     * Min-heap of the indexes of the streams with a non-empty interleave_queue,
+     * ordered by the dts of the first packet of each queue.
+     */
+    int *interleave_heap;
+    int nb_interleave_heap;
 };
 
 #ifdef __GNUC__
@@ -146,6 +180,18 @@ int ff_hex_to_data(uint8_t *data, const char *p);
 
 void ff_program_add_stream_index(AVFormatContext *ac, int progid, unsigned int idx);
 
+/**
+ * Get a zeroed packet list node, from the pool of s if possible.
+ * @return the node, NULL on allocation failure
+ */
+AVPacketList *ff_packet_list_get_node(AVFormatContext *s);
+
+/**
+ * Return a packet list node to the pool of s. The packet it holds is not
+ * unreferenced.
+ */
+void ff_packet_list_put_node(AVFormatContext *s, AVPacketList *pktl);
+
 /**
  * Add packet to AVFormatContext->packet_buffer list, determining its
  * interleaved position using compare() function argument.
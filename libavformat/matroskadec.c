@@ -3500,6 +3500,10 @@ AVInputFormat ff_matroska_demuxer = {
     .extensions     = "mkv,mk3d,mka,mks",
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .read_probe     = matroska_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "\x1A\x45\xDF\xA3", 4 },
+        { 0 }
+    },
     .read_header    = matroska_read_header,
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
@@ -26,21 +26,28 @@
 #include "avformat.h"
 #include "internal.h"
 
+#define MAX_QUEUED_PACKETS 4
+
 struct MD5Context {
     const AVClass *avclass;
     struct AVHashContext *hash;
     char *hash_name;
     int format_version;
+
+    /* framemd5 hashes several packets at once */
+    struct AVHashContext *hashes[MAX_QUEUED_PACKETS];
+    AVPacket queue[MAX_QUEUED_PACKETS];
+    int nb_queued;
 };
 
-static void md5_finish(struct AVFormatContext *s, char *buf)
+static void md5_finish(struct AVFormatContext *s, struct AVHashContext *hash,
+                       char *buf)
 {
-    struct MD5Context *c = s->priv_data;
     uint8_t md5[AV_HASH_MAX_SIZE];
     int i, offset = strlen(buf);
-    int len = av_hash_get_size(c->hash);
+    int len = av_hash_get_size(hash);
     av_assert0(len > 0 && len <= sizeof(md5));
-    av_hash_final(c->hash, md5);
+    av_hash_final(hash, md5);
     for (i = 0; i < len; i++) {
         snprintf(buf + offset, 3, "%02"PRIx8, md5[i]);
         offset += 2;
@@ -92,7 +99,7 @@ static int write_trailer(struct AVFormatContext *s)
     av_strlcpy(buf, av_hash_get_name(c->hash), sizeof(buf) - 200);
     av_strlcat(buf, "=", sizeof(buf) - 200);
 
-    md5_finish(s, buf);
+    md5_finish(s, c->hash, buf);
 
     av_hash_freep(&c->hash);
     return 0;
@@ -117,9 +124,17 @@ AVOutputFormat ff_md5_muxer = {
 static int framemd5_write_header(struct AVFormatContext *s)
 {
     struct MD5Context *c = s->priv_data;
-    int res = av_hash_alloc(&c->hash, c->hash_name);
-    if (res < 0)
-        return res;
+    int i, res;
+
+    for (i = 0; i < MAX_QUEUED_PACKETS; i++) {
+        if ((res = av_hash_alloc(&c->hashes[i], c->hash_name)) < 0) {
+            /* write_trailer() is not called after a failed write_header() */
+            while (i--)
+                av_hash_freep(&c->hashes[i]);
+            return res;
+        }
+    }
+    c->hash = c->hashes[0];
     avio_printf(s->pb, "#format: frame checksums\n");
     avio_printf(s->pb, "#version: %d\n", c->format_version);
     avio_printf(s->pb, "#hash: %s\n", av_hash_get_name(c->hash));
@@ -128,23 +143,67 @@ static int framemd5_write_header(struct AVFormatContext *s)
     return 0;
 }
 
-static int framemd5_write_packet(struct AVFormatContext *s, AVPacket *pkt)
+static void framemd5_write_line(struct AVFormatContext *s,
+                                struct AVHashContext *hash, AVPacket *pkt)
 {
-    struct MD5Context *c = s->priv_data;
     char buf[256];
-    av_hash_init(c->hash);
-    av_hash_update(c->hash, pkt->data, pkt->size);
 
     snprintf(buf, sizeof(buf) - 64, "%d, %10"PRId64", %10"PRId64", %8"PRId64", %8d, ",
              pkt->stream_index, pkt->dts, pkt->pts, pkt->duration, pkt->size);
-    md5_finish(s, buf);
+    md5_finish(s, hash, buf);
+}
+
+static void framemd5_flush(struct AVFormatContext *s)
+{
+    struct MD5Context *c = s->priv_data;
+    const uint8_t *data[MAX_QUEUED_PACKETS];
+    int size[MAX_QUEUED_PACKETS];
+    int i;
+
+    for (i = 0; i < c->nb_queued; i++) {
+        av_hash_init(c->hashes[i]);
+        data[i] = c->queue[i].data;
+        size[i] = c->queue[i].size;
+    }
+    av_hash_update_multi(c->hashes, data, size, c->nb_queued);
+    for (i = 0; i < c->nb_queued; i++) {
+        framemd5_write_line(s, c->hashes[i], &c->queue[i]);
+        av_packet_unref(&c->queue[i]);
+    }
+    c->nb_queued = 0;
+}
+
+static int framemd5_write_packet(struct AVFormatContext *s, AVPacket *pkt)
+{
+    struct MD5Context *c = s->priv_data;
+    int ret;
+
+    /* Packets are queued, so that their hashes can be computed together,
+     * as long as this only takes a reference. */
+    if (!pkt->buf) {
+        framemd5_flush(s);
+        av_hash_init(c->hash);
+        av_hash_update(c->hash, pkt->data, pkt->size);
+        framemd5_write_line(s, c->hash, pkt);
+        return 0;
+    }
+
+    if ((ret = av_packet_ref(&c->queue[c->nb_queued], pkt)) < 0)
+        return ret;
+    if (++c->nb_queued == MAX_QUEUED_PACKETS)
+        framemd5_flush(s);
     return 0;
 }
 
 static int framemd5_write_trailer(struct AVFormatContext *s)
 {
     struct MD5Context *c = s->priv_data;
-    av_hash_freep(&c->hash);
+    int i;
+
+    framemd5_flush(s);
+    for (i = 0; i < MAX_QUEUED_PACKETS; i++)
+        av_hash_freep(&c->hashes[i]);
+    c->hash = NULL;
     return 0;
 }
 
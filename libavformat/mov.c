@@ -4996,6 +4996,14 @@ AVInputFormat ff_mov_demuxer = {
     .priv_data_size = sizeof(MOVContext),
     .extensions     = "mov,mp4,m4a,3gp,3g2,mj2",
     .read_probe     = mov_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 4, "ftyp", 4 },
+        { 4, "moov", 4 },
+        { 4, "mdat", 4 },
+        { 4, "free", 4 },
+        { 4, "wide", 4 },
+        { 0 }
+    },
     .read_header    = mov_read_header,
     .read_packet    = mov_read_packet,
     .read_close     = mov_read_close,
@@ -37,6 +37,7 @@
 #include "libavcodec/vc1_common.h"
 #include "libavcodec/raw.h"
 #include "internal.h"
+#include "os_support.h"
 #include "libavutil/avstring.h"
 #include "libavutil/intfloat.h"
 #include "libavutil/mathematics.h"
@@ -54,6 +55,7 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "moov_size_duration", "reserve space at the begin for the moov of a file of the given duration", offsetof(MOVMuxContext, reserved_moov_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -4944,6 +4946,37 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Estimate an upper bound of the moov size of a file of the expected
+ * duration: every sample gets its own stsz entry, chunk offset (co64) and
+ * for video ctts entry, the other tables are assumed to compress well.
+ */
+static int estimate_moov_size(AVFormatContext *s, int64_t duration)
+{
+    MOVMuxContext *mov = s->priv_data;
+    double seconds = duration / (double)AV_TIME_BASE;
+    double size = 4096;
+    int i;
+
+    for (i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVCodecContext *enc = track->enc;
+        double rate = 1, sample_size = 4 + 8;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            rate = track->st && track->st->avg_frame_rate.num ?
+                   av_q2d(track->st->avg_frame_rate) : 60;
+            sample_size += 8;
+        } else if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->sample_rate > 0) {
+            rate = enc->sample_rate / (double)(enc->frame_size > 0 ? enc->frame_size : 1024);
+        }
+        size += 1024 + enc->extradata_size + rate * seconds * sample_size;
+    }
+    size *= 1.1;
+
+    return size < INT_MAX ? (int)size : INT_MAX;
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -5231,6 +5264,13 @@ static int mov_write_header(AVFormatContext *s)
 
     enable_tracks(s);
 
+    if (!mov->reserved_moov_size && mov->reserved_moov_duration &&
+        !(mov->flags & FF_MOV_FLAG_FRAGMENT) && pb->seekable) {
+        mov->reserved_moov_size = estimate_moov_size(s, mov->reserved_moov_duration);
+        mov->reserved_moov_estimated = 1;
+        av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+               mov->reserved_moov_size);
+    }
 
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
@@ -5452,6 +5492,102 @@ end:
     return ret;
 }
 
+/*
+ * Move the moov atom to the beginning of the file by inserting a hole in
+ * front of the mdat atom at the filesystem level, which avoids rewriting the
+ * mdat data. The hole is a multiple of the filesystem block size, the space
+ * not used by the moov atom is covered by a free atom.
+ * Not used for bitexact output, as the size of the padding depends on the
+ * filesystem.
+ * Returns AVERROR(ENOSYS) without touching the file if this is not possible.
+ */
+static int insert_moov(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    const char *proto = avio_find_protocol_name(s->filename);
+    const char *path = s->filename;
+    int64_t offset, pos_end, shift, moov_size = 0, hole = 0;
+    int i, ret, block_size, head_size;
+    uint8_t *buf = NULL;
+    AVIOContext *read_pb;
+
+    if (s->flags & AVFMT_FLAG_BITEXACT || !proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    av_strstart(path, "file:", &path);
+
+    block_size = ff_file_block_size(path);
+    if (block_size <= 0)
+        return AVERROR(ENOSYS);
+
+    /* the size of the moov depends on the chunk offsets (stco or co64), so
+     * iterate until the hole fits it and leaves room for a free atom */
+    for (shift = 0; ; ) {
+        if (hole != shift) {
+            for (i = 0; i < mov->nb_streams; i++)
+                mov->tracks[i].data_offset += hole - shift;
+            shift = hole;
+        }
+        moov_size = get_moov_size(s);
+        if (moov_size < 0)
+            return moov_size;
+        if (hole >= moov_size && (hole == moov_size || hole - moov_size >= 8))
+            break;
+        hole = FFALIGN(moov_size, block_size);
+        if (hole != moov_size && hole - moov_size < 8)
+            hole += block_size;
+    }
+
+    avio_flush(s->pb);
+    pos_end = avio_tell(s->pb);
+    offset = mov->reserved_header_pos / block_size * block_size;
+    head_size = mov->reserved_header_pos - offset;
+    if (offset + block_size > pos_end ||
+        (ret = ff_file_insert_range(path, offset, hole)) < 0) {
+        av_log(s, AV_LOG_VERBOSE, "Cannot insert the moov atom in place\n");
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset -= hole;
+        return AVERROR(ENOSYS);
+    }
+
+    /* the head of the block holding the start of the mdat moved along with
+     * it, copy it back in front of the hole */
+    if (head_size) {
+        buf = av_malloc(head_size);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        ret = avio_open(&read_pb, s->filename, AVIO_FLAG_READ);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Unable to re-open %s output file for "
+                   "the second pass (faststart)\n", s->filename);
+            goto end;
+        }
+        avio_seek(read_pb, offset + hole, SEEK_SET);
+        ret = avio_read(read_pb, buf, head_size);
+        avio_close(read_pb);
+        if (ret != head_size) {
+            ret = ret < 0 ? ret : AVERROR(EIO);
+            goto end;
+        }
+        avio_seek(s->pb, offset, SEEK_SET);
+        avio_write(s->pb, buf, head_size);
+    }
+
+    avio_seek(s->pb, mov->reserved_header_pos, SEEK_SET);
+    if ((ret = mov_write_moov_tag(s->pb, mov, s)) < 0)
+        goto end;
+    if (hole > moov_size) {
+        avio_wb32(s->pb, hole - moov_size);
+        ffio_wfourcc(s->pb, "free");
+        ffio_fill(s->pb, 0, hole - moov_size - 8);
+    }
+    avio_seek(s->pb, pos_end + hole, SEEK_SET);
+    ret = 0;
+
+end:
+    av_free(buf);
+    return ret;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5503,27 +5639,45 @@ static int mov_write_trailer(AVFormatContext *s)
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
-            if (res == 0) {
-                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
-                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
-                    goto error;
+            res = insert_moov(s);
+            if (res == AVERROR(ENOSYS)) {
+                av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
+                res = shift_data(s);
+                if (res == 0) {
+                    avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                    if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                        goto error;
+                }
+            } else if (res < 0) {
+                goto error;
             }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
-            if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
-                goto error;
-            size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
-            if (size < 8){
-                av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
-                res = AVERROR(EINVAL);
+            if ((res = get_moov_size(s)) < 0)
                 goto error;
+            size = mov->reserved_moov_size - res;
+            if (size < 8 && mov->reserved_moov_estimated) {
+                /* keep the file valid, the moov just ends up at the end */
+                av_log(s, AV_LOG_WARNING, "Estimated moov size too small, "
+                       "needed %"PRId64" additional, writing it at the end\n", 8 - size);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                avio_seek(pb, moov_pos, SEEK_SET);
+                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                    goto error;
+            } else {
+                if (size < 8){
+                    av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
+                    res = AVERROR(EINVAL);
+                    goto error;
+                }
+                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                    goto error;
+                avio_wb32(pb, size);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, size - 8);
+                avio_seek(pb, moov_pos, SEEK_SET);
             }
-            avio_wb32(pb, size);
-            ffio_wfourcc(pb, "free");
-            ffio_fill(pb, 0, size - 8);
-            avio_seek(pb, moov_pos, SEEK_SET);
         } else {
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 goto error;
@@ -182,6 +182,8 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int64_t reserved_moov_duration; ///< expected duration used to estimate reserved_moov_size
+    int reserved_moov_estimated;
 
     char *major_brand;
 
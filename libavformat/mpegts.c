@@ -159,6 +159,16 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** packets of the pids set here are ignored, valid if skip_pids_valid */
+    uint8_t skip_pids[NB_PID_MAX];
+    int skip_pids_valid;
+    /** discard values of the programs and streams skip_pids was built for */
+    int8_t *discard_state;
+    int nb_discard_state;
+
+    /** PES payload buffers, pools[i] serves sizes up to 2 << i bytes */
+    AVBufferPool *pools[32];
 };
 
 #define MPEGTS_OPTIONS \
@@ -274,6 +284,7 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
 {
     int i;
 
+    ts->skip_pids_valid = 0;
     clear_avprogram(ts, programid);
     for (i = 0; i < ts->nb_prg; i++)
         if (ts->prg[i].id == programid) {
@@ -284,6 +295,7 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
 
 static void clear_programs(MpegTSContext *ts)
 {
+    ts->skip_pids_valid = 0;
     av_freep(&ts->prg);
     ts->nb_prg = 0;
 }
@@ -318,6 +330,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->skip_pids_valid = 0;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -453,6 +466,7 @@ static MpegTSFilter *mpegts_open_filter(MpegTSContext *ts, unsigned int pid,
     if (!filter)
         return NULL;
     ts->pids[pid] = filter;
+    ts->skip_pids_valid = 0;
 
     filter->type    = type;
     filter->pid     = pid;
@@ -528,6 +542,7 @@ static void mpegts_close_filter(MpegTSContext *ts, MpegTSFilter *filter)
 
     av_free(filter);
     ts->pids[pid] = NULL;
+    ts->skip_pids_valid = 0;
 }
 
 static int analyze(const uint8_t *buf, int size, int packet_size, int *index,
@@ -859,6 +874,24 @@ static void reset_pes_packet_state(PESContext *pes)
     av_buffer_unref(&pes->buffer);
 }
 
+/**
+ * Get a PES payload buffer of at least size bytes plus padding.
+ * The buffers are recycled, which avoids allocating and faulting in
+ * fresh memory for every PES packet of high bitrate streams.
+ */
+static AVBufferRef *get_pes_buffer(MpegTSContext *ts, int size)
+{
+    int index = av_log2(size + AV_INPUT_BUFFER_PADDING_SIZE);
+
+    if (!ts->pools[index]) {
+        int pool_size = FFMIN(MAX_PES_PAYLOAD + AV_INPUT_BUFFER_PADDING_SIZE, 2 << index);
+        ts->pools[index] = av_buffer_pool_init(pool_size, NULL);
+        if (!ts->pools[index])
+            return NULL;
+    }
+    return av_buffer_pool_get(ts->pools[index]);
+}
+
 static void new_pes_packet(PESContext *pes, AVPacket *pkt)
 {
     av_init_packet(pkt);
@@ -1037,8 +1070,7 @@ static int mpegts_push_data(MpegTSFilter *filter,
                         pes->total_size = MAX_PES_PAYLOAD;
 
                     /* allocate pes buffer */
-                    pes->buffer = av_buffer_alloc(pes->total_size +
-                                                  AV_INPUT_BUFFER_PADDING_SIZE);
+                    pes->buffer = get_pes_buffer(ts, pes->total_size);
                     if (!pes->buffer)
                         return AVERROR(ENOMEM);
 
@@ -1196,8 +1228,7 @@ skip:
                     pes->data_index + buf_size > pes->total_size) {
                     new_pes_packet(pes, ts->pkt);
                     pes->total_size = MAX_PES_PAYLOAD;
-                    pes->buffer = av_buffer_alloc(pes->total_size +
-                                                  AV_INPUT_BUFFER_PADDING_SIZE);
+                    pes->buffer = get_pes_buffer(ts, pes->total_size);
                     if (!pes->buffer)
                         return AVERROR(ENOMEM);
                     ts->stop_parse = 1;
@@ -2152,6 +2183,75 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 static int parse_pcr(int64_t *ppcr_high, int *ppcr_low,
                      const uint8_t *packet);
 
+/**
+ * Invalidate the pid skip table if the discard value of a program or a
+ * stream changed since it was built.
+ */
+static void check_discard_state(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int i, n = s->nb_programs + s->nb_streams;
+
+    if (n != ts->nb_discard_state) {
+        if (av_reallocp_array(&ts->discard_state, n, sizeof(*ts->discard_state)) < 0) {
+            ts->nb_discard_state = 0;
+            ts->skip_pids_valid  = 0;
+            return;
+        }
+        ts->nb_discard_state = n;
+        ts->skip_pids_valid  = 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        int discard = i < s->nb_programs ? s->programs[i]->discard :
+                      s->streams[i - s->nb_programs]->discard;
+        if (ts->discard_state[i] != discard) {
+            ts->discard_state[i] = discard;
+            ts->skip_pids_valid  = 0;
+        }
+    }
+}
+
+/**
+ * Build the table of the pids whose packets can be ignored without
+ * looking further than the header: the pids without filter, the pids of
+ * discarded programs and the pids carrying only discarded streams.
+ */
+static void update_skip_pids(MpegTSContext *ts)
+{
+    int pid;
+
+    for (pid = 0; pid < NB_PID_MAX; pid++) {
+        MpegTSFilter *tss = ts->pids[pid];
+        int skip;
+
+        if (!tss) {
+            skip = !ts->auto_guess;
+        } else if (pid && discard_pid(ts, pid)) {
+            skip = 1;
+        } else if (tss->type == MPEGTS_PES) {
+            PESContext *pes = tss->u.pes_filter.opaque;
+            skip = pes->st && pes->st->discard == AVDISCARD_ALL &&
+                   (!pes->sub_st || pes->sub_st->discard == AVDISCARD_ALL);
+        } else {
+            skip = 0;
+        }
+
+        if (skip && !ts->skip_pids[pid] && tss) {
+            /* restart cleanly if the pid is used again */
+            if (tss->type == MPEGTS_PES) {
+                PESContext *pes = tss->u.pes_filter.opaque;
+                av_buffer_unref(&pes->buffer);
+                pes->data_index = 0;
+                pes->state = MPEGTS_SKIP;
+            }
+            tss->last_cc = -1;
+        }
+        ts->skip_pids[pid] = skip;
+    }
+    ts->skip_pids_valid = 1;
+}
+
 /* handle one TS packet */
 static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
 {
@@ -2162,7 +2262,9 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if (pid && discard_pid(ts, pid))
+    if (!ts->skip_pids_valid)
+        update_skip_pids(ts);
+    if (ts->skip_pids[pid])
         return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
@@ -2321,17 +2423,30 @@ static int mpegts_resync(AVFormatContext *s)
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
-
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            avio_seek(pb, -1, SEEK_CUR);
+    const uint8_t *sync;
+    int c, i, len;
+
+    for (i = 0; i < ts->resync_size; i += len) {
+        /* scan what is left in the I/O buffer, and refill it byte by byte */
+        len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        if (len <= 0) {
+            len = 1;
+            c = avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
+            if (c == 0x47) {
+                avio_seek(pb, -1, SEEK_CUR);
+                reanalyze(s->priv_data);
+                return 0;
+            }
+            continue;
+        }
+        if ((sync = memchr(pb->buf_ptr, 0x47, len))) {
+            avio_skip(pb, sync - pb->buf_ptr);
             reanalyze(s->priv_data);
             return 0;
         }
+        avio_skip(pb, len);
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -2375,6 +2490,26 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Skip the consecutive packets of ignored pids available in the I/O buffer.
+ * @return the number of skipped packets
+ */
+static int skip_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const uint8_t *p = pb->buf_ptr;
+    int n = 0;
+
+    while (n < max_packets && pb->buf_end - p >= ts->raw_packet_size &&
+           p[0] == 0x47 && ts->skip_pids[AV_RB16(p + 1) & 0x1fff]) {
+        p += ts->raw_packet_size;
+        n++;
+    }
+    if (n)
+        avio_skip(pb, p - pb->buf_ptr);
+    return n;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -2403,6 +2538,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    check_discard_state(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2416,6 +2553,14 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        if (ts->skip_pids_valid) {
+            int skipped = skip_packets(ts, nb_packets ? nb_packets - packet_num : INT_MAX);
+            if (skipped) {
+                packet_num += skipped - 1;
+                continue;
+            }
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -2682,6 +2827,10 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
+    av_freep(&ts->discard_state);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(ts->pools); i++)
+        av_buffer_pool_uninit(&ts->pools[i]);
 }
 
 static int mpegts_read_close(AVFormatContext *s)
@@ -2787,6 +2936,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    check_discard_state(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
@@ -36,6 +36,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/time.h"
+#include "libavutil/trace.h"
 #include "riff.h"
 #include "audiointerleave.h"
 #include "url.h"
@@ -729,18 +730,19 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt)
 
 #define CHUNK_START 0x1000
 
-int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+/**
+ * Move a packet to a new packet list node, taking a reference to its data.
+ */
+static int new_packet_node(AVFormatContext *s, AVPacket *pkt,
+                           AVPacketList **ppktl)
 {
+    AVPacketList *pktl;
     int ret;
-    AVPacketList **next_point, *this_pktl;
-    AVStream *st   = s->streams[pkt->stream_index];
-    int chunked    = s->max_chunk_size || s->max_chunk_duration;
 
-    this_pktl      = av_mallocz(sizeof(AVPacketList));
-    if (!this_pktl)
+    pktl = ff_packet_list_get_node(s);
+    if (!pktl)
         return AVERROR(ENOMEM);
-    this_pktl->pkt = *pkt;
+    pktl->pkt = *pkt;
     pkt->buf       = NULL;
     pkt->side_data = NULL;
     pkt->side_data_elems = 0;
@@ -749,12 +751,27 @@ int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
         av_assert0(((AVFrame *)pkt->data)->buf);
     } else {
         // Duplicate the packet if it uses non-allocated memory
-        if ((ret = av_dup_packet(&this_pktl->pkt)) < 0) {
-            av_free(this_pktl);
+        if ((ret = av_dup_packet(&pktl->pkt)) < 0) {
+            ff_packet_list_put_node(s, pktl);
             return ret;
         }
     }
 
+    *ppktl = pktl;
+    return 0;
+}
+
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+{
+    int ret;
+    AVPacketList **next_point, *this_pktl;
+    AVStream *st   = s->streams[pkt->stream_index];
+    int chunked    = s->max_chunk_size || s->max_chunk_duration;
+
+    if ((ret = new_packet_node(s, pkt, &this_pktl)) < 0)
+        return ret;
+
     if (s->streams[pkt->stream_index]->last_in_packet_buffer) {
         next_point = &(st->last_in_packet_buffer->next);
     } else {
@@ -829,6 +846,102 @@ static int interleave_compare_dts(AVFormatContext *s, AVPacket *next,
     return comp > 0;
 }
 
+/*
+ * Interleaving by dts without chunking keeps one queue per stream and a
+ * min-heap of the streams ordered by the first packet of their queue, so
+ * that queuing a packet does not need to scan the packets of the other
+ * streams. The output order is the same as with ff_interleave_add_packet().
+ */
+static int interleave_heap_less(AVFormatContext *s, int a, int b)
+{
+    AVPacketList **queue = s->internal->interleave_queue;
+
+    return interleave_compare_dts(s, &queue[b]->pkt, &queue[a]->pkt);
+}
+
+static void interleave_heap_up(AVFormatContext *s, int i)
+{
+    int *heap = s->internal->interleave_heap;
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!interleave_heap_less(s, heap[i], heap[parent]))
+            break;
+        FFSWAP(int, heap[i], heap[parent]);
+        i = parent;
+    }
+}
+
+static void interleave_heap_down(AVFormatContext *s, int i)
+{
+    int *heap = s->internal->interleave_heap;
+    int nb    = s->internal->nb_interleave_heap;
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= nb)
+            break;
+        if (child + 1 < nb && interleave_heap_less(s, heap[child + 1], heap[child]))
+            child++;
+        if (!interleave_heap_less(s, heap[child], heap[i]))
+            break;
+        FFSWAP(int, heap[i], heap[child]);
+        i = child;
+    }
+}
+
+static int interleave_heap_add_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    AVFormatInternal *internal = s->internal;
+    AVStream *st = s->streams[pkt->stream_index];
+    AVPacketList *pktl;
+    int ret;
+
+    if (!internal->interleave_queue) {
+        internal->interleave_queue = av_mallocz_array(s->nb_streams,
+                                                      sizeof(*internal->interleave_queue));
+        internal->interleave_heap  = av_malloc_array(s->nb_streams,
+                                                     sizeof(*internal->interleave_heap));
+        if (!internal->interleave_queue || !internal->interleave_heap) {
+            av_freep(&internal->interleave_queue);
+            av_freep(&internal->interleave_heap);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    if ((ret = new_packet_node(s, pkt, &pktl)) < 0)
+        return ret;
+
+    if (st->last_in_packet_buffer) {
+        st->last_in_packet_buffer->next = pktl;
+    } else {
+        int i = internal->nb_interleave_heap++;
+        internal->interleave_queue[pkt->stream_index] = pktl;
+        internal->interleave_heap[i] = pkt->stream_index;
+        interleave_heap_up(s, i);
+    }
+    st->last_in_packet_buffer = pktl;
+
+    return 0;
+}
+
+static void interleave_heap_get_packet(AVFormatContext *s, AVPacket *out)
+{
+    AVFormatInternal *internal = s->internal;
+    int stream_index   = internal->interleave_heap[0];
+    AVPacketList *pktl = internal->interleave_queue[stream_index];
+
+    *out = pktl->pkt;
+    internal->interleave_queue[stream_index] = pktl->next;
+    if (!pktl->next) {
+        s->streams[stream_index]->last_in_packet_buffer = NULL;
+        internal->interleave_heap[0] =
+            internal->interleave_heap[--internal->nb_interleave_heap];
+    }
+    interleave_heap_down(s, 0);
+    ff_packet_list_put_node(s, pktl);
+}
+
 int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
                                  AVPacket *pkt, int flush)
 {
@@ -838,7 +951,14 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
     int i, ret;
 
     if (pkt) {
-        if ((ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts)) < 0)
+        /* chunking and packets already queued with another comparison
+         * function need the shared packet_buffer list */
+        if (s->max_chunk_size || s->max_chunk_duration ||
+            s->internal->packet_buffer)
+            ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts);
+        else
+            ret = interleave_heap_add_packet(s, pkt);
+        if (ret < 0)
             return ret;
     }
 
@@ -855,12 +975,19 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
     if (s->internal->nb_interleaved_streams == stream_count)
         flush = 1;
 
+    if (s->internal->packet_buffer)
+        pktl = s->internal->packet_buffer;
+    else if (s->internal->nb_interleave_heap)
+        pktl = s->internal->interleave_queue[s->internal->interleave_heap[0]];
+    else
+        pktl = NULL;
+
     if (s->max_interleave_delta > 0 &&
-        s->internal->packet_buffer &&
+        pktl &&
         !flush &&
         s->internal->nb_interleaved_streams == stream_count+noninterleaved_count
     ) {
-        AVPacket *top_pkt = &s->internal->packet_buffer->pkt;
+        AVPacket *top_pkt = &pktl->pkt;
         int64_t delta_dts = INT64_MIN;
         int64_t top_dts = av_rescale_q(top_pkt->dts,
                                        s->streams[top_pkt->stream_index]->time_base,
@@ -890,6 +1017,12 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
 
     if (stream_count && flush) {
         AVStream *st;
+
+        if (!s->internal->packet_buffer) {
+            interleave_heap_get_packet(s, out);
+            return 1;
+        }
+
         pktl = s->internal->packet_buffer;
         *out = pktl->pkt;
         st   = s->streams[out->stream_index];
@@ -900,7 +1033,7 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
 
         if (st->last_in_packet_buffer == pktl)
             st->last_in_packet_buffer = NULL;
-        av_freep(&pktl);
+        ff_packet_list_put_node(s, pktl);
 
         return 1;
     } else {
@@ -929,7 +1062,7 @@ static int interleave_packet(AVFormatContext *s, AVPacket *out, AVPacket *in, in
         return ff_interleave_packet_per_dts(s, out, in, flush);
 }
 
-int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
+static int interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
 {
     int ret, flush = 0;
 
@@ -983,6 +1116,16 @@ fail:
     return ret;
 }
 
+int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
+{
+    int ret;
+
+    av_trace_begin("mux", s->oformat->name);
+    ret = interleaved_write_frame(s, pkt);
+    av_trace_end("mux", s->oformat->name);
+    return ret;
+}
+
 int av_write_trailer(AVFormatContext *s)
 {
     int ret, i;
@@ -2590,7 +2590,7 @@ static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket
                 if(s->streams[pktl->pkt.stream_index]->last_in_packet_buffer == pktl)
                     s->streams[pktl->pkt.stream_index]->last_in_packet_buffer= NULL;
                 av_free_packet(&pktl->pkt);
-                av_freep(&pktl);
+                ff_packet_list_put_node(s, pktl);
                 pktl = next;
             }
             if (last)
@@ -2610,7 +2610,7 @@ static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket
             s->streams[pktl->pkt.stream_index]->last_in_packet_buffer= NULL;
         if(!s->internal->packet_buffer)
             s->internal->packet_buffer_end= NULL;
-        av_freep(&pktl);
+        ff_packet_list_put_node(s, pktl);
         return 1;
     } else {
     out:
@@ -1324,6 +1324,10 @@ AVInputFormat ff_nut_demuxer = {
     .flags          = AVFMT_SEEK_TO_PTS,
     .priv_data_size = sizeof(NUTContext),
     .read_probe     = nut_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, ID_STRING, sizeof(ID_STRING) - 1 },
+        { 0 }
+    },
     .read_header    = nut_read_header,
     .read_packet    = nut_read_packet,
     .read_close     = nut_read_close,
@@ -927,6 +927,10 @@ AVInputFormat ff_ogg_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("Ogg"),
     .priv_data_size = sizeof(struct ogg),
     .read_probe     = ogg_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "OggS", 4 },
+        { 0 }
+    },
     .read_header    = ogg_read_header,
     .read_packet    = ogg_read_packet,
     .read_close     = ogg_read_close,
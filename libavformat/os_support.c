@@ -23,11 +23,55 @@
 /* needed by inet_aton() */
 #define _DEFAULT_SOURCE
 #define _SVID_SOURCE
+/* needed by fallocate() */
+#define _GNU_SOURCE
 
 #include "config.h"
+#include "libavutil/internal.h"
 #include "avformat.h"
 #include "os_support.h"
 
+#if HAVE_FALLOCATE
+#include <fcntl.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#endif
+
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+int ff_file_block_size(const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) < 0)
+        return AVERROR(errno);
+    return st.st_blksize;
+}
+
+int ff_file_insert_range(const char *path, int64_t offset, int64_t len)
+{
+    int fd, ret = 0;
+
+    fd = avpriv_open(path, O_RDWR);
+    if (fd < 0)
+        return AVERROR(errno);
+    if (fallocate(fd, FALLOC_FL_INSERT_RANGE, offset, len) < 0)
+        ret = AVERROR(errno);
+    close(fd);
+    return ret;
+}
+#else
+int ff_file_block_size(const char *path)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_file_insert_range(const char *path, int64_t offset, int64_t len)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
 #if CONFIG_NETWORK
 #include <fcntl.h>
 #if !HAVE_POLL_H
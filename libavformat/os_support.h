@@ -29,6 +29,7 @@
 
 #include "config.h"
 
+#include <stdint.h>
 #include <sys/stat.h>
 
 #ifdef _WIN32
@@ -67,6 +68,28 @@
 #  define lseek(f,p,w) lseek64((f), (p), (w))
 #endif
 
+/**
+ * Get the block size of the filesystem holding a file, which is the
+ * granularity of ff_file_insert_range().
+ *
+ * @return the block size, AVERROR(ENOSYS) if ranges cannot be inserted on
+ *         this system, another negative error code on failure
+ */
+int ff_file_block_size(const char *path);
+
+/**
+ * Insert a zero-filled range in a file, moving the data after offset without
+ * copying it (FALLOC_FL_INSERT_RANGE on Linux).
+ *
+ * @param offset position of the inserted range, must be a multiple of the
+ *               filesystem block size and lower than the file size
+ * @param len    size of the inserted range, must be a multiple of the
+ *               filesystem block size
+ * @return 0 on success, AVERROR(ENOSYS) if not supported on this system,
+ *         another negative error code if the filesystem does not support it
+ */
+int ff_file_insert_range(const char *path, int64_t offset, int64_t len);
+
 static inline int is_dos_path(const char *path)
 {
 #if HAVE_DOS_PATHS
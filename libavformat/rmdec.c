@@ -1141,6 +1141,11 @@ AVInputFormat ff_rm_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("RealMedia"),
     .priv_data_size = sizeof(RMDemuxContext),
     .read_probe     = rm_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, ".RMF", 4 },
+        { 0, ".ra\xfd", 4 },
+        { 0 }
+    },
     .read_header    = rm_read_header,
     .read_packet    = rm_read_packet,
     .read_close     = rm_read_close,
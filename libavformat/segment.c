@@ -30,7 +30,9 @@
 #include <time.h>
 
 #include "avformat.h"
+#include "avio_internal.h"
 #include "internal.h"
+#include "segwriter.h"
 
 #include "libavutil/avassert.h"
 #include "libavutil/internal.h"
@@ -115,7 +117,8 @@ typedef struct SegmentContext {
     int   break_non_keyframes;
 
     int use_rename;
-    char temp_list_filename[1024];
+    int async_queue_size;  ///< number of pending jobs of the background writer, 0 to disable it
+    SegmentWriter *writer;
 
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
@@ -262,9 +265,13 @@ static int segment_list_open(AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     int ret;
 
-    snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = avio_open2(&seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE,
-                     &s->interrupt_callback, NULL);
+    /* lists rewritten at each segment are rendered in memory and published
+     * atomically by segment_end() */
+    if (seg->list_size || seg->list_type == LIST_TYPE_M3U8)
+        ret = avio_open_dyn_buf(&seg->list_pb);
+    else
+        ret = avio_open2(&seg->list_pb, seg->list, AVIO_FLAG_WRITE,
+                         &s->interrupt_callback, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -332,22 +339,37 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
-    int ret = 0;
+    char filename[1024];
+    int ret = 0, err;
 
+    av_strlcpy(filename, oc->filename, sizeof(filename));
     av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
-    if (write_trailer)
-        ret = av_write_trailer(oc);
 
-    if (ret < 0)
-        av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
-               oc->filename);
+    /* The segment is closed before the list referencing it is updated. With a
+     * background writer, the whole muxer context is handed over when its
+     * trailer has to be written, segment_start() then allocates a new one. */
+    if (write_trailer && seg->writer) {
+        seg->avf = NULL;
+        ret = ff_segwriter_finish_muxer(seg->writer, s, &oc);
+    } else {
+        if (write_trailer)
+            ret = av_write_trailer(oc);
+
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
+                   oc->filename);
+
+        err = ff_segwriter_close_io(seg->writer, s, &oc->pb);
+        if (ret >= 0)
+            ret = err;
+    }
 
     if (seg->list) {
         if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
             SegmentListEntry *entry = av_mallocz(sizeof(*entry));
             if (!entry) {
-                ret = AVERROR(ENOMEM);
-                goto end;
+                err = AVERROR(ENOMEM);
+                goto fail;
             }
 
             /* append new element */
@@ -367,29 +389,34 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 av_freep(&entry);
             }
 
-            if ((ret = segment_list_open(s)) < 0)
-                goto end;
+            if ((err = segment_list_open(s)) < 0)
+                goto fail;
             for (entry = seg->segment_list_entries; entry; entry = entry->next)
                 segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
             if (seg->list_type == LIST_TYPE_M3U8 && is_last)
                 avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            avio_closep(&seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
+            err = ff_segwriter_publish(seg->writer, s, seg->list, &seg->list_pb,
+                                       seg->use_rename, &s->interrupt_callback, NULL);
         } else {
-            segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
-            avio_flush(seg->list_pb);
+            AVIOContext *entry_pb;
+
+            if ((err = avio_open_dyn_buf(&entry_pb)) < 0)
+                goto fail;
+            segment_list_print_entry(entry_pb, seg->list_type, &seg->cur_entry, s);
+            err = ff_segwriter_append(seg->writer, s, seg->list_pb, &entry_pb);
         }
+        if (ret >= 0)
+            ret = err;
     }
 
     av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
-           seg->avf->filename, seg->segment_count);
+           filename, seg->segment_count);
     seg->segment_count++;
-
-end:
-    avio_closep(&oc->pb);
-
     return ret;
+
+fail:
+    /* keep the error of the segment itself if there was one */
+    return ret < 0 ? ret : err;
 }
 
 static int parse_times(void *log_ctx, int64_t **times, int *nb_times,
@@ -588,6 +615,7 @@ static int select_reference_stream(AVFormatContext *s)
 
 static void seg_free_context(SegmentContext *seg)
 {
+    ff_segwriter_close(&seg->writer);
     avio_closep(&seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -682,6 +710,15 @@ static int seg_write_header(AVFormatContext *s)
         goto fail;
     }
 
+    if (seg->async_queue_size) {
+        ret = ff_segwriter_open(&seg->writer, s, seg->async_queue_size);
+        if (ret == AVERROR(ENOSYS))
+            av_log(s, AV_LOG_WARNING,
+                   "Asynchronous writing requires thread support, writing synchronously\n");
+        else if (ret < 0)
+            goto fail;
+    }
+
     if ((ret = segment_mux_init(s)) < 0)
         goto fail;
     oc = seg->avf;
@@ -864,21 +901,31 @@ static int seg_write_trailer(struct AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
     SegmentListEntry *cur, *next;
-    int ret = 0;
+    int ret, ret2;
+
+    /* wait for the pending segments, the last one is written synchronously */
+    ret = ff_segwriter_close(&seg->writer);
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Failure occurred in the background writer\n");
 
     if (!oc)
         goto fail;
 
+    /* the first error is returned, a failed background job included */
     if (!seg->write_header_trailer) {
-        if ((ret = segment_end(s, 0, 1)) < 0)
+        if ((ret2 = segment_end(s, 0, 1)) < 0 ||
+            (ret2 = open_null_ctx(&oc->pb)) < 0) {
+            if (ret >= 0)
+                ret = ret2;
             goto fail;
-        if ((ret = open_null_ctx(&oc->pb)) < 0)
-            goto fail;
-        ret = av_write_trailer(oc);
+        }
+        ret2 = av_write_trailer(oc);
         close_null_ctxp(&oc->pb);
     } else {
-        ret = segment_end(s, 1, 1);
+        ret2 = segment_end(s, 1, 1);
     }
+    if (ret >= 0)
+        ret = ret2;
 fail:
     if (seg->list)
         avio_closep(&seg->list_pb);
@@ -939,6 +986,7 @@ static const AVOption options[] = {
 
     { "individual_header_trailer", "write header/trailer to each segment", OFFSET(individual_header_trailer), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, E },
     { "write_header_trailer", "write a header to the first segment and a trailer to the last one", OFFSET(write_header_trailer), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, E },
+    { "segment_async_queue_size", "close segments and write lists in a background thread with the given number of pending jobs, 0 to disable", OFFSET(async_queue_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
     { "reset_timestamps", "reset timestamps at the begin of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { NULL },
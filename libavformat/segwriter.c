@@ -0,0 +1,271 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "segwriter.h"
+
+enum SegmentWriterJobType {
+    JOB_CLOSE_IO,
+    JOB_FINISH_MUXER,
+    JOB_PUBLISH,
+    JOB_APPEND,
+};
+
+typedef struct SegmentWriterJob {
+    enum SegmentWriterJobType type;
+    AVIOContext *pb;
+    AVFormatContext *oc;
+    char *filename;
+    uint8_t *buf;
+    int size;
+    int use_rename;
+    AVIOInterruptCB int_cb;
+    AVDictionary *options;
+} SegmentWriterJob;
+
+struct SegmentWriter {
+    void *logctx;
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int error;              ///< first job error, only read once the thread has exited
+};
+
+static int publish(void *logctx, SegmentWriterJob *job)
+{
+    AVIOContext *out = NULL;
+    char temp_filename[1024];
+    int ret;
+
+    snprintf(temp_filename, sizeof(temp_filename),
+             job->use_rename ? "%s.tmp" : "%s", job->filename);
+    ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE,
+                     &job->int_cb, &job->options);
+    if (ret < 0) {
+        av_log(logctx, AV_LOG_ERROR, "Failed to open '%s'\n", temp_filename);
+        return ret;
+    }
+    avio_write(out, job->buf, job->size);
+    ret = avio_closep(&out);
+    if (ret >= 0 && job->use_rename)
+        ret = ff_rename(temp_filename, job->filename, logctx);
+    return ret;
+}
+
+static void free_job(SegmentWriterJob *job)
+{
+    /* appended-to contexts are owned by the caller */
+    if (job->type != JOB_APPEND)
+        avio_closep(&job->pb);
+    if (job->oc) {
+        avio_closep(&job->oc->pb);
+        avformat_free_context(job->oc);
+        job->oc = NULL;
+    }
+    av_freep(&job->filename);
+    av_freep(&job->buf);
+    av_dict_free(&job->options);
+}
+
+static int run_job(void *logctx, SegmentWriterJob *job)
+{
+    int ret = 0;
+
+    switch (job->type) {
+    case JOB_CLOSE_IO:
+        ret = avio_closep(&job->pb);
+        break;
+    case JOB_FINISH_MUXER:
+        ret = av_write_trailer(job->oc);
+        if (ret < 0)
+            av_log(logctx, AV_LOG_ERROR,
+                   "Failure occurred when ending segment '%s'\n", job->oc->filename);
+        break;
+    case JOB_PUBLISH:
+        ret = publish(logctx, job);
+        break;
+    case JOB_APPEND:
+        avio_write(job->pb, job->buf, job->size);
+        avio_flush(job->pb);
+        ret = job->pb->error;
+        break;
+    }
+
+    free_job(job);
+    return ret;
+}
+
+#if HAVE_THREADS
+static void *writer_thread(void *arg)
+{
+    SegmentWriter *sw = arg;
+    SegmentWriterJob job;
+    int ret;
+
+    while (av_thread_message_queue_recv(sw->queue, &job, 0) >= 0) {
+        ret = run_job(sw->logctx, &job);
+        if (ret < 0 && !sw->error) {
+            sw->error = ret;
+            av_thread_message_queue_set_err_send(sw->queue, ret);
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+int ff_segwriter_open(SegmentWriter **psw, void *logctx, int queue_size)
+{
+#if HAVE_THREADS
+    SegmentWriter *sw;
+    int ret;
+
+    sw = av_mallocz(sizeof(*sw));
+    if (!sw)
+        return AVERROR(ENOMEM);
+    sw->logctx = logctx;
+
+    ret = av_thread_message_queue_alloc(&sw->queue, FFMAX(queue_size, 1),
+                                        sizeof(SegmentWriterJob));
+    if (ret < 0)
+        goto fail;
+
+    ret = pthread_create(&sw->thread, NULL, writer_thread, sw);
+    if (ret) {
+        av_log(logctx, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    *psw = sw;
+    return 0;
+
+fail:
+    av_thread_message_queue_free(&sw->queue);
+    av_free(sw);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_segwriter_close(SegmentWriter **psw)
+{
+    SegmentWriter *sw = *psw;
+    int ret;
+
+    if (!sw)
+        return 0;
+
+#if HAVE_THREADS
+    av_thread_message_queue_set_err_recv(sw->queue, AVERROR_EOF);
+    pthread_join(sw->thread, NULL);
+#endif
+    ret = sw->error;
+
+    av_thread_message_queue_free(&sw->queue);
+    av_freep(psw);
+    return ret;
+}
+
+static int submit_job(SegmentWriter *sw, void *logctx, SegmentWriterJob *job)
+{
+    int ret;
+
+    if (!sw)
+        return run_job(logctx, job);
+
+    ret = av_thread_message_queue_send(sw->queue, job, 0);
+    if (ret < 0) {
+        /* a previous job failed, the writer only drains what it has queued */
+        free_job(job);
+        return ret;
+    }
+    return 0;
+}
+
+int ff_segwriter_close_io(SegmentWriter *sw, void *logctx, AVIOContext **pb)
+{
+    SegmentWriterJob job = { JOB_CLOSE_IO };
+
+    if (!*pb)
+        return 0;
+
+    job.pb = *pb;
+    *pb = NULL;
+    return submit_job(sw, logctx, &job);
+}
+
+int ff_segwriter_finish_muxer(SegmentWriter *sw, void *logctx,
+                              AVFormatContext **oc)
+{
+    SegmentWriterJob job = { JOB_FINISH_MUXER };
+
+    job.oc = *oc;
+    *oc = NULL;
+    return submit_job(sw, logctx, &job);
+}
+
+int ff_segwriter_publish(SegmentWriter *sw, void *logctx, const char *filename,
+                         AVIOContext **dyn_pb, int use_rename,
+                         const AVIOInterruptCB *int_cb, AVDictionary *options)
+{
+    SegmentWriterJob job = { JOB_PUBLISH };
+    int ret;
+
+    job.size = avio_close_dyn_buf(*dyn_pb, &job.buf);
+    *dyn_pb = NULL;
+    job.use_rename = use_rename;
+    if (int_cb)
+        job.int_cb = *int_cb;
+
+    job.filename = av_strdup(filename);
+    if (!job.filename) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = av_dict_copy(&job.options, options, 0)) < 0) {
+        free_job(&job);
+        return ret;
+    }
+
+    return submit_job(sw, logctx, &job);
+}
+
+int ff_segwriter_append(SegmentWriter *sw, void *logctx, AVIOContext *pb,
+                        AVIOContext **dyn_pb)
+{
+    SegmentWriterJob job = { JOB_APPEND };
+
+    job.size = avio_close_dyn_buf(*dyn_pb, &job.buf);
+    *dyn_pb = NULL;
+    job.pb = pb;
+    return submit_job(sw, logctx, &job);
+}
@@ -0,0 +1,92 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGWRITER_H
+#define AVFORMAT_SEGWRITER_H
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * @file
+ * Background writer owning the slow parts of segment rotation: closing
+ * finished segment files, writing their trailers and publishing playlists.
+ *
+ * Jobs are executed in submission order on a single thread fed by a bounded
+ * queue, so a playlist submitted after a segment close never references a
+ * segment that is still being written. When the queue is full, submitting
+ * blocks, which bounds the amount of memory held by pending segments.
+ *
+ * All the submission functions accept a NULL writer, in which case the job
+ * is executed synchronously in the calling thread and errors are logged to
+ * their logctx argument. Once a job has failed, every following submission
+ * returns the first error.
+ */
+
+typedef struct SegmentWriter SegmentWriter;
+
+/**
+ * Start a background writer.
+ *
+ * @param queue_size maximum number of pending jobs
+ * @return 0 on success, AVERROR(ENOSYS) if built without thread support,
+ *         another negative AVERROR code on failure
+ */
+int ff_segwriter_open(SegmentWriter **sw, void *logctx, int queue_size);
+
+/**
+ * Wait for all pending jobs to complete and free the writer.
+ *
+ * @return the first error returned by a job, 0 if all of them succeeded
+ */
+int ff_segwriter_close(SegmentWriter **sw);
+
+/**
+ * Close an I/O context. The writer takes ownership of *pb and sets it to NULL.
+ */
+int ff_segwriter_close_io(SegmentWriter *sw, void *logctx, AVIOContext **pb);
+
+/**
+ * Write the trailer of a muxer context, close its I/O context and free it.
+ * The writer takes ownership of *oc and sets it to NULL.
+ */
+int ff_segwriter_finish_muxer(SegmentWriter *sw, void *logctx,
+                              AVFormatContext **oc);
+
+/**
+ * Write the content of a dynamic buffer to a file, replacing the file
+ * atomically if use_rename is set.
+ *
+ * @param dyn_pb  dynamic buffer opened with avio_open_dyn_buf(), it is
+ *                closed and set to NULL
+ * @param options options passed to avio_open2(), copied
+ */
+int ff_segwriter_publish(SegmentWriter *sw, void *logctx, const char *filename,
+                         AVIOContext **dyn_pb, int use_rename,
+                         const AVIOInterruptCB *int_cb, AVDictionary *options);
+
+/**
+ * Append the content of a dynamic buffer to an I/O context and flush it.
+ * pb must not be accessed outside of the writer until it is closed.
+ */
+int ff_segwriter_append(SegmentWriter *sw, void *logctx, AVIOContext *pb,
+                        AVIOContext **dyn_pb);
+
+#endif /* AVFORMAT_SEGWRITER_H */
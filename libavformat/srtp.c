@@ -41,13 +41,21 @@ void ff_srtp_free(struct SRTPContext *s)
 static void encrypt_counter(struct AVAES *aes, uint8_t *iv, uint8_t *outbuf,
                             int outlen)
 {
-    int i, j, outpos;
-    for (i = 0, outpos = 0; outpos < outlen; i++) {
-        uint8_t keystream[16];
-        AV_WB16(&iv[14], i);
-        av_aes_crypt(aes, keystream, iv, 1, NULL, 0);
-        for (j = 0; j < 16 && outpos < outlen; j++, outpos++)
+    // Generate the keystream a few blocks at a time, the counter blocks
+    // are independent and can be encrypted in one go.
+    uint8_t keystream[16 * 16];
+    int i = 0, j, outpos = 0;
+
+    while (outpos < outlen) {
+        int blocks = FFMIN((outlen - outpos + 15) >> 4, 16);
+        for (j = 0; j < blocks; j++) {
+            memcpy(&keystream[16 * j], iv, 14);
+            AV_WB16(&keystream[16 * j + 14], i + j);
+        }
+        av_aes_crypt(aes, keystream, keystream, blocks, NULL, 0);
+        for (j = 0; j < 16 * blocks && outpos < outlen; j++, outpos++)
             outbuf[outpos] ^= keystream[j];
+        i += blocks;
     }
 }
 
@@ -20,12 +20,24 @@
  */
 
 
+#include "config.h"
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
 #include "avformat.h"
 
 #define MAX_SLAVES 16
+#define DEFAULT_SLAVE_QUEUE_SIZE 256
+#define SLAVE_RESTART_DELAY 1000000
+
+typedef enum {
+    ON_SLAVE_FAILURE_ABORT,
+    ON_SLAVE_FAILURE_IGNORE,
+    ON_SLAVE_FAILURE_RESTART,
+} SlaveFailurePolicy;
 
 typedef struct {
     AVFormatContext *avf;
@@ -34,6 +46,23 @@ typedef struct {
     /** map from input to output streams indexes,
      * disabled output streams are set to -1 */
     int *stream_map;
+
+    char *spec;                      ///< slave specification, to restart it
+    SlaveFailurePolicy on_fail;
+    int failed;                      ///< closed after a failure
+    int64_t restart_time;
+    uint8_t *wait_keyframe;          ///< per input stream, after a restart
+
+    /** threaded slaves only */
+    int async;
+    int queue_size;
+    int drop_on_overflow;
+    unsigned nb_dropped;
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_started;
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -140,6 +169,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     AVDictionaryEntry *entry;
     char *filename;
     char *format = NULL, *select = NULL;
+    char *async = NULL, *queue_size = NULL, *on_overflow = NULL, *on_fail = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -159,10 +189,49 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 
     STEAL_OPTION("f", format);
     STEAL_OPTION("select", select);
+    STEAL_OPTION("async", async);
+    STEAL_OPTION("queue_size", queue_size);
+    STEAL_OPTION("onoverflow", on_overflow);
+    STEAL_OPTION("onfail", on_fail);
+
+    tee_slave->async = async ? strtol(async, NULL, 0) : 0;
+    tee_slave->queue_size = queue_size ? strtol(queue_size, NULL, 0)
+                                       : DEFAULT_SLAVE_QUEUE_SIZE;
+    if (tee_slave->queue_size <= 0) {
+        av_log(avf, AV_LOG_ERROR, "Invalid queue size '%s' for slave '%s'\n",
+               queue_size, slave);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    if (!on_overflow || !strcmp(on_overflow, "block")) {
+        tee_slave->drop_on_overflow = 0;
+    } else if (!strcmp(on_overflow, "drop")) {
+        tee_slave->drop_on_overflow = 1;
+    } else {
+        av_log(avf, AV_LOG_ERROR, "Invalid onoverflow value '%s' for slave '%s', "
+               "valid values are 'block' and 'drop'\n", on_overflow, slave);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    if (!on_fail || !strcmp(on_fail, "abort")) {
+        tee_slave->on_fail = ON_SLAVE_FAILURE_ABORT;
+    } else if (!strcmp(on_fail, "ignore")) {
+        tee_slave->on_fail = ON_SLAVE_FAILURE_IGNORE;
+    } else if (!strcmp(on_fail, "restart")) {
+        tee_slave->on_fail = ON_SLAVE_FAILURE_RESTART;
+    } else {
+        av_log(avf, AV_LOG_ERROR, "Invalid onfail value '%s' for slave '%s', "
+               "valid values are 'abort', 'ignore' and 'restart'\n", on_fail, slave);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
 
     ret = avformat_alloc_output_context2(&avf2, NULL, format, filename);
     if (ret < 0)
         goto end;
+    tee_slave->avf = avf2;
     av_dict_copy(&avf2->metadata, avf->metadata, 0);
 
     tee_slave->stream_map = av_calloc(avf->nb_streams, sizeof(*tee_slave->stream_map));
@@ -239,8 +308,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
-    tee_slave->avf = avf2;
-    tee_slave->bsfs = av_calloc(avf2->nb_streams, sizeof(TeeSlave));
+    tee_slave->bsfs = av_calloc(avf2->nb_streams, sizeof(*tee_slave->bsfs));
     if (!tee_slave->bsfs) {
         ret = AVERROR(ENOMEM);
         goto end;
@@ -254,7 +322,8 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
                 av_log(avf, AV_LOG_ERROR,
                        "Specifier separator in '%s' is '%c', but only characters '%s' "
                        "are allowed\n", entry->key, *spec, slave_bsfs_spec_sep);
-                return AVERROR(EINVAL);
+                ret = AVERROR(EINVAL);
+                goto end;
             }
             spec++; /* consume separator */
         }
@@ -301,34 +370,48 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 end:
     av_free(format);
     av_free(select);
+    av_free(async);
+    av_free(queue_size);
+    av_free(on_overflow);
+    av_free(on_fail);
     av_dict_free(&options);
     av_freep(&tmp_select);
     return ret;
 }
 
-static void close_slaves(AVFormatContext *avf)
+static void close_slave(TeeSlave *tee_slave)
 {
-    TeeContext *tee = avf->priv_data;
-    AVFormatContext *avf2;
-    unsigned i, j;
+    AVFormatContext *avf2 = tee_slave->avf;
+    unsigned i;
 
-    for (i = 0; i < tee->nb_slaves; i++) {
-        avf2 = tee->slaves[i].avf;
+    if (!avf2)
+        return;
 
-        for (j = 0; j < avf2->nb_streams; j++) {
-            AVBitStreamFilterContext *bsf_next, *bsf = tee->slaves[i].bsfs[j];
-            while (bsf) {
-                bsf_next = bsf->next;
-                av_bitstream_filter_close(bsf);
-                bsf = bsf_next;
-            }
+    for (i = 0; tee_slave->bsfs && i < avf2->nb_streams; i++) {
+        AVBitStreamFilterContext *bsf_next, *bsf = tee_slave->bsfs[i];
+        while (bsf) {
+            bsf_next = bsf->next;
+            av_bitstream_filter_close(bsf);
+            bsf = bsf_next;
         }
-        av_freep(&tee->slaves[i].stream_map);
-        av_freep(&tee->slaves[i].bsfs);
+    }
+    av_freep(&tee_slave->stream_map);
+    av_freep(&tee_slave->bsfs);
+
+    avio_closep(&avf2->pb);
+    avformat_free_context(avf2);
+    tee_slave->avf = NULL;
+}
+
+static void close_slaves(AVFormatContext *avf)
+{
+    TeeContext *tee = avf->priv_data;
+    unsigned i;
 
-        avio_closep(&avf2->pb);
-        avformat_free_context(avf2);
-        tee->slaves[i].avf = NULL;
+    for (i = 0; i < tee->nb_slaves; i++) {
+        close_slave(&tee->slaves[i]);
+        av_freep(&tee->slaves[i].spec);
+        av_freep(&tee->slaves[i].wait_keyframe);
     }
 }
 
@@ -356,6 +439,230 @@ static void log_slave(TeeSlave *slave, void *log_ctx, int log_level)
     }
 }
 
+static int filter_packet(void *log_ctx, AVPacket *pkt,
+                         AVFormatContext *fmt_ctx, AVBitStreamFilterContext *bsf_ctx)
+{
+    AVCodecContext *enc_ctx = fmt_ctx->streams[pkt->stream_index]->codec;
+    int ret = 0;
+
+    while (bsf_ctx) {
+        AVPacket new_pkt = *pkt;
+        ret = av_bitstream_filter_filter(bsf_ctx, enc_ctx, NULL,
+                                             &new_pkt.data, &new_pkt.size,
+                                             pkt->data, pkt->size,
+                                             pkt->flags & AV_PKT_FLAG_KEY);
+        if (ret == 0 && new_pkt.data != pkt->data) {
+            if ((ret = av_copy_packet(&new_pkt, pkt)) < 0)
+                break;
+            ret = 1;
+        }
+
+        if (ret > 0) {
+            av_free_packet(pkt);
+            new_pkt.buf = av_buffer_create(new_pkt.data, new_pkt.size,
+                                           av_buffer_default_free, NULL, 0);
+            if (!new_pkt.buf)
+                break;
+        }
+        if (ret < 0) {
+            av_log(log_ctx, AV_LOG_ERROR,
+                "Failed to filter bitstream with filter %s for stream %d in file '%s' with codec %s\n",
+                bsf_ctx->filter->name, pkt->stream_index, fmt_ctx->filename,
+                avcodec_get_name(enc_ctx->codec_id));
+        }
+        *pkt = new_pkt;
+
+        bsf_ctx = bsf_ctx->next;
+    }
+
+    return ret;
+}
+
+static int open_slave_spec(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+    char *spec = av_strdup(tee_slave->spec);
+    int ret;
+
+    if (!spec)
+        return AVERROR(ENOMEM);
+    ret = open_slave(avf, spec, tee_slave);
+    av_free(spec);
+    if (ret < 0)
+        close_slave(tee_slave);
+    return ret;
+}
+
+static int restart_slave(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+    int ret, i;
+
+    tee_slave->restart_time = av_gettime_relative() + SLAVE_RESTART_DELAY;
+    if ((ret = open_slave_spec(avf, tee_slave)) < 0) {
+        av_log(avf, AV_LOG_ERROR, "Slave '%s': restart failed: %s\n",
+               tee_slave->spec, av_err2str(ret));
+        return ret;
+    }
+
+    if (!tee_slave->wait_keyframe &&
+        !(tee_slave->wait_keyframe = av_malloc(avf->nb_streams)))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < avf->nb_streams; i++)
+        tee_slave->wait_keyframe[i] = 1;
+
+    av_log(avf, AV_LOG_INFO, "Slave '%s' restarted\n", tee_slave->spec);
+    tee_slave->failed = 0;
+    return 0;
+}
+
+static int process_slave_failure(AVFormatContext *avf, TeeSlave *tee_slave,
+                                 int err)
+{
+    if (tee_slave->on_fail == ON_SLAVE_FAILURE_ABORT)
+        return err;
+
+    av_log(avf, AV_LOG_ERROR, "Slave '%s' failed: %s, %s\n",
+           tee_slave->spec, av_err2str(err),
+           tee_slave->on_fail == ON_SLAVE_FAILURE_RESTART ?
+           "restarting it" : "ignoring it");
+
+    if (tee_slave->avf) {
+        av_write_trailer(tee_slave->avf);
+        close_slave(tee_slave);
+    }
+    tee_slave->failed = 1;
+    tee_slave->restart_time = av_gettime_relative() + SLAVE_RESTART_DELAY;
+    return 0;
+}
+
+/**
+ * Write an input packet to a slave, taking ownership of it.
+ */
+static int slave_write_packet(AVFormatContext *avf, TeeSlave *tee_slave,
+                              AVPacket *pkt)
+{
+    AVFormatContext *avf2;
+    AVRational tb, tb2;
+    int ret, s = pkt->stream_index, s2;
+
+    if (tee_slave->failed) {
+        if (tee_slave->on_fail != ON_SLAVE_FAILURE_RESTART ||
+            av_gettime_relative() < tee_slave->restart_time ||
+            restart_slave(avf, tee_slave) < 0) {
+            av_packet_unref(pkt);
+            return 0;
+        }
+    }
+
+    avf2 = tee_slave->avf;
+    s2   = tee_slave->stream_map[s];
+    if (s2 < 0) {
+        av_packet_unref(pkt);
+        return 0;
+    }
+
+    if (tee_slave->wait_keyframe && tee_slave->wait_keyframe[s]) {
+        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(pkt);
+            return 0;
+        }
+        tee_slave->wait_keyframe[s] = 0;
+    }
+
+    tb  = avf ->streams[s ]->time_base;
+    tb2 = avf2->streams[s2]->time_base;
+    pkt->pts      = av_rescale_q(pkt->pts,      tb, tb2);
+    pkt->dts      = av_rescale_q(pkt->dts,      tb, tb2);
+    pkt->duration = av_rescale_q(pkt->duration, tb, tb2);
+    pkt->stream_index = s2;
+
+    filter_packet(avf2, pkt, avf2, tee_slave->bsfs[s2]);
+    if ((ret = av_interleaved_write_frame(avf2, pkt)) < 0)
+        return process_slave_failure(avf, tee_slave, ret);
+    return 0;
+}
+
+#if HAVE_THREADS
+typedef struct SlaveThreadArg {
+    AVFormatContext *avf;
+    TeeSlave *tee_slave;
+} SlaveThreadArg;
+
+static void *slave_thread(void *arg)
+{
+    AVFormatContext *avf = ((SlaveThreadArg *)arg)->avf;
+    TeeSlave *tee_slave  = ((SlaveThreadArg *)arg)->tee_slave;
+    AVPacket pkt;
+    int ret;
+
+    av_free(arg);
+    while (av_thread_message_queue_recv(tee_slave->queue, &pkt, 0) >= 0) {
+        if ((ret = slave_write_packet(avf, tee_slave, &pkt)) < 0) {
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+    }
+    return NULL;
+}
+#endif
+
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    SlaveThreadArg *arg;
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                        sizeof(AVPacket));
+    if (ret < 0)
+        return ret;
+
+    if (!(arg = av_malloc(sizeof(*arg))))
+        return AVERROR(ENOMEM);
+    arg->avf       = avf;
+    arg->tee_slave = tee_slave;
+    ret = pthread_create(&tee_slave->thread, NULL, slave_thread, arg);
+    if (ret) {
+        av_free(arg);
+        av_log(avf, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+#else
+    av_log(avf, AV_LOG_ERROR, "Slave '%s': asynchronous output requires "
+           "thread support\n", tee_slave->spec);
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Wait for a slave thread to write all its queued packets, and stop it.
+ */
+static void stop_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+    AVPacket pkt;
+
+    if (!tee_slave->queue)
+        return;
+#if HAVE_THREADS
+    if (tee_slave->thread_started) {
+        av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+        pthread_join(tee_slave->thread, NULL);
+        tee_slave->thread_started = 0;
+    }
+#endif
+    /* packets left after a failure */
+    av_thread_message_queue_set_err_recv(tee_slave->queue, 0);
+    while (av_thread_message_queue_recv(tee_slave->queue, &pkt,
+                                        AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        av_packet_unref(&pkt);
+    av_thread_message_queue_free(&tee_slave->queue);
+
+    if (tee_slave->nb_dropped)
+        av_log(avf, AV_LOG_WARNING, "Slave '%s': %u packets dropped\n",
+               tee_slave->spec, tee_slave->nb_dropped);
+}
+
 static int tee_write_header(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -380,14 +687,18 @@ static int tee_write_header(AVFormatContext *avf)
     }
 
     for (i = 0; i < nb_slaves; i++) {
-        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0)
+        TeeSlave *tee_slave = &tee->slaves[i];
+
+        tee->nb_slaves = i + 1;
+        tee_slave->spec = slaves[i];
+        slaves[i] = NULL;
+        if ((ret = open_slave_spec(avf, tee_slave)) < 0)
+            goto fail;
+        log_slave(tee_slave, avf, AV_LOG_VERBOSE);
+        if (tee_slave->async && (ret = start_slave_thread(avf, tee_slave)) < 0)
             goto fail;
-        log_slave(&tee->slaves[i], avf, AV_LOG_VERBOSE);
-        av_freep(&slaves[i]);
     }
 
-    tee->nb_slaves = nb_slaves;
-
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
         for (j = 0; j < tee->nb_slaves; j++)
@@ -401,49 +712,12 @@ static int tee_write_header(AVFormatContext *avf)
 fail:
     for (i = 0; i < nb_slaves; i++)
         av_freep(&slaves[i]);
+    for (i = 0; i < tee->nb_slaves; i++)
+        stop_slave_thread(avf, &tee->slaves[i]);
     close_slaves(avf);
     return ret;
 }
 
-static int filter_packet(void *log_ctx, AVPacket *pkt,
-                         AVFormatContext *fmt_ctx, AVBitStreamFilterContext *bsf_ctx)
-{
-    AVCodecContext *enc_ctx = fmt_ctx->streams[pkt->stream_index]->codec;
-    int ret = 0;
-
-    while (bsf_ctx) {
-        AVPacket new_pkt = *pkt;
-        ret = av_bitstream_filter_filter(bsf_ctx, enc_ctx, NULL,
-                                             &new_pkt.data, &new_pkt.size,
-                                             pkt->data, pkt->size,
-                                             pkt->flags & AV_PKT_FLAG_KEY);
-        if (ret == 0 && new_pkt.data != pkt->data) {
-            if ((ret = av_copy_packet(&new_pkt, pkt)) < 0)
-                break;
-            ret = 1;
-        }
-
-        if (ret > 0) {
-            av_free_packet(pkt);
-            new_pkt.buf = av_buffer_create(new_pkt.data, new_pkt.size,
-                                           av_buffer_default_free, NULL, 0);
-            if (!new_pkt.buf)
-                break;
-        }
-        if (ret < 0) {
-            av_log(log_ctx, AV_LOG_ERROR,
-                "Failed to filter bitstream with filter %s for stream %d in file '%s' with codec %s\n",
-                bsf_ctx->filter->name, pkt->stream_index, fmt_ctx->filename,
-                avcodec_get_name(enc_ctx->codec_id));
-        }
-        *pkt = new_pkt;
-
-        bsf_ctx = bsf_ctx->next;
-    }
-
-    return ret;
-}
-
 static int tee_write_trailer(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -451,8 +725,15 @@ static int tee_write_trailer(AVFormatContext *avf)
     int ret_all = 0, ret;
     unsigned i;
 
+    for (i = 0; i < tee->nb_slaves; i++)
+        if (tee->slaves[i].queue)
+            av_thread_message_queue_set_err_recv(tee->slaves[i].queue, AVERROR_EOF);
+
     for (i = 0; i < tee->nb_slaves; i++) {
+        stop_slave_thread(avf, &tee->slaves[i]);
         avf2 = tee->slaves[i].avf;
+        if (!avf2)
+            continue;
         if ((ret = av_write_trailer(avf2)) < 0)
             if (!ret_all)
                 ret_all = ret;
@@ -469,38 +750,51 @@ static int tee_write_trailer(AVFormatContext *avf)
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
-    AVFormatContext *avf2;
-    AVPacket pkt2;
+    AVPacket pkt_ref = { 0 }, pkt2;
     int ret_all = 0, ret;
-    unsigned i, s;
-    int s2;
-    AVRational tb, tb2;
+    unsigned i;
+
+    /* make sure that all the slaves share the same data */
+    if (!pkt->buf) {
+        if ((ret = av_packet_ref(&pkt_ref, pkt)) < 0)
+            return ret;
+        pkt = &pkt_ref;
+    }
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        avf2 = tee->slaves[i].avf;
-        s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
+        TeeSlave *tee_slave = &tee->slaves[i];
+
+        if (!tee_slave->queue && tee_slave->avf &&
+            tee_slave->stream_map[pkt->stream_index] < 0)
             continue;
 
-        if ((ret = av_copy_packet(&pkt2, pkt)) < 0 ||
-            (ret = av_dup_packet(&pkt2))< 0)
-            if (!ret_all) {
-                ret_all = ret;
-                continue;
-            }
-        tb  = avf ->streams[s ]->time_base;
-        tb2 = avf2->streams[s2]->time_base;
-        pkt2.pts      = av_rescale_q(pkt->pts,      tb, tb2);
-        pkt2.dts      = av_rescale_q(pkt->dts,      tb, tb2);
-        pkt2.duration = av_rescale_q(pkt->duration, tb, tb2);
-        pkt2.stream_index = s2;
-
-        filter_packet(avf2, &pkt2, avf2, tee->slaves[i].bsfs[s2]);
-        if ((ret = av_interleaved_write_frame(avf2, &pkt2)) < 0)
+        av_init_packet(&pkt2);
+        if ((ret = av_packet_ref(&pkt2, pkt)) < 0) {
             if (!ret_all)
                 ret_all = ret;
+            continue;
+        }
+
+        if (!tee_slave->queue) {
+            ret = slave_write_packet(avf, tee_slave, &pkt2);
+        } else {
+            ret = av_thread_message_queue_send(tee_slave->queue, &pkt2,
+                                               tee_slave->drop_on_overflow ?
+                                               AV_THREAD_MESSAGE_NONBLOCK : 0);
+            if (ret < 0)
+                av_packet_unref(&pkt2);
+            if (ret == AVERROR(EAGAIN)) {
+                if (!tee_slave->nb_dropped++)
+                    av_log(avf, AV_LOG_WARNING, "Slave '%s' is too slow, "
+                           "dropping packets\n", tee_slave->spec);
+                ret = 0;
+            }
+        }
+        if (ret < 0 && !ret_all)
+            ret_all = ret;
     }
+
+    av_packet_unref(&pkt_ref);
     return ret_all;
 }
 
@@ -78,6 +78,7 @@ typedef struct URLProtocol {
     int64_t (*url_seek)( URLContext *h, int64_t pos, int whence);
     int     (*url_close)(URLContext *h);
     struct URLProtocol *next;
+    struct URLProtocol *next_by_name; ///< next protocol in the same name hash bucket
     int (*url_read_pause)(URLContext *h, int pause);
     int64_t (*url_read_seek)(URLContext *h, int stream_index,
                              int64_t timestamp, int flags);
@@ -40,8 +40,10 @@
 #include "libavcodec/raw.h"
 
 #include "audiointerleave.h"
+#include "avc.h"
 #include "avformat.h"
 #include "avio_internal.h"
+#include "hevc.h"
 #include "id3v2.h"
 #include "internal.h"
 #include "metadata.h"
@@ -361,10 +363,41 @@ static int init_input(AVFormatContext *s, const char *filename,
                                  s, 0, s->format_probesize);
 }
 
-static AVPacket *add_to_pktbuf(AVPacketList **packet_buffer, AVPacket *pkt,
+/* maximum number of unused packet list nodes kept for reuse */
+#define MAX_PACKET_POOL 1024
+
+AVPacketList *ff_packet_list_get_node(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    AVPacketList *pktl = internal->packet_pool;
+
+    if (!pktl)
+        return av_mallocz(sizeof(AVPacketList));
+
+    internal->packet_pool = pktl->next;
+    internal->nb_packet_pool--;
+    memset(pktl, 0, sizeof(*pktl));
+    return pktl;
+}
+
+void ff_packet_list_put_node(AVFormatContext *s, AVPacketList *pktl)
+{
+    AVFormatInternal *internal = s->internal;
+
+    if (internal->nb_packet_pool >= MAX_PACKET_POOL) {
+        av_free(pktl);
+        return;
+    }
+    pktl->next            = internal->packet_pool;
+    internal->packet_pool = pktl;
+    internal->nb_packet_pool++;
+}
+
+static AVPacket *add_to_pktbuf(AVFormatContext *s,
+                               AVPacketList **packet_buffer, AVPacket *pkt,
                                AVPacketList **plast_pktl)
 {
-    AVPacketList *pktl = av_mallocz(sizeof(AVPacketList));
+    AVPacketList *pktl = ff_packet_list_get_node(s);
     if (!pktl)
         return NULL;
 
@@ -396,7 +429,7 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
             if (!copy.buf)
                 return AVERROR(ENOMEM);
 
-            add_to_pktbuf(&s->internal->raw_packet_buffer, &copy,
+            add_to_pktbuf(s, &s->internal->raw_packet_buffer, &copy,
                           &s->internal->raw_packet_buffer_end);
         }
     return 0;
@@ -661,7 +694,7 @@ int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
             if (st->request_probe <= 0) {
                 s->internal->raw_packet_buffer                 = pktl->next;
                 s->internal->raw_packet_buffer_remaining_size += pkt->size;
-                av_free(pktl);
+                ff_packet_list_put_node(s, pktl);
                 return 0;
             }
         }
@@ -721,7 +754,7 @@ int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (!pktl && st->request_probe <= 0)
             return ret;
 
-        add_to_pktbuf(&s->internal->raw_packet_buffer, pkt,
+        add_to_pktbuf(s, &s->internal->raw_packet_buffer, pkt,
                       &s->internal->raw_packet_buffer_end);
         s->internal->raw_packet_buffer_remaining_size -= pkt->size;
 
@@ -1175,13 +1208,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 }
 
-static void free_packet_buffer(AVPacketList **pkt_buf, AVPacketList **pkt_buf_end)
+static void free_packet_buffer(AVFormatContext *s,
+                               AVPacketList **pkt_buf, AVPacketList **pkt_buf_end)
 {
     while (*pkt_buf) {
         AVPacketList *pktl = *pkt_buf;
         *pkt_buf = pktl->next;
         av_free_packet(&pktl->pkt);
-        av_freep(&pktl);
+        ff_packet_list_put_node(s, pktl);
     }
     *pkt_buf_end = NULL;
 }
@@ -1273,7 +1307,7 @@ static int parse_packet(AVFormatContext *s, AVPacket *pkt, int stream_index)
         if ((ret = av_dup_packet(&out_pkt)) < 0)
             goto fail;
 
-        if (!add_to_pktbuf(&s->internal->parse_queue, &out_pkt, &s->internal->parse_queue_end)) {
+        if (!add_to_pktbuf(s, &s->internal->parse_queue, &out_pkt, &s->internal->parse_queue_end)) {
             av_free_packet(&out_pkt);
             ret = AVERROR(ENOMEM);
             goto fail;
@@ -1291,7 +1325,8 @@ fail:
     return ret;
 }
 
-static int read_from_packet_buffer(AVPacketList **pkt_buffer,
+static int read_from_packet_buffer(AVFormatContext *s,
+                                   AVPacketList **pkt_buffer,
                                    AVPacketList **pkt_buffer_end,
                                    AVPacket      *pkt)
 {
@@ -1302,7 +1337,7 @@ static int read_from_packet_buffer(AVPacketList **pkt_buffer,
     *pkt_buffer = pktl->next;
     if (!pktl->next)
         *pkt_buffer_end = NULL;
-    av_freep(&pktl);
+    ff_packet_list_put_node(s, pktl);
     return 0;
 }
 
@@ -1404,7 +1439,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (!got_packet && s->internal->parse_queue)
-        ret = read_from_packet_buffer(&s->internal->parse_queue, &s->internal->parse_queue_end, pkt);
+        ret = read_from_packet_buffer(s, &s->internal->parse_queue, &s->internal->parse_queue_end, pkt);
 
     if (ret >= 0) {
         AVStream *st = s->streams[pkt->stream_index];
@@ -1482,7 +1517,7 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
 
     if (!genpts) {
         ret = s->internal->packet_buffer
-              ? read_from_packet_buffer(&s->internal->packet_buffer,
+              ? read_from_packet_buffer(s, &s->internal->packet_buffer,
                                         &s->internal->packet_buffer_end, pkt)
               : read_frame_internal(s, pkt);
         if (ret < 0)
@@ -1530,7 +1565,7 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
             st = s->streams[next_pkt->stream_index];
             if (!(next_pkt->pts == AV_NOPTS_VALUE && st->discard < AVDISCARD_ALL &&
                   next_pkt->dts != AV_NOPTS_VALUE && !eof)) {
-                ret = read_from_packet_buffer(&s->internal->packet_buffer,
+                ret = read_from_packet_buffer(s, &s->internal->packet_buffer,
                                                &s->internal->packet_buffer_end, pkt);
                 goto return_packet;
             }
@@ -1545,7 +1580,7 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
                 return ret;
         }
 
-        if (av_dup_packet(add_to_pktbuf(&s->internal->packet_buffer, pkt,
+        if (av_dup_packet(add_to_pktbuf(s, &s->internal->packet_buffer, pkt,
                                         &s->internal->packet_buffer_end)) < 0)
             return AVERROR(ENOMEM);
     }
@@ -1569,11 +1604,22 @@ return_packet:
 /* XXX: suppress the packet queue */
 static void flush_packet_queue(AVFormatContext *s)
 {
-    if (!s->internal)
+    AVFormatInternal *internal = s->internal;
+    int i;
+
+    if (!internal)
         return;
-    free_packet_buffer(&s->internal->parse_queue,       &s->internal->parse_queue_end);
-    free_packet_buffer(&s->internal->packet_buffer,     &s->internal->packet_buffer_end);
-    free_packet_buffer(&s->internal->raw_packet_buffer, &s->internal->raw_packet_buffer_end);
+    free_packet_buffer(s, &internal->parse_queue,       &internal->parse_queue_end);
+    free_packet_buffer(s, &internal->packet_buffer,     &internal->packet_buffer_end);
+    free_packet_buffer(s, &internal->raw_packet_buffer, &internal->raw_packet_buffer_end);
+
+    for (i = 0; i < internal->nb_interleave_heap; i++) {
+        AVPacketList *last = NULL;
+        int stream_index = internal->interleave_heap[i];
+
+        free_packet_buffer(s, &internal->interleave_queue[stream_index], &last);
+    }
+    internal->nb_interleave_heap = 0;
 
     s->internal->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
 }
@@ -3079,6 +3125,117 @@ void ff_rfps_calculate(AVFormatContext *ic)
     }
 }
 
+static enum AVPixelFormat yuv_pix_fmt(int chroma_format_idc, int bit_depth)
+{
+    static const enum AVPixelFormat pix_fmts[][3] = {
+        { AV_PIX_FMT_YUV420P,   AV_PIX_FMT_YUV422P,   AV_PIX_FMT_YUV444P   },
+        { AV_PIX_FMT_YUV420P9,  AV_PIX_FMT_YUV422P9,  AV_PIX_FMT_YUV444P9  },
+        { AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10 },
+        { AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12 },
+        { AV_PIX_FMT_YUV420P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV444P14 },
+    };
+    int depth = bit_depth == 8 ? 0 : bit_depth == 9 ? 1 : bit_depth / 2 - 3;
+
+    if (bit_depth < 8 || bit_depth > 14 || (bit_depth & 1 && bit_depth != 9) ||
+        chroma_format_idc < 1 || chroma_format_idc > 3)
+        return AV_PIX_FMT_NONE;
+    return pix_fmts[depth][chroma_format_idc - 1];
+}
+
+/**
+ * Set the parameters which the decoder would take from the sequence
+ * parameter set, for AVFMT_FLAG_FAST_INFO.
+ */
+static void set_params_from_extradata(AVStream *st)
+{
+    AVCodecContext *avctx = st->codec;
+    enum AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
+
+    if (!avctx->extradata_size)
+        return;
+
+    if (avctx->codec_id == AV_CODEC_ID_H264) {
+        H264SPS sps;
+
+        if (ff_avc_decode_extradata_sps(&sps, avctx->extradata, avctx->extradata_size) < 0)
+            return;
+        if (sps.video_signal_type_present_flag)
+            avctx->color_range = sps.full_range ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+        if (sps.colour_description_present_flag) {
+            avctx->color_primaries = sps.colour_primaries;
+            avctx->color_trc       = sps.transfer_characteristics;
+            avctx->colorspace      = sps.matrix_coefficients;
+        }
+        avctx->profile = sps.profile_idc;
+        if (sps.profile_idc == FF_PROFILE_H264_BASELINE && sps.constraint_set_flags & 0x40)
+            avctx->profile |= FF_PROFILE_H264_CONSTRAINED;
+        if ((sps.profile_idc == FF_PROFILE_H264_HIGH_10      ||
+             sps.profile_idc == FF_PROFILE_H264_HIGH_422     ||
+             sps.profile_idc == FF_PROFILE_H264_HIGH_444_PREDICTIVE ||
+             sps.profile_idc == FF_PROFILE_H264_CAVLC_444) && sps.constraint_set_flags & 0x10)
+            avctx->profile |= FF_PROFILE_H264_INTRA;
+        avctx->level = sps.level_idc;
+        if (!avctx->width || !avctx->height) {
+            avctx->width  = sps.width;
+            avctx->height = sps.height;
+        }
+        if (!avctx->sample_aspect_ratio.num && sps.sar.num && sps.sar.den)
+            avctx->sample_aspect_ratio = sps.sar;
+
+        /* the formats the H.264 decoder picks without hardware acceleration */
+        pix_fmt = yuv_pix_fmt(sps.chroma_format_idc ? sps.chroma_format_idc : 1,
+                              sps.bit_depth);
+        if (sps.chroma_format_idc == 3 && avctx->colorspace == AVCOL_SPC_RGB) {
+            pix_fmt = sps.bit_depth ==  8 ? AV_PIX_FMT_GBRP   :
+                      sps.bit_depth ==  9 ? AV_PIX_FMT_GBRP9  :
+                      sps.bit_depth == 10 ? AV_PIX_FMT_GBRP10 :
+                      sps.bit_depth == 12 ? AV_PIX_FMT_GBRP12 :
+                      sps.bit_depth == 14 ? AV_PIX_FMT_GBRP14 : AV_PIX_FMT_NONE;
+        } else if (sps.bit_depth == 8 && avctx->color_range == AVCOL_RANGE_JPEG) {
+            pix_fmt = sps.chroma_format_idc == 3 ? AV_PIX_FMT_YUVJ444P :
+                      sps.chroma_format_idc == 2 ? AV_PIX_FMT_YUVJ422P :
+                                                   AV_PIX_FMT_YUVJ420P;
+        }
+    } else if (avctx->codec_id == AV_CODEC_ID_HEVC) {
+        HEVCSPSInfo sps;
+
+        if (ff_hevc_decode_extradata_sps(&sps, avctx->extradata, avctx->extradata_size) < 0)
+            return;
+        avctx->color_range = sps.video_signal_type_present_flag && sps.full_range ?
+                             AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+        if (sps.colour_description_present_flag) {
+            avctx->color_primaries = sps.colour_primaries;
+            avctx->color_trc       = sps.transfer_characteristics;
+            avctx->colorspace      = sps.matrix_coefficients;
+        } else {
+            avctx->color_primaries = AVCOL_PRI_UNSPECIFIED;
+            avctx->color_trc       = AVCOL_TRC_UNSPECIFIED;
+            avctx->colorspace      = AVCOL_SPC_UNSPECIFIED;
+        }
+        avctx->profile = sps.profile_idc;
+        avctx->level   = sps.level_idc;
+        if (!avctx->width || !avctx->height) {
+            avctx->width  = sps.width;
+            avctx->height = sps.height;
+        }
+        if (!avctx->sample_aspect_ratio.num && sps.sar.num && sps.sar.den)
+            avctx->sample_aspect_ratio = sps.sar;
+
+        /* the formats the HEVC decoder picks without hardware acceleration */
+        if (sps.bit_depth == 8 || sps.bit_depth == 9 || sps.bit_depth == 10 || sps.bit_depth == 12) {
+            if (!sps.chroma_format_idc)
+                pix_fmt = sps.bit_depth == 8 ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_GRAY16;
+            else
+                pix_fmt = yuv_pix_fmt(sps.chroma_format_idc, sps.bit_depth);
+            if (pix_fmt == AV_PIX_FMT_YUV420P && avctx->color_range == AVCOL_RANGE_JPEG)
+                pix_fmt = AV_PIX_FMT_YUVJ420P;
+        }
+    }
+
+    if (pix_fmt != AV_PIX_FMT_NONE && avctx->width && avctx->height)
+        avctx->pix_fmt = pix_fmt;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count, ret = 0, j;
@@ -3141,6 +3298,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
         codec = find_decoder(ic, st, st->codec->codec_id);
 
+        if (ic->flags & AVFMT_FLAG_FAST_INFO &&
+            st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+            st->codec->pix_fmt == AV_PIX_FMT_NONE)
+            set_params_from_extradata(st);
+
         /* Force thread count to 1 since the H.264 decoder will not extract
          * SPS and PPS to extradata during multi-threaded decoding. */
         av_dict_set(options ? &options[i] : &thread_opt, "threads", "1", 0);
@@ -3165,6 +3327,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
         if (!options)
             av_dict_free(&thread_opt);
+
+        if (ic->flags & AVFMT_FLAG_FAST_INFO && has_codec_parameters(st, NULL)) {
+            av_log(ic, AV_LOG_DEBUG, "Stream #%d: parameters taken from the headers\n", i);
+            st->info->params_from_header = 1;
+        }
     }
 
     for (i = 0; i < ic->nb_streams; i++) {
@@ -3263,10 +3430,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
-            free_packet_buffer(&ic->internal->packet_buffer,
+            free_packet_buffer(ic, &ic->internal->packet_buffer,
                                &ic->internal->packet_buffer_end);
         {
-            pkt = add_to_pktbuf(&ic->internal->packet_buffer, &pkt1,
+            pkt = add_to_pktbuf(ic, &ic->internal->packet_buffer, &pkt1,
                                 &ic->internal->packet_buffer_end);
             if (!pkt) {
                 ret = AVERROR(ENOMEM);
@@ -3377,8 +3544,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (!st->info->params_from_header)
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3702,8 +3870,17 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_freep(&s->streams);
-    av_freep(&s->internal);
     flush_packet_queue(s);
+    if (s->internal) {
+        while (s->internal->packet_pool) {
+            AVPacketList *pktl = s->internal->packet_pool;
+            s->internal->packet_pool = pktl->next;
+            av_free(pktl);
+        }
+        av_freep(&s->internal->interleave_queue);
+        av_freep(&s->internal->interleave_heap);
+    }
+    av_freep(&s->internal);
     av_free(s);
 }
 
@@ -651,6 +651,12 @@ AVInputFormat ff_wav_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("WAV / WAVE (Waveform Audio)"),
     .priv_data_size = sizeof(WAVDemuxContext),
     .read_probe     = wav_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "RIFF", 4 },
+        { 0, "RIFX", 4 },
+        { 0, "RF64", 4 },
+        { 0 }
+    },
     .read_header    = wav_read_header,
     .read_packet    = wav_read_packet,
     .read_seek      = wav_read_seek,
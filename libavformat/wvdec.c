@@ -314,6 +314,10 @@ AVInputFormat ff_wv_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("WavPack"),
     .priv_data_size = sizeof(WVContext),
     .read_probe     = wv_probe,
+    .signatures     = (const FFProbeSignature[]) {
+        { 0, "wvpk", 4 },
+        { 0 }
+    },
     .read_header    = wv_read_header,
     .read_packet    = wv_read_packet,
     .flags          = AVFMT_GENERIC_INDEX,
@@ -51,6 +51,9 @@
 #define AV_CPU_FLAG_FMA3        0x10000 ///< Haswell FMA3 functions
 #define AV_CPU_FLAG_BMI1        0x20000 ///< Bit Manipulation Instruction Set 1
 #define AV_CPU_FLAG_BMI2        0x40000 ///< Bit Manipulation Instruction Set 2
+#define AV_CPU_FLAG_CLMUL       0x80000 ///< Westmere carry-less multiplication (PCLMULQDQ)
+#define AV_CPU_FLAG_AESNI      0x100000 ///< Westmere AES instructions
+#define AV_CPU_FLAG_SHANI      0x200000 ///< SHA-1 and SHA-256 instructions
 
 #define AV_CPU_FLAG_ALTIVEC      0x0001 ///< standard
 #define AV_CPU_FLAG_VSX          0x0002 ///< ISA 2.06
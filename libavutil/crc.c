@@ -19,9 +19,13 @@
  */
 
 #include "config.h"
+#include "atomic.h"
 #include "common.h"
 #include "bswap.h"
 #include "crc.h"
+#if ARCH_X86
+#include "x86/crc.h"
+#endif
 
 #if CONFIG_HARDCODED_TABLES
 static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
@@ -290,7 +294,11 @@ static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
 #else
 #define CRC_TABLE_SIZE 1024
 #endif
-static struct {
+static AVCRC av_crc_table[AV_CRC_MAX][CRC_TABLE_SIZE];
+#endif
+
+#if !CONFIG_HARDCODED_TABLES || ARCH_X86
+static const struct {
     uint8_t  le;
     uint8_t  bits;
     uint32_t poly;
@@ -303,7 +311,10 @@ static struct {
     [AV_CRC_32_IEEE_LE] = { 1, 32, 0xEDB88320 },
     [AV_CRC_16_ANSI_LE] = { 1, 16,     0xA001 },
 };
-static AVCRC av_crc_table[AV_CRC_MAX][CRC_TABLE_SIZE];
+#endif
+
+#if ARCH_X86
+static CRCFoldContext crc_fold[AV_CRC_MAX];
 #endif
 
 int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
@@ -349,12 +360,24 @@ const AVCRC *av_crc_get_table(AVCRCId crc_id)
                         av_crc_table_params[crc_id].poly,
                         sizeof(av_crc_table[crc_id])) < 0)
             return NULL;
+#endif
+#if ARCH_X86
+    /* the ids without parameters are unused; init is published after the
+     * constants, other threads may be calling av_crc() meanwhile */
+    if (av_crc_table_params[crc_id].bits &&
+        !avpriv_atomic_int_get(&crc_fold[crc_id].init)) {
+        ff_crc_fold_init_x86(&crc_fold[crc_id],
+                             av_crc_table_params[crc_id].le,
+                             av_crc_table_params[crc_id].bits,
+                             av_crc_table_params[crc_id].poly);
+        avpriv_atomic_int_set(&crc_fold[crc_id].init, 1);
+    }
 #endif
     return av_crc_table[crc_id];
 }
 
-uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
-                const uint8_t *buffer, size_t length)
+static uint32_t crc_table(const AVCRC *ctx, uint32_t crc,
+                          const uint8_t *buffer, size_t length)
 {
     const uint8_t *end = buffer + length;
 
@@ -378,6 +401,29 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
     return crc;
 }
 
+uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
+                const uint8_t *buffer, size_t length)
+{
+#if ARCH_X86
+    /* only the tables from av_crc_get_table() have folding constants */
+    uintptr_t offset = (uintptr_t)ctx - (uintptr_t)av_crc_table;
+
+    if (length >= CRC_FOLD_MIN_SIZE && offset < sizeof(av_crc_table) &&
+        !(offset % sizeof(av_crc_table[0]))) {
+        CRCFoldContext *fold = &crc_fold[offset / sizeof(av_crc_table[0])];
+        uint8_t rem[16];
+        size_t done;
+
+        if (avpriv_atomic_int_get(&fold->init) && (done = ff_crc_fold_x86(fold, rem, crc, buffer, length))) {
+            crc     = crc_table(ctx, 0, rem, sizeof(rem));
+            buffer += done;
+            length -= done;
+        }
+    }
+#endif
+    return crc_table(ctx, crc, buffer, length);
+}
+
 #ifdef TEST
 int main(void)
 {
@@ -26,9 +26,18 @@
 #include "mem.h"
 #include "bprint.h"
 
+/* number of entries from which exact lookups go through a hash index */
+#define HASH_THRESHOLD 16
+
 struct AVDictionary {
     int count;
+    int size;                   ///< allocated number of elems
     AVDictionaryEntry *elems;
+    /* open addressing table of elems indices plus one, 0 for an empty slot,
+     * keyed by the case-insensitive hash of the key, NULL below
+     * HASH_THRESHOLD entries */
+    int *hash;
+    unsigned hash_size;         ///< number of slots, a power of 2
 };
 
 int av_dict_count(const AVDictionary *m)
@@ -36,6 +45,88 @@ int av_dict_count(const AVDictionary *m)
     return m ? m->count : 0;
 }
 
+static unsigned hash_key(const char *key)
+{
+    unsigned h = 2166136261U;
+
+    for (; *key; key++)
+        h = (h ^ av_toupper(*key)) * 16777619U;
+    return h;
+}
+
+static void hash_insert(AVDictionary *m, int index)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned i    = hash_key(m->elems[index].key) & mask;
+
+    while (m->hash[i])
+        i = (i + 1) & mask;
+    m->hash[i] = index + 1;
+}
+
+static unsigned hash_find_slot(const AVDictionary *m, int index)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned i    = hash_key(m->elems[index].key) & mask;
+
+    while (m->hash[i] != index + 1)
+        i = (i + 1) & mask;
+    return i;
+}
+
+/* remove a slot, moving back the following entries that would otherwise
+ * no longer be reachable from their home slot */
+static void hash_remove_slot(AVDictionary *m, unsigned i)
+{
+    unsigned mask = m->hash_size - 1, j = i, home;
+
+    while (1) {
+        j = (j + 1) & mask;
+        if (!m->hash[j])
+            break;
+        home = hash_key(m->elems[m->hash[j] - 1].key) & mask;
+        if (i <= j ? i < home && home <= j : i < home || home <= j)
+            continue;
+        m->hash[i] = m->hash[j];
+        i = j;
+    }
+    m->hash[i] = 0;
+}
+
+static int hash_resize(AVDictionary *m, unsigned size)
+{
+    int i, *hash = av_calloc(size, sizeof(*hash));
+
+    if (!hash)
+        return AVERROR(ENOMEM);
+    av_free(m->hash);
+    m->hash      = hash;
+    m->hash_size = size;
+    for (i = 0; i < m->count; i++)
+        hash_insert(m, i);
+    return 0;
+}
+
+static AVDictionaryEntry *hash_get(const AVDictionary *m, const char *key,
+                                   int flags)
+{
+    unsigned mask = m->hash_size - 1;
+    unsigned i    = hash_key(key) & mask;
+    AVDictionaryEntry *found = NULL;
+
+    /* keys differing only by case share a chain, the first entry in
+     * iteration order wins as with the linear scan */
+    for (; m->hash[i]; i = (i + 1) & mask) {
+        AVDictionaryEntry *e = &m->elems[m->hash[i] - 1];
+        if (found && e > found)
+            continue;
+        if (flags & AV_DICT_MATCH_CASE ? strcmp(e->key, key) : av_strcasecmp(e->key, key))
+            continue;
+        found = e;
+    }
+    return found;
+}
+
 AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
                                const AVDictionaryEntry *prev, int flags)
 {
@@ -44,6 +135,9 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     if (!m)
         return NULL;
 
+    if (m->hash && !prev && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return hash_get(m, key, flags);
+
     if (prev)
         i = prev - m->elems + 1;
     else
@@ -92,18 +186,25 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_free(copy_value);
             return 0;
         }
+        if (m->hash) {
+            int index = tag - m->elems;
+            hash_remove_slot(m, hash_find_slot(m, index));
+            if (index != m->count - 1)
+                m->hash[hash_find_slot(m, m->count - 1)] = index + 1;
+        }
         if (flags & AV_DICT_APPEND)
             oldval = tag->value;
         else
             av_free(tag->value);
         av_free(tag->key);
         *tag = m->elems[--m->count];
-    } else {
-        AVDictionaryEntry *tmp = av_realloc(m->elems,
-                                            (m->count + 1) * sizeof(*m->elems));
+    } else if (m->count == m->size) {
+        int size = FFMAX(2 * m->size, 4);
+        AVDictionaryEntry *tmp = av_realloc_array(m->elems, size, sizeof(*m->elems));
         if (!tmp)
             goto err_out;
         m->elems = tmp;
+        m->size  = size;
     }
     if (copy_value) {
         m->elems[m->count].key = copy_key;
@@ -120,11 +221,17 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_freep(&copy_value);
         }
         m->count++;
+        if (m->hash && 2 * m->count <= m->hash_size)
+            hash_insert(m, m->count - 1);
+        else if (m->count >= HASH_THRESHOLD &&
+                 hash_resize(m, FFMAX(4 * m->hash_size, 64)) < 0)
+            av_freep(&m->hash);
     } else {
         av_freep(&copy_key);
     }
     if (!m->count) {
         av_freep(&m->elems);
+        av_freep(&m->hash);
         av_freep(pm);
     }
 
@@ -133,6 +240,7 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 err_out:
     if (m && !m->count) {
         av_freep(&m->elems);
+        av_freep(&m->hash);
         av_freep(pm);
     }
     av_free(copy_key);
@@ -206,6 +314,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].value);
         }
         av_freep(&m->elems);
+        av_freep(&m->hash);
     }
     av_freep(pm);
 }
@@ -283,6 +392,8 @@ int main(void)
     AVDictionary *dict = NULL;
     AVDictionaryEntry *e;
     char *buffer = NULL;
+    char key[16];
+    int i;
 
     printf("Testing av_dict_get_string() and av_dict_parse_string()\n");
     av_dict_get_string(dict, &buffer, '=', ',');
@@ -361,6 +472,32 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting av_dict_set() and av_dict_get() with many entries\n");
+    for (i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "k%d", i * 37 % 100);
+        av_dict_set_int(&dict, key, i, 0);
+    }
+    for (i = 0; i < 100; i += 3) {
+        snprintf(key, sizeof(key), "K%d", i);
+        av_dict_set_int(&dict, key, -i, i & 1 ? AV_DICT_MATCH_CASE : 0);
+    }
+    for (i = 1; i < 100; i += 5) {
+        snprintf(key, sizeof(key), "k%d", i);
+        av_dict_set(&dict, key, NULL, i & 1 ? AV_DICT_MATCH_CASE : 0);
+    }
+    av_dict_set(&dict, "k7", "7", AV_DICT_APPEND);
+    av_dict_set(&dict, "k8", "8", AV_DICT_DONT_OVERWRITE);
+    printf("%d entries\n", av_dict_count(dict));
+    print_dict(dict);
+    for (i = 0; i < 100; i += 7) {
+        AVDictionaryEntry *e2;
+        snprintf(key, sizeof(key), "K%d", i);
+        e  = av_dict_get(dict, key, NULL, 0);
+        e2 = av_dict_get(dict, key, NULL, AV_DICT_MATCH_CASE);
+        printf("%s: %s %s\n", key, e ? e->value : "-", e2 ? e2->value : "-");
+    }
+    av_dict_free(&dict);
+
     return 0;
 }
 #endif
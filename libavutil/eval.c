@@ -152,6 +152,7 @@ struct AVExpr {
         e_if, e_ifnot, e_print, e_bitand, e_bitor, e_between, e_clip
     } type;
     double value; // is sign in other types
+    int func_index; ///< index in funcs1 or funcs2, for e_func1 and e_func2
     union {
         int const_index;
         double (*func0)(double);
@@ -160,8 +161,40 @@ struct AVExpr {
     } a;
     struct AVExpr *param[3];
     double *var;
+    struct ExprProgram *prog;
+    double *lane_values;
+    int nb_consts;
 };
 
+/* Compiled form of an expression.
+ * Pure expressions are flattened into a list of instructions working on
+ * registers of up to EXPR_LANES values each, so that a whole batch of
+ * evaluations is done with one pass over the program. Instructions reuse
+ * the AVExpr types as opcodes and compute exactly what eval_expr() does
+ * for the corresponding node, except that all the operands are evaluated. */
+#define EXPR_LANES    32
+#define EXPR_MAX_REGS 16
+
+typedef struct ExprInsn {
+    int type;
+    int dst;
+    int src[3];
+    double value;
+    union {
+        int const_index;
+        double (*func0)(double);
+        double (*func1)(void *, double);
+        double (*func2)(void *, double, double);
+    } a;
+} ExprInsn;
+
+typedef struct ExprProgram {
+    ExprInsn *insns;
+    int nb_insns;
+    int nb_regs;
+    int scalar;     ///< av_expr_eval() may run the program instead of the tree
+} ExprProgram;
+
 static double etime(double v)
 {
     return av_gettime() * 0.000001;
@@ -317,6 +350,10 @@ void av_expr_free(AVExpr *e)
     av_expr_free(e->param[1]);
     av_expr_free(e->param[2]);
     av_freep(&e->var);
+    if (e->prog)
+        av_freep(&e->prog->insns);
+    av_freep(&e->prog);
+    av_freep(&e->lane_values);
     av_freep(&e);
 }
 
@@ -450,6 +487,7 @@ static int parse_primary(AVExpr **e, Parser *p)
         for (i=0; p->func1_names && p->func1_names[i]; i++) {
             if (strmatch(next, p->func1_names[i])) {
                 d->a.func1 = p->funcs1[i];
+                d->func_index = i;
                 d->type = e_func1;
                 *e = d;
                 return 0;
@@ -459,6 +497,7 @@ static int parse_primary(AVExpr **e, Parser *p)
         for (i=0; p->func2_names && p->func2_names[i]; i++) {
             if (strmatch(next, p->func2_names[i])) {
                 d->a.func2 = p->funcs2[i];
+                d->func_index = i;
                 d->type = e_func2;
                 *e = d;
                 return 0;
@@ -650,6 +689,206 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+typedef struct Compiler {
+    ExprProgram *prog;
+    int insns_size;
+    int cond_depth;     ///< nesting of operands which eval_expr() may skip
+} Compiler;
+
+static int is_compilable(const AVExpr *e)
+{
+    switch (e->type) {
+    case e_ld:
+    case e_st:
+    case e_random:
+    case e_while:
+    case e_taylor:
+    case e_root:
+    case e_print:
+        return 0;
+    case e_func0:
+        return e->a.func0 != etime;
+    default:
+        return 1;
+    }
+}
+
+/* whether the node always evaluates to the same value */
+static int is_constant(const AVExpr *e)
+{
+    int i;
+
+    if (e->type == e_value)
+        return 1;
+    if (e->type == e_const || e->type == e_func1 || e->type == e_func2 ||
+        !is_compilable(e))
+        return 0;
+    for (i = 0; i < 3; i++)
+        if (e->param[i] && !is_constant(e->param[i]))
+            return 0;
+    return 1;
+}
+
+static int emit(Compiler *c, int type, int dst, int src0, int src1, int src2,
+                double value)
+{
+    ExprProgram *prog = c->prog;
+    ExprInsn *insn;
+
+    if (dst >= EXPR_MAX_REGS)
+        return AVERROR(ENOSPC);
+    if (prog->nb_insns >= c->insns_size) {
+        int ret = av_reallocp_array(&prog->insns, 2 * c->insns_size + 8, sizeof(*prog->insns));
+        if (ret < 0)
+            return ret;
+        c->insns_size = 2 * c->insns_size + 8;
+    }
+    insn = &prog->insns[prog->nb_insns++];
+    insn->type   = type;
+    insn->dst    = dst;
+    insn->src[0] = src0;
+    insn->src[1] = src1;
+    insn->src[2] = src2;
+    insn->value  = value;
+    prog->nb_regs = FFMAX(prog->nb_regs, dst + 1);
+    return 0;
+}
+
+/* Compile e so that its value ends up in register dst; the operands use
+ * the registers above it. */
+static int compile_expr(Compiler *c, AVExpr *e, int dst)
+{
+    int i, ret, nb_params = 0;
+
+    if (!is_compilable(e))
+        return AVERROR(ENOSYS);
+
+    if (e->type != e_value && is_constant(e)) {
+        Parser p = { 0 };
+        return emit(c, e_value, dst, 0, 0, 0, eval_expr(&p, e));
+    }
+
+    for (i = 0; i < 3; i++) {
+        /* the left side of ';' only matters for its side effects */
+        if (e->type == e_last && i == 0 && is_constant(e->param[0]))
+            continue;
+        if (e->param[i]) {
+            int cond = ((e->type == e_if || e->type == e_ifnot) && i > 0) ||
+                       (e->type == e_between && i == 2);
+            c->cond_depth += cond;
+            ret = compile_expr(c, e->param[i], dst + i);
+            c->cond_depth -= cond;
+            if (ret < 0)
+                return ret;
+            nb_params = i + 1;
+        }
+    }
+    /* a missing else branch evaluates to 0 */
+    if ((e->type == e_if || e->type == e_ifnot) && !e->param[2]) {
+        if ((ret = emit(c, e_value, dst + 2, 0, 0, 0, 0)) < 0)
+            return ret;
+        nb_params = 3;
+    }
+
+    if ((e->type == e_func1 || e->type == e_func2) && c->cond_depth)
+        c->prog->scalar = 0;
+
+    ret = emit(c, e->type, dst, dst, dst + 1, dst + 2, e->value);
+    if (ret < 0)
+        return ret;
+    memcpy(&c->prog->insns[c->prog->nb_insns - 1].a, &e->a, sizeof(e->a));
+    return nb_params;
+}
+
+static int compile_program(AVExpr *e)
+{
+    Compiler c = { 0 };
+    int ret;
+
+    c.prog = av_mallocz(sizeof(*c.prog));
+    if (!c.prog)
+        return AVERROR(ENOMEM);
+    c.prog->scalar = 1;
+
+    ret = compile_expr(&c, e, 0);
+    if (ret < 0) {
+        av_freep(&c.prog->insns);
+        av_freep(&c.prog);
+        /* expressions with state are still evaluated by walking the tree */
+        return ret == AVERROR(ENOMEM) ? ret : 0;
+    }
+    e->prog = c.prog;
+    return 0;
+}
+
+#define LANES(expr) for (i = 0; i < n; i++) d[i] = (expr)
+
+/* Run the program over n <= EXPR_LANES lanes, starting at lane offset. */
+static void run_program(const ExprProgram *prog, double *regs, int n, int offset,
+                        const double *const_values,
+                        const double * const *const_arrays, void *opaque)
+{
+    const ExprInsn *insn = prog->insns, *end = insn + prog->nb_insns;
+    int i;
+
+    for (; insn < end; insn++) {
+        double *d = regs + insn->dst * n;
+        const double *a = regs + insn->src[0] * n;
+        const double *b = regs + insn->src[1] * n;
+        const double *c = regs + insn->src[2] * n;
+        const double v = insn->value;
+
+        switch (insn->type) {
+        case e_value: LANES(v); break;
+        case e_const:
+            if (const_arrays && const_arrays[insn->a.const_index]) {
+                const double *src = const_arrays[insn->a.const_index] + offset;
+                LANES(v * src[i]);
+            } else {
+                const double k = v * const_values[insn->a.const_index];
+                LANES(k);
+            }
+            break;
+        case e_func0: LANES(v * insn->a.func0(a[i])); break;
+        case e_func1: LANES(v * insn->a.func1(opaque, a[i])); break;
+        case e_func2: LANES(v * insn->a.func2(opaque, a[i], b[i])); break;
+        case e_squish: LANES(1/(1+exp(4*a[i]))); break;
+        case e_gauss:  LANES(exp(-a[i]*a[i]/2)/sqrt(2*M_PI)); break;
+        case e_isnan:  LANES(v * !!isnan(a[i])); break;
+        case e_isinf:  LANES(v * !!isinf(a[i])); break;
+        case e_floor:  LANES(v * floor(a[i])); break;
+        case e_ceil:   LANES(v * ceil (a[i])); break;
+        case e_trunc:  LANES(v * trunc(a[i])); break;
+        case e_sqrt:   LANES(v * sqrt (a[i])); break;
+        case e_not:    LANES(v * (a[i] == 0)); break;
+        case e_if:     LANES(v * ( a[i] ? b[i] : c[i])); break;
+        case e_ifnot:  LANES(v * (!a[i] ? b[i] : c[i])); break;
+        case e_clip:
+            LANES(isnan(b[i]) || isnan(c[i]) || isnan(a[i]) || b[i] > c[i] ? NAN :
+                  v * av_clipd(a[i], b[i], c[i]));
+            break;
+        case e_between: LANES(v * (a[i] >= b[i] && a[i] <= c[i])); break;
+        case e_mod: LANES(v * (a[i] - floor((!CONFIG_FTRAPV || b[i]) ? a[i] / b[i] : a[i] * INFINITY) * b[i])); break;
+        case e_gcd: LANES(v * av_gcd(a[i], b[i])); break;
+        case e_max: LANES(v * (a[i] >  b[i] ? a[i] : b[i])); break;
+        case e_min: LANES(v * (a[i] <  b[i] ? a[i] : b[i])); break;
+        case e_eq:  LANES(v * (a[i] == b[i] ? 1.0 : 0.0)); break;
+        case e_gt:  LANES(v * (a[i] >  b[i] ? 1.0 : 0.0)); break;
+        case e_gte: LANES(v * (a[i] >= b[i] ? 1.0 : 0.0)); break;
+        case e_lt:  LANES(v * (a[i] <  b[i] ? 1.0 : 0.0)); break;
+        case e_lte: LANES(v * (a[i] <= b[i] ? 1.0 : 0.0)); break;
+        case e_pow: LANES(v * pow(a[i], b[i])); break;
+        case e_mul: LANES(v * (a[i] * b[i])); break;
+        case e_div: LANES(v * ((!CONFIG_FTRAPV || b[i]) ? (a[i] / b[i]) : a[i] * INFINITY)); break;
+        case e_add: LANES(v * (a[i] + b[i])); break;
+        case e_last: LANES(v * b[i]); break;
+        case e_hypot: LANES(v * sqrt(a[i]*a[i] + b[i]*b[i])); break;
+        case e_bitand: LANES(isnan(a[i]) || isnan(b[i]) ? NAN : v * ((long int)a[i] & (long int)b[i])); break;
+        case e_bitor:  LANES(isnan(a[i]) || isnan(b[i]) ? NAN : v * ((long int)a[i] | (long int)b[i])); break;
+        }
+    }
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -697,6 +936,17 @@ int av_expr_parse(AVExpr **expr, const char *s,
         ret = AVERROR(ENOMEM);
         goto end;
     }
+    while (const_names && const_names[e->nb_consts])
+        e->nb_consts++;
+    if ((ret = compile_program(e)) < 0)
+        goto end;
+    if (!e->prog && e->nb_consts) {
+        e->lane_values = av_malloc_array(e->nb_consts, sizeof(*e->lane_values));
+        if (!e->lane_values) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
     *expr = e;
     e = NULL;
 end:
@@ -705,9 +955,34 @@ end:
     return ret;
 }
 
+static void count_func(const AVExpr *e, unsigned *counter, int size, int type)
+{
+    int i;
+
+    for (i = 0; i < 3 && e->param[i]; i++)
+        count_func(e->param[i], counter, size, type);
+    if (e->type == type && e->func_index < size)
+        counter[e->func_index]++;
+}
+
+int av_expr_count_func(AVExpr *e, unsigned *counter, int size, int arg)
+{
+    if (!e || !counter || size <= 0 || arg < 1 || arg > 2)
+        return AVERROR(EINVAL);
+    count_func(e, counter, size, arg == 1 ? e_func1 : e_func2);
+    return 0;
+}
+
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
 {
     Parser p = { 0 };
+
+    if (e->prog && e->prog->scalar) {
+        double regs[EXPR_MAX_REGS];
+        run_program(e->prog, regs, 1, 0, const_values, NULL, opaque);
+        return regs[0];
+    }
+
     p.var= e->var;
 
     p.const_values = const_values;
@@ -715,6 +990,31 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
     return eval_expr(&p, e);
 }
 
+void av_expr_eval_batch(AVExpr *e, double *res, int nb,
+                        const double *const_values,
+                        const double * const *const_arrays, void *opaque)
+{
+    int i, j;
+
+    if (e->prog) {
+        double regs[EXPR_MAX_REGS * EXPR_LANES];
+        for (i = 0; i < nb; i += EXPR_LANES) {
+            int n = FFMIN(nb - i, EXPR_LANES);
+            run_program(e->prog, regs, n, i, const_values, const_arrays, opaque);
+            memcpy(res + i, regs, n * sizeof(*res));
+        }
+        return;
+    }
+
+    /* stateful expressions are evaluated one lane after the other */
+    for (i = 0; i < nb; i++) {
+        for (j = 0; j < e->nb_consts; j++)
+            e->lane_values[j] = const_arrays && const_arrays[j] ?
+                                const_arrays[j][i] : const_values[j];
+        res[i] = av_expr_eval(e, e->lane_values, opaque);
+    }
+}
+
 int av_expr_parse_and_eval(double *d, const char *s,
                            const char * const *const_names, const double *const_values,
                            const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -851,6 +1151,21 @@ int main(int argc, char **argv)
         "clip(0, 0/0, 1)",
         NULL
     };
+    static const char *const batch_exprs[] = {
+        "PI*2+E",
+        "-PI-(-E)",
+        "if(gt(PI,0), sqrt(PI), -PI)",
+        "ifnot(lt(PI,0), PI^2)",
+        "clip(PI, -1, 1)+clip(1, PI, 2)",
+        "between(PI, -0.5, 0.5)*E",
+        "mod(PI*7, 3) + floor(PI) - ceil(-PI) + trunc(PI)",
+        "max(PI, E); min(PI, 1/PI)",
+        "hypot(PI, E) + squish(PI) + gauss(PI) - sin(PI*2)",
+        "bitand(PI*100, 255) + bitor(3, 4) + isnan(PI/0) + isinf(1/PI) + not(PI)",
+        "eq(PI, 0) + gte(PI, 1) + lte(PI, 1) + 2^(3+1)",
+        "st(0, PI); ld(0)*2",
+        NULL
+    };
 
     for (expr = exprs; *expr; expr++) {
         printf("Evaluating '%s'\n", *expr);
@@ -863,6 +1178,48 @@ int main(int argc, char **argv)
             printf("'%s' -> %f\n\n", *expr, d);
     }
 
+    for (expr = batch_exprs; *expr; expr++) {
+        AVExpr *e, *e_tree;
+        double pi[37], res[37];
+        const double *const_arrays[] = { pi, NULL };
+        int mismatches = 0;
+
+        for (i = 0; i < FF_ARRAY_ELEMS(pi); i++)
+            pi[i] = (i - 18) * 0.37;
+        if (av_expr_parse(&e,      *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0 ||
+            av_expr_parse(&e_tree, *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0)
+            return 1;
+        av_expr_eval_batch(e, res, FF_ARRAY_ELEMS(res), const_values, const_arrays, NULL);
+        for (i = 0; i < FF_ARRAY_ELEMS(pi); i++) {
+            Parser p = { 0 };
+            double values[] = { pi[i], M_E, 0 };
+            p.var          = e_tree->var;
+            p.const_values = values;
+            d = eval_expr(&p, e_tree);
+            mismatches += !(d == res[i] || isnan(d) && isnan(res[i]));
+        }
+        printf("Batch evaluating '%s' -> %d mismatches\n", *expr, mismatches);
+        av_expr_free(e);
+        av_expr_free(e_tree);
+    }
+
+    {
+        static const char *const func1_names[] = { "f", "g", NULL };
+        static const char *const func2_names[] = { "h", NULL };
+        static double (* const funcs1[])(void *, double) = { NULL, NULL, NULL };
+        static double (* const funcs2[])(void *, double, double) = { NULL, NULL };
+        unsigned count1[2] = { 0 }, count2[1] = { 0 };
+        AVExpr *e;
+
+        if (av_expr_parse(&e, "f(1) + g(f(2)) * h(f(PI), 4) + sin(E)", const_names,
+                          func1_names, funcs1, func2_names, funcs2, 0, NULL) < 0)
+            return 1;
+        av_expr_count_func(e, count1, FF_ARRAY_ELEMS(count1), 1);
+        av_expr_count_func(e, count2, FF_ARRAY_ELEMS(count2), 2);
+        printf("Function calls: f %u, g %u, h %u\n", count1[0], count1[1], count2[0]);
+        av_expr_free(e);
+    }
+
     av_expr_parse_and_eval(&d, "1+(5-2)^(3-1)+1/2+sin(PI)-max(-2.2,-3.1)",
                            const_names, const_values,
                            NULL, NULL, NULL, NULL, NULL, 0, NULL);
@@ -86,6 +86,46 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Evaluate a previously parsed expression for several sets of constant
+ * values at once.
+ *
+ * This is considerably faster than calling av_expr_eval() for each set,
+ * as long as the expression does not use st(), ld(), random(), while(),
+ * taylor(), root(), print() or time(); such expressions are evaluated
+ * one set after the other.
+ * The functions passed to av_expr_parse() may be called for every set,
+ * also where the result is then discarded by if() or ifnot(), and should
+ * only depend on their arguments.
+ *
+ * @param res an array where the nb results are put
+ * @param nb the number of evaluations
+ * @param const_values a zero terminated array of values for the identifiers
+ *                     from av_expr_parse() const_names, used for the
+ *                     constants without an array in const_arrays
+ * @param const_arrays an array of pointers, one per identifier from
+ *                     av_expr_parse() const_names, each either NULL or
+ *                     pointing to nb values of the constant, may be NULL
+ * @param opaque a pointer which will be passed to all functions from funcs1 and funcs2
+ */
+void av_expr_eval_batch(AVExpr *e, double *res, int nb,
+                        const double *const_values,
+                        const double * const *const_arrays, void *opaque);
+
+/**
+ * Count the calls to the functions passed to av_expr_parse() in a parsed
+ * expression.
+ *
+ * @param counter a zero-initialized array, counter[i] is incremented for
+ *                each call to the function with index i in funcs1 or funcs2
+ * @param size the number of entries in counter, calls to the functions
+ *             with a larger index are not counted
+ * @param arg the number of arguments of the functions to count, 1 for
+ *            funcs1 and 2 for funcs2
+ * @return 0 on success, AVERROR(EINVAL) on invalid arguments
+ */
+int av_expr_count_func(AVExpr *e, unsigned *counter, int size, int arg);
+
 /**
  * Free a parsed expression previously created with av_expr_parse().
  */
@@ -21,6 +21,7 @@
 
 #include "config.h"
 #include "attributes.h"
+#include "common.h"
 #include "float_dsp.h"
 #include "mem.h"
 
@@ -116,6 +117,50 @@ float avpriv_scalarproduct_float_c(const float *v1, const float *v2, int len)
     return p;
 }
 
+static void vector_dmac_scalar_c(double *dst, const double *src, double mul,
+                                 int len)
+{
+    int i;
+    for (i = 0; i < len; i++)
+        dst[i] += src[i] * mul;
+}
+
+static double scalarproduct_double_c(const double *v1, const double *v2,
+                                     int len)
+{
+    double p = 0.0;
+    int i;
+
+    for (i = 0; i < len; i++)
+        p += v1[i] * v2[i];
+
+    return p;
+}
+
+static void vector_clipf_c(float *dst, const float *src, int len,
+                           float min, float max)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = av_clipf(src[i], min, max);
+}
+
+static void vector_dminmax_c(const double *src, int len,
+                             double *min, double *max)
+{
+    double mn = src[0], mx = src[0];
+    int i;
+
+    for (i = 1; i < len; i++) {
+        mn = FFMIN(mn, src[i]);
+        mx = FFMAX(mx, src[i]);
+    }
+
+    *min = mn;
+    *max = mx;
+}
+
 av_cold AVFloatDSPContext *avpriv_float_dsp_alloc(int bit_exact)
 {
     AVFloatDSPContext *fdsp = av_mallocz(sizeof(AVFloatDSPContext));
@@ -131,6 +176,10 @@ av_cold AVFloatDSPContext *avpriv_float_dsp_alloc(int bit_exact)
     fdsp->vector_fmul_reverse = vector_fmul_reverse_c;
     fdsp->butterflies_float = butterflies_float_c;
     fdsp->scalarproduct_float = avpriv_scalarproduct_float_c;
+    fdsp->vector_dmac_scalar = vector_dmac_scalar_c;
+    fdsp->scalarproduct_double = scalarproduct_double_c;
+    fdsp->vector_clipf = vector_clipf_c;
+    fdsp->vector_dminmax = vector_dminmax_c;
 
     if (ARCH_AARCH64)
         ff_float_dsp_init_aarch64(fdsp);
@@ -379,6 +428,74 @@ static int test_scalarproduct_float(AVFloatDSPContext *fdsp, AVFloatDSPContext *
     return ret;
 }
 
+#define ARBITRARY_DMAC_SCALAR_CONST 0.005
+static int test_vector_dmac_scalar(AVFloatDSPContext *fdsp, AVFloatDSPContext *cdsp,
+                                   const double *v1, const double *src0, double scale)
+{
+    LOCAL_ALIGNED(32, double, cdst, [LEN]);
+    LOCAL_ALIGNED(32, double, odst, [LEN]);
+    int ret;
+
+    memcpy(cdst, v1, LEN * sizeof(*v1));
+    memcpy(odst, v1, LEN * sizeof(*v1));
+
+    cdsp->vector_dmac_scalar(cdst, src0, scale, LEN);
+    fdsp->vector_dmac_scalar(odst, src0, scale, LEN);
+
+    if (ret = compare_doubles(cdst, odst, LEN, ARBITRARY_DMAC_SCALAR_CONST))
+        av_log(NULL, AV_LOG_ERROR, "vector_dmac_scalar failed\n");
+
+    return ret;
+}
+
+#define ARBITRARY_SCALARPRODUCT_DOUBLE_CONST 0.01
+static int test_scalarproduct_double(AVFloatDSPContext *fdsp, AVFloatDSPContext *cdsp,
+                                     const double *v1, const double *v2)
+{
+    double cprod, oprod;
+    int ret;
+
+    cprod = cdsp->scalarproduct_double(v1, v2, LEN);
+    oprod = fdsp->scalarproduct_double(v1, v2, LEN);
+
+    if (ret = compare_doubles(&cprod, &oprod, 1, ARBITRARY_SCALARPRODUCT_DOUBLE_CONST))
+        av_log(NULL, AV_LOG_ERROR, "scalarproduct_double failed\n");
+
+    return ret;
+}
+
+static int test_vector_clipf(AVFloatDSPContext *fdsp, AVFloatDSPContext *cdsp,
+                             const float *v1, float min, float max)
+{
+    LOCAL_ALIGNED(32, float, cdst, [LEN]);
+    LOCAL_ALIGNED(32, float, odst, [LEN]);
+    int ret;
+
+    cdsp->vector_clipf(cdst, v1, LEN, FFMIN(min, max), FFMAX(min, max));
+    fdsp->vector_clipf(odst, v1, LEN, FFMIN(min, max), FFMAX(min, max));
+
+    if (ret = compare_floats(cdst, odst, LEN, 0))
+        av_log(NULL, AV_LOG_ERROR, "vector_clipf failed\n");
+
+    return ret;
+}
+
+static int test_vector_dminmax(AVFloatDSPContext *fdsp, AVFloatDSPContext *cdsp,
+                               const double *v1)
+{
+    double cmin, cmax, omin, omax;
+    int ret;
+
+    cdsp->vector_dminmax(v1, LEN, &cmin, &cmax);
+    fdsp->vector_dminmax(v1, LEN, &omin, &omax);
+
+    if ((ret = compare_doubles(&cmin, &omin, 1, 0)) ||
+        (ret = compare_doubles(&cmax, &omax, 1, 0)))
+        av_log(NULL, AV_LOG_ERROR, "vector_dminmax failed\n");
+
+    return ret;
+}
+
 int main(int argc, char **argv)
 {
     int ret = 0, seeded = 0;
@@ -391,6 +508,7 @@ int main(int argc, char **argv)
     LOCAL_ALIGNED(32, float, src2, [LEN]);
     LOCAL_ALIGNED(32, double, dbl_src0, [LEN]);
     LOCAL_ALIGNED(32, double, dbl_src1, [LEN]);
+    LOCAL_ALIGNED(32, double, dbl_src2, [LEN]);
 
     for (;;) {
         int arg = getopt(argc, argv, "s:c:");
@@ -435,6 +553,7 @@ int main(int argc, char **argv)
 
     fill_double_array(&lfg, dbl_src0, LEN);
     fill_double_array(&lfg, dbl_src1, LEN);
+    fill_double_array(&lfg, dbl_src2, LEN);
 
     if (test_vector_fmul(fdsp, cdsp, src0, src1))
         ret -= 1 << 0;
@@ -454,6 +573,14 @@ int main(int argc, char **argv)
         ret -= 1 << 7;
     if (test_vector_dmul_scalar(fdsp, cdsp, dbl_src0, dbl_src1[0]))
         ret -= 1 << 8;
+    if (test_vector_dmac_scalar(fdsp, cdsp, dbl_src2, dbl_src0, dbl_src1[0]))
+        ret -= 1 << 9;
+    if (test_scalarproduct_double(fdsp, cdsp, dbl_src0, dbl_src1))
+        ret -= 1 << 10;
+    if (test_vector_clipf(fdsp, cdsp, src0, src1[0], src1[1]))
+        ret -= 1 << 11;
+    if (test_vector_dminmax(fdsp, cdsp, dbl_src0))
+        ret -= 1 << 12;
 
 end:
     av_freep(&fdsp);
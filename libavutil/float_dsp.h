@@ -157,6 +157,62 @@ typedef struct AVFloatDSPContext {
      * @return sum of elementwise products
      */
     float (*scalarproduct_float)(const float *v1, const float *v2, int len);
+
+    /**
+     * Multiply a vector of doubles by a scalar double and add to
+     * destination vector.  Source and destination vectors must
+     * overlap exactly or not at all.
+     *
+     * @param dst result vector
+     *            constraints: 32-byte aligned
+     * @param src input vector
+     *            constraints: 32-byte aligned
+     * @param mul scalar value
+     * @param len length of vector
+     *            constraints: multiple of 8
+     */
+    void (*vector_dmac_scalar)(double *dst, const double *src, double mul,
+                               int len);
+
+    /**
+     * Calculate the scalar product of two vectors of doubles.
+     *
+     * @param v1  first vector, 32-byte aligned
+     * @param v2  second vector, 32-byte aligned
+     * @param len length of vectors, multiple of 8
+     *
+     * @return sum of elementwise products
+     */
+    double (*scalarproduct_double)(const double *v1, const double *v2, int len);
+
+    /**
+     * Clip each element of a vector of floats to the range [min, max].
+     * Source and destination vectors must overlap exactly or not at all.
+     *
+     * @param dst result vector
+     *            constraints: 32-byte aligned
+     * @param src input vector
+     *            constraints: 32-byte aligned
+     * @param len length of vector
+     *            constraints: multiple of 16
+     * @param min lower bound
+     * @param max upper bound, must not be smaller than min
+     */
+    void (*vector_clipf)(float *dst, const float *src, int len,
+                         float min, float max);
+
+    /**
+     * Find the smallest and the largest element of a vector of doubles.
+     *
+     * @param src input vector
+     *            constraints: 32-byte aligned
+     * @param len length of vector
+     *            constraints: multiple of 8
+     * @param min smallest element
+     * @param max largest element
+     */
+    void (*vector_dminmax)(const double *src, int len,
+                           double *min, double *max);
 } AVFloatDSPContext;
 
 /**
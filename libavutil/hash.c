@@ -23,6 +23,7 @@
 #include "adler32.h"
 #include "crc.h"
 #include "md5.h"
+#include "md5_internal.h"
 #include "murmur3.h"
 #include "ripemd.h"
 #include "sha.h"
@@ -176,6 +177,24 @@ void av_hash_update(AVHashContext *ctx, const uint8_t *src, int len)
     }
 }
 
+void av_hash_update_multi(AVHashContext **ctx, const uint8_t **src,
+                          const int *len, int nb)
+{
+    struct AVMD5 *md5[4];
+    int i, j;
+
+    for (i = 0; i < nb; i += j) {
+        for (j = 0; j < FFMIN(nb - i, 4) && ctx[i + j]->type == MD5; j++)
+            md5[j] = ctx[i + j]->ctx;
+        if (j > 1) {
+            ff_md5_update_multi(md5, src + i, len + i, j);
+        } else {
+            av_hash_update(ctx[i], src[i], len[i]);
+            j = 1;
+        }
+    }
+}
+
 void av_hash_final(AVHashContext *ctx, uint8_t *dst)
 {
     switch (ctx->type) {
@@ -77,6 +77,20 @@ void av_hash_init(struct AVHashContext *ctx);
  */
 void av_hash_update(struct AVHashContext *ctx, const uint8_t *src, int len);
 
+/**
+ * Update several hash contexts, each with its own data.
+ *
+ * This gives the same result as calling av_hash_update() on each of them,
+ * but some hash functions (currently MD5) process several buffers at once,
+ * which is faster than hashing them one after the other.
+ *
+ * @param ctx array of nb hash contexts, best all using the same hash function
+ * @param src array of nb buffers, src[i] is used to update ctx[i]
+ * @param len array of nb buffer sizes
+ */
+void av_hash_update_multi(struct AVHashContext **ctx, const uint8_t **src,
+                          const int *len, int nb);
+
 /**
  * Finalize a hash context and compute the actual hash value.
  */
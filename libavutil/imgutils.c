@@ -24,6 +24,7 @@
 #include "avassert.h"
 #include "common.h"
 #include "imgutils.h"
+#include "imgutils_internal.h"
 #include "internal.h"
 #include "intreadwrite.h"
 #include "log.h"
@@ -270,6 +271,10 @@ int av_image_check_sar(unsigned int w, unsigned int h, AVRational sar)
     return AVERROR(EINVAL);
 }
 
+/* planes from this size on are copied with non-temporal stores, they would
+ * evict most of the cache otherwise */
+#define NT_COPY_THRESHOLD (1 << 22)
+
 void av_image_copy_plane(uint8_t       *dst, int dst_linesize,
                          const uint8_t *src, int src_linesize,
                          int bytewidth, int height)
@@ -278,6 +283,10 @@ void av_image_copy_plane(uint8_t       *dst, int dst_linesize,
         return;
     av_assert0(abs(src_linesize) >= bytewidth);
     av_assert0(abs(dst_linesize) >= bytewidth);
+    if (ARCH_X86 && (int64_t)bytewidth * height >= NT_COPY_THRESHOLD &&
+        ff_image_copy_plane_nt_x86(dst, dst_linesize, src, src_linesize,
+                                   bytewidth, height))
+        return;
     for (;height > 0; height--) {
         memcpy(dst, src, bytewidth);
         dst += dst_linesize;
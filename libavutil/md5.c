@@ -34,6 +34,7 @@
 #include "bswap.h"
 #include "intreadwrite.h"
 #include "md5.h"
+#include "md5_internal.h"
 #include "mem.h"
 
 typedef struct AVMD5{
@@ -180,6 +181,45 @@ void av_md5_update(AVMD5 *ctx, const uint8_t *src, int len)
         memcpy(ctx->block, src, len);
 }
 
+static void update_x4(AVMD5 **ctx, const uint8_t **src, const int *len, int nb)
+{
+    uint32_t dummy[4], *abcd[4];
+    const uint8_t *p[4];
+    int left[4], i, n = INT_MAX;
+
+    for (i = 0; i < nb; i++) {
+        int head = FFMIN(len[i], (64 - (ctx[i]->len & 63)) & 63);
+        av_md5_update(ctx[i], src[i], head);
+        p[i]    = src[i] + head;
+        left[i] = len[i] - head;
+        abcd[i] = ctx[i]->ABCD;
+        n = FFMIN(n, left[i] >> 6);
+    }
+    for (; i < 4; i++) {
+        p[i]    = p[0];
+        abcd[i] = dummy;
+    }
+
+    if (nb > 1 && n > 0 && ARCH_X86 && ff_md5_blocks_x4_x86(abcd, p, n)) {
+        for (i = 0; i < nb; i++) {
+            ctx[i]->len += 64 * n;
+            p[i]        += 64 * n;
+            left[i]     -= 64 * n;
+        }
+    }
+
+    for (i = 0; i < nb; i++)
+        av_md5_update(ctx[i], p[i], left[i]);
+}
+
+void ff_md5_update_multi(AVMD5 **ctx, const uint8_t **src, const int *len, int nb)
+{
+    int i;
+
+    for (i = 0; i < nb; i += 4)
+        update_x4(ctx + i, src + i, len + i, FFMIN(nb - i, 4));
+}
+
 void av_md5_final(AVMD5 *ctx, uint8_t *dst)
 {
     int i;
@@ -231,6 +271,24 @@ int main(void){
         in[i] = i % 127;
     av_md5_sum(md5val, in,  999); print_md5(md5val);
 
+    {
+        static const int len[5] = { 999, 998, 640, 300, 3 };
+        const uint8_t *src[5];
+        AVMD5 ctx[5], *pctx[5];
+
+        for (i = 0; i < 5; i++) {
+            pctx[i] = &ctx[i];
+            src[i]  = (const uint8_t *)in + 1;
+            av_md5_init(&ctx[i]);
+            av_md5_update(&ctx[i], (const uint8_t *)in, 1);
+        }
+        ff_md5_update_multi(pctx, src, len, 5);
+        for (i = 0; i < 5; i++) {
+            av_md5_final(&ctx[i], md5val);
+            print_md5(md5val);
+        }
+    }
+
     return 0;
 }
 #endif
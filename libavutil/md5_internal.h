@@ -0,0 +1,42 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_MD5_INTERNAL_H
+#define AVUTIL_MD5_INTERNAL_H
+
+#include <stdint.h>
+
+struct AVMD5;
+
+/**
+ * Update nb contexts, each with its own buffer. This gives the same result
+ * as calling av_md5_update() on each of them, but hashes up to 4 buffers in
+ * parallel where the CPU allows it.
+ */
+void ff_md5_update_multi(struct AVMD5 **ctx, const uint8_t **src,
+                         const int *len, int nb);
+
+/**
+ * Hash nblocks 64-byte blocks of 4 buffers in parallel, abcd[i] being the
+ * state of the i-th buffer in the layout of AVMD5.ABCD.
+ *
+ * @return 0 if the CPU does not support it, nblocks otherwise
+ */
+int ff_md5_blocks_x4_x86(uint32_t *abcd[4], const uint8_t *src[4], int nblocks);
+
+#endif /* AVUTIL_MD5_INTERNAL_H */
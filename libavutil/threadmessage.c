@@ -18,7 +18,13 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+
+#include "atomic.h"
+#include "common.h"
+#include "cpu.h"
 #include "fifo.h"
+#include "mem.h"
 #include "threadmessage.h"
 #if HAVE_THREADS
 #if HAVE_PTHREADS
@@ -32,14 +38,32 @@
 #endif
 #endif
 
+/* bounds of the number of polls before a blocked single producer or
+ * consumer goes to sleep */
+#define SPIN_MIN 16
+#define SPIN_MAX 4096
+
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
     AVFifoBuffer *fifo;
     pthread_mutex_t lock;
     pthread_cond_t cond;
-    int err_send;
-    int err_recv;
+    volatile int err_send;
+    volatile int err_recv;
     unsigned elsize;
+
+    /* lock-free ring used with AV_THREAD_MESSAGE_QUEUE_SPSC, the positions
+     * run from 0 to 2 * nelem - 1 so that a full ring differs from an empty
+     * one, each is only written by one side */
+    int spsc;
+    uint8_t *ring;
+    unsigned nelem;
+    volatile int wpos;
+    volatile int rpos;
+    volatile int nb_waiting;    ///< threads sleeping on cond
+    int spin_max;               ///< 0 on a single CPU, where polling is useless
+    int spin_send;              ///< current number of polls of the sender
+    int spin_recv;              ///< current number of polls of the receiver
 #else
     int dummy;
 #endif
@@ -48,12 +72,20 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
     int ret = 0;
 
-    if (nelem > INT_MAX / elsize)
+    if (nelem > INT_MAX / elsize || nelem > INT_MAX / 2)
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
@@ -66,11 +98,21 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+        rmq->spsc      = 1;
+        rmq->nelem     = nelem;
+        rmq->spin_max  = av_cpu_count() > 1 ? SPIN_MAX : 0;
+        rmq->spin_send = FFMIN(SPIN_MIN, rmq->spin_max);
+        rmq->spin_recv = FFMIN(SPIN_MIN, rmq->spin_max);
+        rmq->ring      = av_malloc_array(nelem, elsize);
+    } else {
+        rmq->fifo = av_fifo_alloc(elsize * nelem);
+    }
+    if (!rmq->fifo && !rmq->ring) {
         pthread_cond_destroy(&rmq->cond);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
-        return AVERROR(ret);
+        return AVERROR(ENOMEM);
     }
     rmq->elsize = elsize;
     *mq = rmq;
@@ -86,6 +128,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
 #if HAVE_THREADS
     if (*mq) {
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond);
         pthread_mutex_destroy(&(*mq)->lock);
         av_freep(mq);
@@ -127,6 +170,92 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     return 0;
 }
 
+static int spsc_count(AVThreadMessageQueue *mq, int wpos, int rpos)
+{
+    return wpos >= rpos ? wpos - rpos : wpos - rpos + 2 * mq->nelem;
+}
+
+/**
+ * Wait until the position written by the other side changes from val or
+ * an error is set. Poll for a while first, the number of polls grows when
+ * polling is enough and shrinks when the thread has to sleep.
+ */
+static void spsc_wait(AVThreadMessageQueue *mq, volatile int *pos, int val,
+                      volatile int *err, int *spin)
+{
+    int i;
+
+    for (i = 0; i < *spin; i++) {
+        if (avpriv_atomic_int_get(pos) != val || avpriv_atomic_int_get(err)) {
+            *spin = FFMIN(*spin * 2, mq->spin_max);
+            return;
+        }
+    }
+    *spin = FFMAX(*spin / 2, FFMIN(SPIN_MIN, mq->spin_max));
+
+    /* the other side checks nb_waiting after moving its position, so either
+     * it sees the increment or the check below sees the new position */
+    pthread_mutex_lock(&mq->lock);
+    avpriv_atomic_int_add_and_fetch(&mq->nb_waiting, 1);
+    while (avpriv_atomic_int_get(pos) == val && !avpriv_atomic_int_get(err))
+        pthread_cond_wait(&mq->cond, &mq->lock);
+    avpriv_atomic_int_add_and_fetch(&mq->nb_waiting, -1);
+    pthread_mutex_unlock(&mq->lock);
+}
+
+static void spsc_wake(AVThreadMessageQueue *mq)
+{
+    if (avpriv_atomic_int_get(&mq->nb_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(&mq->cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+static int spsc_send(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    int wpos = mq->wpos, rpos, err;
+
+    while (1) {
+        if ((err = avpriv_atomic_int_get(&mq->err_send)))
+            return err;
+        rpos = avpriv_atomic_int_get(&mq->rpos);
+        if (spsc_count(mq, wpos, rpos) < mq->nelem)
+            break;
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        spsc_wait(mq, &mq->rpos, rpos, &mq->err_send, &mq->spin_send);
+    }
+    memcpy(mq->ring + (wpos % mq->nelem) * mq->elsize, msg, mq->elsize);
+    avpriv_atomic_int_set(&mq->wpos, wpos + 1 < 2 * mq->nelem ? wpos + 1 : 0);
+    spsc_wake(mq);
+    return 0;
+}
+
+static int spsc_recv(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    int rpos = mq->rpos, wpos;
+
+    while (1) {
+        wpos = avpriv_atomic_int_get(&mq->wpos);
+        if (wpos != rpos)
+            break;
+        if (avpriv_atomic_int_get(&mq->err_recv)) {
+            /* the sender may have sent a last message before the error */
+            if ((wpos = avpriv_atomic_int_get(&mq->wpos)) != rpos)
+                break;
+            return mq->err_recv;
+        }
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        spsc_wait(mq, &mq->wpos, wpos, &mq->err_recv, &mq->spin_recv);
+    }
+    memcpy(msg, mq->ring + (rpos % mq->nelem) * mq->elsize, mq->elsize);
+    avpriv_atomic_int_set(&mq->rpos, rpos + 1 < 2 * mq->nelem ? rpos + 1 : 0);
+    spsc_wake(mq);
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -136,6 +265,9 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return spsc_send(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -152,6 +284,9 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return spsc_recv(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -166,7 +301,7 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_send = err;
+    avpriv_atomic_int_set(&mq->err_send, err);
     pthread_cond_broadcast(&mq->cond);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -177,8 +312,101 @@ void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_recv = err;
+    avpriv_atomic_int_set(&mq->err_recv, err);
     pthread_cond_broadcast(&mq->cond);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
 }
+
+int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
+{
+#if HAVE_THREADS
+    int ret;
+
+    if (mq->spsc)
+        return spsc_count(mq, avpriv_atomic_int_get(&mq->wpos),
+                              avpriv_atomic_int_get(&mq->rpos));
+
+    pthread_mutex_lock(&mq->lock);
+    ret = av_fifo_size(mq->fifo) / mq->elsize;
+    pthread_mutex_unlock(&mq->lock);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#define NB_MESSAGES 100000
+
+typedef struct Message {
+    int seq;
+    char payload[60];
+} Message;
+
+static void *sender(void *arg)
+{
+    AVThreadMessageQueue *mq = arg;
+    Message msg = { 0 };
+    int i;
+
+    for (i = 0; i < NB_MESSAGES; i++) {
+        msg.seq = i;
+        msg.payload[i % sizeof(msg.payload)] = i;
+        if (av_thread_message_queue_send(mq, &msg, i & 1 ? AV_THREAD_MESSAGE_NONBLOCK : 0) == AVERROR(EAGAIN))
+            av_thread_message_queue_send(mq, &msg, 0);
+    }
+    av_thread_message_queue_set_err_recv(mq, AVERROR_EOF);
+    return NULL;
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        unsigned flags;
+        unsigned nelem;
+    } tests[] = {
+        { "locked",   0,                            1 },
+        { "locked",   0,                           16 },
+        { "spsc",     AV_THREAD_MESSAGE_QUEUE_SPSC, 1 },
+        { "spsc",     AV_THREAD_MESSAGE_QUEUE_SPSC, 7 },
+        { "spsc",     AV_THREAD_MESSAGE_QUEUE_SPSC, 64 },
+    };
+    int i, ret = 0;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        AVThreadMessageQueue *mq;
+        pthread_t thread;
+        Message msg;
+        int n = 0, errors = 0;
+
+        if (av_thread_message_queue_alloc2(&mq, tests[i].nelem, sizeof(msg),
+                                           tests[i].flags) < 0)
+            return 1;
+        pthread_create(&thread, NULL, sender, mq);
+        while (1) {
+            int err = av_thread_message_queue_recv(mq, &msg, n & 1 ? AV_THREAD_MESSAGE_NONBLOCK : 0);
+            if (err == AVERROR(EAGAIN))
+                err = av_thread_message_queue_recv(mq, &msg, 0);
+            if (err < 0)
+                break;
+            if (av_thread_message_queue_nb_elems(mq) > tests[i].nelem ||
+                msg.seq != n || msg.payload[n % sizeof(msg.payload)] != (char)n)
+                errors++;
+            n++;
+        }
+        pthread_join(thread, NULL);
+        av_thread_message_queue_free(&mq);
+
+        printf("%-6s %2u: %d messages, %d errors\n",
+               tests[i].name, tests[i].nelem, n, errors);
+        ret |= errors || n != NB_MESSAGES;
+    }
+    return ret;
+}
+
+#endif /* TEST */
@@ -32,6 +32,15 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+/**
+ * Flag for av_thread_message_queue_alloc2(): the queue is used by a single
+ * sending thread and a single receiving thread.
+ *
+ * Messages then go through a lock-free ring buffer, and a blocked thread
+ * polls the queue for a while before it sleeps.
+ */
+#define AV_THREAD_MESSAGE_QUEUE_SPSC 1
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +54,17 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue.
+ *
+ * Same as av_thread_message_queue_alloc(), with flags being a combination
+ * of AV_THREAD_MESSAGE_QUEUE_* flags.
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -88,4 +108,12 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
 void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
                                           int err);
 
+/**
+ * Return the current number of messages in the queue.
+ *
+ * @return the number of messages or AVERROR(ENOSYS) if lavu was built
+ *         without thread support
+ */
+int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq);
+
 #endif /* AVUTIL_THREADMESSAGE_H */
@@ -0,0 +1,314 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+
+#include "atomic.h"
+#include "error.h"
+#include "mem.h"
+#include "thread.h"
+#include "time.h"
+#include "trace.h"
+
+/* events kept per thread, a power of 2 */
+#define TRACE_BUFFER_SIZE (1 << 16)
+
+typedef struct TraceEvent {
+    int64_t     ts;
+    const char *category;
+    const char *name;
+    char        phase;              ///< 'B' or 'E'
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    int tid;
+    /* only the owning thread writes, the index is published atomically */
+    volatile int pos;               ///< index of the next event
+    volatile int wrapped;           ///< events[pos] onwards are valid too
+    volatile int exited;            ///< the thread is gone, free once exported
+    TraceEvent *events;
+} TraceBuffer;
+
+static volatile int enabled;
+static volatile int nb_buffers;
+static void * volatile buffers;     ///< list of TraceBuffer
+
+#if HAVE_PTHREADS
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+
+/* Called when a thread exits. The buffer may be being exported right now, so
+ * it is only marked here, the next export frees it. */
+static void release_buffer(void *opaque)
+{
+    TraceBuffer *buf = opaque;
+    avpriv_atomic_int_set(&buf->exited, 1);
+}
+
+static void init_buffer_key(void)
+{
+    pthread_key_create(&buffer_key, release_buffer);
+}
+#endif
+
+static TraceBuffer *get_buffer(void)
+{
+    TraceBuffer *buf;
+    void *head;
+
+#if HAVE_PTHREADS
+    pthread_once(&buffer_key_once, init_buffer_key);
+    buf = pthread_getspecific(buffer_key);
+#else
+    buf = buffers;
+#endif
+    if (buf)
+        return buf;
+
+    buf = av_mallocz(sizeof(*buf));
+    if (!buf)
+        return NULL;
+    buf->events = av_malloc_array(TRACE_BUFFER_SIZE, sizeof(*buf->events));
+    if (!buf->events) {
+        av_free(buf);
+        return NULL;
+    }
+    buf->tid = avpriv_atomic_int_add_and_fetch(&nb_buffers, 1);
+    do {
+        head      = buffers;
+        buf->next = head;
+    } while (avpriv_atomic_ptr_cas(&buffers, head, buf) != head);
+#if HAVE_PTHREADS
+    pthread_setspecific(buffer_key, buf);
+#endif
+    return buf;
+}
+
+static void record(const char *category, const char *name, char phase)
+{
+    TraceBuffer *buf;
+    TraceEvent *ev;
+    int pos;
+
+    if (!enabled || !(buf = get_buffer()))
+        return;
+
+    pos = buf->pos;
+    ev  = &buf->events[pos];
+    ev->ts       = av_gettime_relative();
+    ev->category = category;
+    ev->name     = name;
+    ev->phase    = phase;
+
+    pos = (pos + 1) & (TRACE_BUFFER_SIZE - 1);
+    if (!pos)
+        avpriv_atomic_int_set(&buf->wrapped, 1);
+    avpriv_atomic_int_set(&buf->pos, pos);
+}
+
+int av_trace_set_enabled(int enable)
+{
+#if HAVE_THREADS && !HAVE_PTHREADS
+    if (enable)
+        return AVERROR(ENOSYS);
+#endif
+    avpriv_atomic_int_set(&enabled, !!enable);
+    return 0;
+}
+
+void av_trace_begin(const char *category, const char *name)
+{
+    record(category, name, 'B');
+}
+
+void av_trace_end(const char *category, const char *name)
+{
+    record(category, name, 'E');
+}
+
+static void print_string(AVBPrint *bp, const char *s)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\')
+            av_bprintf(bp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            av_bprintf(bp, "\\u%04x", *s);
+        else
+            av_bprint_chars(bp, *s, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+/**
+ * Unlink and free the buffer of an exited thread. New buffers are only
+ * ever pushed in front of the list, concurrently with this.
+ */
+static void free_buffer(TraceBuffer *prev, TraceBuffer *buf)
+{
+    if (!prev && avpriv_atomic_ptr_cas(&buffers, buf, buf->next) != buf)
+        for (prev = buffers; prev->next != buf; prev = prev->next);
+    if (prev)
+        prev->next = buf->next;
+    av_free(buf->events);
+    av_free(buf);
+}
+
+int av_trace_export_json(AVBPrint *bp)
+{
+    TraceBuffer *buf, *next, *prev = NULL;
+    const char *sep = "";
+
+    av_bprintf(bp, "{\"traceEvents\":[");
+    for (buf = buffers; buf; buf = next) {
+        int wrapped = avpriv_atomic_int_get(&buf->wrapped);
+        int pos     = avpriv_atomic_int_get(&buf->pos);
+        int i       = wrapped ? pos : 0;
+        int n       = wrapped ? TRACE_BUFFER_SIZE : pos;
+
+        for (; n > 0; n--, i = (i + 1) & (TRACE_BUFFER_SIZE - 1)) {
+            const TraceEvent *ev = &buf->events[i];
+
+            av_bprintf(bp, "%s\n{\"name\":", sep);
+            print_string(bp, ev->name);
+            av_bprintf(bp, ",\"cat\":");
+            print_string(bp, ev->category);
+            av_bprintf(bp, ",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":1,\"tid\":%d}",
+                       ev->phase, ev->ts, buf->tid);
+            sep = ",";
+        }
+
+        next = buf->next;
+        if (avpriv_atomic_int_get(&buf->exited))
+            free_buffer(prev, buf);
+        else
+            prev = buf;
+    }
+    av_bprintf(bp, "\n]}\n");
+
+    return av_bprint_is_complete(bp) ? 0 : AVERROR(ENOMEM);
+}
+
+#ifdef TEST
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avassert.h"
+
+/* print the exported events with their timestamps, which vary, set to 0 */
+static void print_events(const char *s)
+{
+    const char *ts;
+
+    while ((ts = strstr(s, "\"ts\":"))) {
+        ts += 5;
+        printf("%.*s0", (int)(ts - s), s);
+        s = ts + strspn(ts, "0123456789");
+    }
+    printf("%s", s);
+}
+
+/* check that the events of tid alternate between begin and end, in time
+ * order, and return their number */
+static int check_events(const char *s, int tid)
+{
+    int64_t last_ts = INT64_MIN;
+    char tid_str[32];
+    int n = 0;
+
+    snprintf(tid_str, sizeof(tid_str), ",\"tid\":%d}", tid);
+    while ((s = strstr(s, "\"ph\":\""))) {
+        char phase = s[6];
+        int64_t ts = strtoll(strstr(s, "\"ts\":") + 5, NULL, 10);
+
+        s = strchr(s, '}');
+        if (strncmp(s - strlen(tid_str) + 1, tid_str, strlen(tid_str)))
+            continue;
+        av_assert0(phase == (n & 1 ? 'E' : 'B'));
+        av_assert0(ts >= last_ts);
+        last_ts = ts;
+        n++;
+    }
+    return n;
+}
+
+static void export_events(AVBPrint *bp)
+{
+    av_bprint_clear(bp);
+    av_assert0(av_trace_export_json(bp) >= 0);
+}
+
+#if HAVE_PTHREADS
+static void *record_thread(void *arg)
+{
+    av_trace_begin("thread", "worker");
+    av_trace_end("thread", "worker");
+    return NULL;
+}
+#endif
+
+int main(void)
+{
+    AVBPrint bp;
+    int i;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    printf("nested scopes:\n");
+    av_trace_begin("ignored", "disabled");
+    av_trace_set_enabled(1);
+    av_trace_begin("decode", "h264");
+    av_trace_begin("filter", "esc\"aped\\\n");
+    av_trace_end("filter", "esc\"aped\\\n");
+    av_trace_end("decode", "h264");
+    av_trace_set_enabled(0);
+    av_trace_end("ignored", "disabled");
+    export_events(&bp);
+    print_events(bp.str);
+
+    av_trace_set_enabled(1);
+    for (i = 0; i < TRACE_BUFFER_SIZE + 10; i++) {
+        if (i & 1)
+            av_trace_end("loop", "wrap");
+        else
+            av_trace_begin("loop", "wrap");
+    }
+    export_events(&bp);
+    printf("wrapped ring: %d events\n", check_events(bp.str, 1));
+
+#if HAVE_PTHREADS
+    {
+        pthread_t thread;
+
+        av_assert0(!pthread_create(&thread, NULL, record_thread, NULL));
+        pthread_join(thread, NULL);
+    }
+    export_events(&bp);
+    printf("exited thread: %d events\n", check_events(bp.str, 2));
+    export_events(&bp);
+    printf("exited thread, exported again: %d events\n", check_events(bp.str, 2));
+#endif
+
+    av_bprint_finalize(&bp, NULL);
+    return 0;
+}
+#endif
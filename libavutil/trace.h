@@ -0,0 +1,75 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Recording of timed scopes, per thread, for performance analysis.
+ *
+ * Each thread records its events in its own ring buffer, so recording takes
+ * no lock. Only the most recent events of each thread are kept. The events
+ * can be exported in the Chrome trace event format, which chrome://tracing
+ * and other trace viewers load.
+ */
+
+#ifndef AVUTIL_TRACE_H
+#define AVUTIL_TRACE_H
+
+#include "bprint.h"
+
+/**
+ * Start or stop recording events.
+ *
+ * Recording is off by default, av_trace_begin() and av_trace_end() then
+ * return immediately.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if lavu was built with a threading
+ *         implementation that tracing does not support
+ */
+int av_trace_set_enabled(int enabled);
+
+/**
+ * Mark the start of a scope in the calling thread.
+ *
+ * @param category what the scope does, e.g. "decode"
+ * @param name     what does it, e.g. the codec name
+ *
+ * Both strings are only stored by reference, and must stay valid until
+ * the events are exported. Static strings are best.
+ */
+void av_trace_begin(const char *category, const char *name);
+
+/**
+ * Mark the end of the scope started by the matching av_trace_begin() call
+ * in the calling thread.
+ */
+void av_trace_end(const char *category, const char *name);
+
+/**
+ * Append the recorded events of all threads to bp, as a JSON object in
+ * the Chrome trace event format.
+ *
+ * This should be called once the traced threads are idle or have exited,
+ * events recorded during the export may be missing or partially written.
+ * The events of the threads that have exited are freed once exported, so
+ * they are only part of one export.
+ *
+ * @return 0 on success, AVERROR(ENOMEM) if bp is truncated
+ */
+int av_trace_export_json(AVBPrint *bp);
+
+#endif /* AVUTIL_TRACE_H */
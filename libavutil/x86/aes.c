@@ -0,0 +1,217 @@
+/*
+ * AES-NI accelerated AES
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The key schedule built by av_aes_init() is used as is: it is already in
+ * the order and form aesenc and the equivalent inverse cipher of aesdec
+ * expect. ECB and CBC decryption have no dependency between blocks and are
+ * run 4 blocks at a time to hide the latency of the AES instructions.
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/aes_internal.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+
+#if HAVE_AESNI_INLINE
+
+/* %2: round keys, %3: offset of the first round key, clobbered */
+#define ROUNDS_1(op)                                    \
+    "movdqu    (%2,%3), %%xmm4                  \n\t"   \
+    "pxor      %%xmm4, %%xmm0                   \n\t"   \
+    "sub       $16, %3                          \n\t"   \
+    "1:                                         \n\t"   \
+    "movdqu    (%2,%3), %%xmm4                  \n\t"   \
+    op "       %%xmm4, %%xmm0                   \n\t"   \
+    "sub       $16, %3                          \n\t"   \
+    "jnz       1b                               \n\t"   \
+    "movdqu    (%2), %%xmm4                     \n\t"   \
+    op "last   %%xmm4, %%xmm0                   \n\t"
+
+#define ROUNDS_4(op)                                    \
+    "movdqu    (%2,%3), %%xmm4                  \n\t"   \
+    "pxor      %%xmm4, %%xmm0                   \n\t"   \
+    "pxor      %%xmm4, %%xmm1                   \n\t"   \
+    "pxor      %%xmm4, %%xmm2                   \n\t"   \
+    "pxor      %%xmm4, %%xmm3                   \n\t"   \
+    "sub       $16, %3                          \n\t"   \
+    "1:                                         \n\t"   \
+    "movdqu    (%2,%3), %%xmm4                  \n\t"   \
+    op "       %%xmm4, %%xmm0                   \n\t"   \
+    op "       %%xmm4, %%xmm1                   \n\t"   \
+    op "       %%xmm4, %%xmm2                   \n\t"   \
+    op "       %%xmm4, %%xmm3                   \n\t"   \
+    "sub       $16, %3                          \n\t"   \
+    "jnz       1b                               \n\t"   \
+    "movdqu    (%2), %%xmm4                     \n\t"   \
+    op "last   %%xmm4, %%xmm0                   \n\t"   \
+    op "last   %%xmm4, %%xmm1                   \n\t"   \
+    op "last   %%xmm4, %%xmm2                   \n\t"   \
+    op "last   %%xmm4, %%xmm3                   \n\t"
+
+#define LOAD_4                                          \
+    "movdqu      (%1), %%xmm0                   \n\t"   \
+    "movdqu    16(%1), %%xmm1                   \n\t"   \
+    "movdqu    32(%1), %%xmm2                   \n\t"   \
+    "movdqu    48(%1), %%xmm3                   \n\t"
+
+#define STORE_4                                         \
+    "movdqu    %%xmm0,   (%0)                   \n\t"   \
+    "movdqu    %%xmm1, 16(%0)                   \n\t"   \
+    "movdqu    %%xmm2, 32(%0)                   \n\t"   \
+    "movdqu    %%xmm3, 48(%0)                   \n\t"
+
+#define ECB(name, op)                                                   \
+static void ecb_ ## name(AVAES *a, uint8_t *dst, const uint8_t *src,   \
+                         int count)                                     \
+{                                                                       \
+    const uint8_t *key = a->round_key[0].u8;                            \
+    x86_reg off;                                                        \
+                                                                        \
+    for (; count >= 4; count -= 4, src += 64, dst += 64) {              \
+        off = a->rounds * 16;                                           \
+        __asm__ volatile(                                               \
+            LOAD_4                                                      \
+            ROUNDS_4(op)                                                \
+            STORE_4                                                     \
+            : "+r"(dst), "+r"(src), "+r"(key), "+r"(off)                \
+            :                                                           \
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",) \
+              "memory"                                                  \
+        );                                                              \
+    }                                                                   \
+    for (; count > 0; count--, src += 16, dst += 16) {                  \
+        off = a->rounds * 16;                                           \
+        __asm__ volatile(                                               \
+            "movdqu    (%1), %%xmm0                 \n\t"               \
+            ROUNDS_1(op)                                                \
+            "movdqu    %%xmm0, (%0)                 \n\t"               \
+            : "+r"(dst), "+r"(src), "+r"(key), "+r"(off)                \
+            :                                                           \
+            : XMM_CLOBBERS("%xmm0", "%xmm4",)                           \
+              "memory"                                                  \
+        );                                                              \
+    }                                                                   \
+}
+
+ECB(encrypt, "aesenc")
+ECB(decrypt, "aesdec")
+
+static void cbc_encrypt(AVAES *a, uint8_t *dst, const uint8_t *src,
+                        int count, uint8_t *iv)
+{
+    const uint8_t *key = a->round_key[0].u8;
+    x86_reg off;
+
+    for (; count > 0; count--, src += 16, dst += 16) {
+        off = a->rounds * 16;
+        __asm__ volatile(
+            "movdqu    (%1), %%xmm0                 \n\t"
+            "movdqu    (%4), %%xmm4                 \n\t"
+            "pxor      %%xmm4, %%xmm0               \n\t"
+            ROUNDS_1("aesenc")
+            "movdqu    %%xmm0, (%0)                 \n\t"
+            "movdqu    %%xmm0, (%4)                 \n\t"
+            : "+r"(dst), "+r"(src), "+r"(key), "+r"(off)
+            : "r"(iv)
+            : XMM_CLOBBERS("%xmm0", "%xmm4",)
+              "memory"
+        );
+    }
+}
+
+static void cbc_decrypt(AVAES *a, uint8_t *dst, const uint8_t *src,
+                        int count, uint8_t *iv)
+{
+    const uint8_t *key = a->round_key[0].u8;
+    x86_reg off;
+
+    /* all of src is read before dst is written, for in-place decryption */
+    for (; count >= 4; count -= 4, src += 64, dst += 64) {
+        off = a->rounds * 16;
+        __asm__ volatile(
+            LOAD_4
+            ROUNDS_4("aesdec")
+            "movdqu      (%4), %%xmm4               \n\t"
+            "pxor      %%xmm4, %%xmm0               \n\t"
+            "movdqu      (%1), %%xmm4               \n\t"
+            "pxor      %%xmm4, %%xmm1               \n\t"
+            "movdqu    16(%1), %%xmm4               \n\t"
+            "pxor      %%xmm4, %%xmm2               \n\t"
+            "movdqu    32(%1), %%xmm4               \n\t"
+            "pxor      %%xmm4, %%xmm3               \n\t"
+            "movdqu    48(%1), %%xmm4               \n\t"
+            "movdqu    %%xmm4, (%4)                 \n\t"
+            STORE_4
+            : "+r"(dst), "+r"(src), "+r"(key), "+r"(off)
+            : "r"(iv)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",)
+              "memory"
+        );
+    }
+    for (; count > 0; count--, src += 16, dst += 16) {
+        off = a->rounds * 16;
+        __asm__ volatile(
+            "movdqu    (%1), %%xmm0                 \n\t"
+            "movdqa    %%xmm0, %%xmm5               \n\t"
+            ROUNDS_1("aesdec")
+            "movdqu    (%4), %%xmm4                 \n\t"
+            "pxor      %%xmm4, %%xmm0               \n\t"
+            "movdqu    %%xmm5, (%4)                 \n\t"
+            "movdqu    %%xmm0, (%0)                 \n\t"
+            : "+r"(dst), "+r"(src), "+r"(key), "+r"(off)
+            : "r"(iv)
+            : XMM_CLOBBERS("%xmm0", "%xmm4", "%xmm5",)
+              "memory"
+        );
+    }
+}
+
+static void aes_encrypt_aesni(AVAES *a, uint8_t *dst, const uint8_t *src,
+                              int count, uint8_t *iv)
+{
+    if (iv)
+        cbc_encrypt(a, dst, src, count, iv);
+    else
+        ecb_encrypt(a, dst, src, count);
+}
+
+static void aes_decrypt_aesni(AVAES *a, uint8_t *dst, const uint8_t *src,
+                              int count, uint8_t *iv)
+{
+    if (iv)
+        cbc_decrypt(a, dst, src, count, iv);
+    else
+        ecb_decrypt(a, dst, src, count);
+}
+
+#endif /* HAVE_AESNI_INLINE */
+
+av_cold void ff_init_aes_x86(AVAES *a, int decrypt)
+{
+#if HAVE_AESNI_INLINE
+    int cpu_flags = av_get_cpu_flags();
+
+    if (INLINE_AESNI(cpu_flags))
+        a->crypt = decrypt ? aes_decrypt_aesni : aes_encrypt_aesni;
+#endif
+}
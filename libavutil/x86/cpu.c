@@ -126,6 +126,10 @@ int ff_get_cpu_flags_x86(void)
             rval |= AV_CPU_FLAG_SSE4;
         if (ecx & 0x00100000 )
             rval |= AV_CPU_FLAG_SSE42;
+        if (ecx & 0x00000002 )
+            rval |= AV_CPU_FLAG_CLMUL;
+        if (ecx & 0x02000000 )
+            rval |= AV_CPU_FLAG_AESNI;
 #if HAVE_AVX
         /* Check OXSAVE and AVX bits */
         if ((ecx & 0x18000000) == 0x18000000) {
@@ -152,6 +156,8 @@ int ff_get_cpu_flags_x86(void)
             if (ebx & 0x00000100)
                 rval |= AV_CPU_FLAG_BMI2;
         }
+        if ((rval & AV_CPU_FLAG_SSE42) && (ebx & 0x20000000))
+            rval |= AV_CPU_FLAG_SHANI;
     }
 
     cpuid(0x80000000, max_ext_level, ebx, ecx, edx);
@@ -0,0 +1,172 @@
+/*
+ * CRC folding with carry-less multiplications
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A CRC of width w < 32 is computed as a 32-bit CRC with the polynomial
+ * P(x)*x^(32-w), like av_crc_init() does, so only 32-bit polynomials are
+ * handled here.
+ *
+ * A 128-bit block B = H*x^64 + L followed by D more bits is congruent to
+ * H*(x^(64+D) mod P) + L*(x^D mod P), which are two 64x32-bit carry-less
+ * multiplications. The buffer is folded 4 blocks at a time, then the 4
+ * blocks are folded into one, which the table based code finishes.
+ *
+ * For the bit-reflected CRCs, the blocks are used in memory order: the low
+ * quadword holds H and each multiplication also multiplies by x, so the
+ * multipliers are x^(63+D) and x^(D-1), bit-reversed. For the others, the
+ * bytes are reversed so that the high quadword holds H.
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+#include "crc.h"
+
+/* x^n mod P(x), P(x) = x^32 + poly */
+static uint32_t xpow_mod(uint32_t poly, int n)
+{
+    uint32_t r = 1;
+
+    while (n--)
+        r = (r << 1) ^ (r & 0x80000000 ? poly : 0);
+    return r;
+}
+
+static uint32_t bitswap32(uint32_t x)
+{
+    uint32_t r = 0;
+    int i;
+
+    for (i = 0; i < 32; i++)
+        r |= ((x >> i) & 1) << (31 - i);
+    return r;
+}
+
+av_cold void ff_crc_fold_init_x86(CRCFoldContext *c, int le, int bits, uint32_t poly)
+{
+    int i;
+
+    if (le) {
+        poly = bitswap32(poly);
+        for (i = 0; i < 16; i++)
+            c->shuffle[i] = i;
+        c->fold_4x[0] = (uint64_t)bitswap32(xpow_mod(poly, 512 + 63)) << 32;
+        c->fold_4x[1] = (uint64_t)bitswap32(xpow_mod(poly, 512 -  1)) << 32;
+        c->fold_1x[0] = (uint64_t)bitswap32(xpow_mod(poly, 128 + 63)) << 32;
+        c->fold_1x[1] = (uint64_t)bitswap32(xpow_mod(poly, 128 -  1)) << 32;
+    } else {
+        poly <<= 32 - bits;
+        for (i = 0; i < 16; i++)
+            c->shuffle[i] = 15 - i;
+        c->fold_4x[0] = xpow_mod(poly, 512);
+        c->fold_4x[1] = xpow_mod(poly, 512 + 64);
+        c->fold_1x[0] = xpow_mod(poly, 128);
+        c->fold_1x[1] = xpow_mod(poly, 128 + 64);
+    }
+}
+
+#if HAVE_CLMUL_INLINE
+#define FOLD(x, t, k)                                           \
+        "movdqa    %%"#x", %%"#t"                       \n\t"   \
+        "pclmulqdq $0x00, %%"#k", %%"#x"                \n\t"   \
+        "pclmulqdq $0x11, %%"#k", %%"#t"                \n\t"   \
+        "pxor      %%"#t", %%"#x"                       \n\t"
+
+#define FOLD_LOAD(x, offset)                                    \
+        FOLD(x, xmm4, xmm6)                                     \
+        "movdqu    "#offset"(%0), %%xmm5                \n\t"   \
+        "pshufb    %%xmm7, %%xmm5                       \n\t"   \
+        "pxor      %%xmm5, %%"#x"                       \n\t"
+
+#define FOLD_INTO(x, y)                                         \
+        FOLD(x, xmm4, xmm6)                                     \
+        "pxor      %%"#x", %%"#y"                       \n\t"
+#endif
+
+size_t ff_crc_fold_x86(const CRCFoldContext *c, uint8_t *rem, uint32_t crc,
+                       const uint8_t *buffer, size_t length)
+{
+#if HAVE_CLMUL_INLINE
+    int cpu_flags = av_get_cpu_flags();
+    const xmm_reg init = { crc, 0 };
+    const uint8_t *src = buffer;
+    x86_reg left = length;
+
+    if (!INLINE_CLMUL(cpu_flags) || length < CRC_FOLD_MIN_SIZE)
+        return 0;
+
+    __asm__ volatile(
+        "movdqu    %3, %%xmm7                           \n\t"
+        "movdqu    %6, %%xmm4                           \n\t"
+        "movdqu      (%0), %%xmm0                       \n\t"
+        "movdqu    16(%0), %%xmm1                       \n\t"
+        "movdqu    32(%0), %%xmm2                       \n\t"
+        "movdqu    48(%0), %%xmm3                       \n\t"
+        "pxor      %%xmm4, %%xmm0                       \n\t"
+        "pshufb    %%xmm7, %%xmm0                       \n\t"
+        "pshufb    %%xmm7, %%xmm1                       \n\t"
+        "pshufb    %%xmm7, %%xmm2                       \n\t"
+        "pshufb    %%xmm7, %%xmm3                       \n\t"
+        "add       $64, %0                              \n\t"
+        "sub       $64, %1                              \n\t"
+        "movdqu    %4, %%xmm6                           \n\t"
+        "cmp       $64, %1                              \n\t"
+        "jb        2f                                   \n\t"
+        "1:                                             \n\t"
+        FOLD_LOAD(xmm0,  0)
+        FOLD_LOAD(xmm1, 16)
+        FOLD_LOAD(xmm2, 32)
+        FOLD_LOAD(xmm3, 48)
+        "add       $64, %0                              \n\t"
+        "sub       $64, %1                              \n\t"
+        "cmp       $64, %1                              \n\t"
+        "jae       1b                                   \n\t"
+        "2:                                             \n\t"
+        "movdqu    %5, %%xmm6                           \n\t"
+        FOLD_INTO(xmm0, xmm1)
+        FOLD_INTO(xmm1, xmm2)
+        FOLD_INTO(xmm2, xmm3)
+        "cmp       $16, %1                              \n\t"
+        "jb        4f                                   \n\t"
+        "3:                                             \n\t"
+        FOLD_LOAD(xmm3, 0)
+        "add       $16, %0                              \n\t"
+        "sub       $16, %1                              \n\t"
+        "cmp       $16, %1                              \n\t"
+        "jae       3b                                   \n\t"
+        "4:                                             \n\t"
+        "pshufb    %%xmm7, %%xmm3                       \n\t"
+        "movdqu    %%xmm3, %2                           \n\t"
+        : "+&r"(src), "+&r"(left), "=m"(*(xmm_reg *)rem)
+        : "m"(*(const xmm_reg *)c->shuffle),
+          "m"(*(const xmm_reg *)c->fold_4x),
+          "m"(*(const xmm_reg *)c->fold_1x),
+          "m"(init)
+          XMM_CLOBBERS_ONLY("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                            "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+    );
+
+    return length - left;
+#else
+    return 0;
+#endif
+}
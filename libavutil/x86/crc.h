@@ -0,0 +1,55 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_X86_CRC_H
+#define AVUTIL_X86_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Constants to fold a buffer with carry-less multiplications into a single
+ * 16-byte block with the same CRC.
+ */
+typedef struct CRCFoldContext {
+    uint8_t  shuffle[16];   ///< byte order of the blocks in the registers
+    uint64_t fold_4x[2];    ///< multipliers to fold over 4 blocks
+    uint64_t fold_1x[2];    ///< multipliers to fold over 1 block
+    volatile int init;      ///< set by the caller once the constants are set
+} CRCFoldContext;
+
+/** The shortest buffer ff_crc_fold_x86() works on. */
+#define CRC_FOLD_MIN_SIZE 64
+
+/**
+ * Initialize the folding constants for a CRC with the parameters of
+ * av_crc_init(), bits must be between 8 and 32. init is not set.
+ */
+void ff_crc_fold_init_x86(CRCFoldContext *c, int le, int bits, uint32_t poly);
+
+/**
+ * Fold the largest multiple of 16 bytes at the start of buffer, with crc as
+ * the initial value, into the 16 bytes of rem. The CRC of rem with an initial
+ * value of 0, continued with the rest of the buffer, is the CRC of the buffer.
+ *
+ * @return the number of bytes folded, 0 if the CPU does not support it
+ */
+size_t ff_crc_fold_x86(const CRCFoldContext *c, uint8_t *rem, uint32_t crc,
+                       const uint8_t *buffer, size_t length);
+
+#endif /* AVUTIL_X86_CRC_H */
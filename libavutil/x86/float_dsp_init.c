@@ -65,6 +65,185 @@ float ff_scalarproduct_float_sse(const float *v1, const float *v2, int order);
 
 void ff_butterflies_float_sse(float *src0, float *src1, int len);
 
+/* The loops below index backwards from the end of the vectors with a
+ * negative byte offset, so that the loop counter doubles as the index. */
+
+#if HAVE_FMA3_INLINE
+static float scalarproduct_float_fma3(const float *v1, const float *v2, int len)
+{
+    x86_reg i = -4 * len;
+    float p;
+
+    __asm__ volatile(
+        "vxorps         %%ymm0, %%ymm0, %%ymm0      \n\t"
+        "vxorps         %%ymm1, %%ymm1, %%ymm1      \n\t"
+        "vxorps         %%ymm4, %%ymm4, %%ymm4      \n\t"
+        "cmp            $-64, %0                    \n\t"
+        "jg             2f                          \n\t"
+        "1:                                         \n\t"
+        "vmovups          (%2,%0), %%ymm2           \n\t"
+        "vmovups        32(%2,%0), %%ymm3           \n\t"
+        "vfmadd231ps      (%3,%0), %%ymm2, %%ymm0   \n\t"
+        "vfmadd231ps    32(%3,%0), %%ymm3, %%ymm1   \n\t"
+        "add            $64, %0                     \n\t"
+        "cmp            $-64, %0                    \n\t"
+        "jle            1b                          \n\t"
+        "2:                                         \n\t"
+        "test           %0, %0                      \n\t"
+        "jz             4f                          \n\t"
+        "3:                                         \n\t"
+        "vmovups          (%2,%0), %%xmm2           \n\t"
+        "vfmadd231ps      (%3,%0), %%xmm2, %%xmm4   \n\t"
+        "add            $16, %0                     \n\t"
+        "jl             3b                          \n\t"
+        "4:                                         \n\t"
+        "vaddps         %%ymm1, %%ymm0, %%ymm0      \n\t"
+        "vextractf128   $1, %%ymm0, %%xmm1          \n\t"
+        "vaddps         %%xmm1, %%xmm0, %%xmm0      \n\t"
+        "vaddps         %%xmm4, %%xmm0, %%xmm0      \n\t"
+        "vmovhlps       %%xmm0, %%xmm0, %%xmm1      \n\t"
+        "vaddps         %%xmm1, %%xmm0, %%xmm0      \n\t"
+        "vmovshdup      %%xmm0, %%xmm1              \n\t"
+        "vaddss         %%xmm1, %%xmm0, %%xmm0      \n\t"
+        "vmovss         %%xmm0, %1                  \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i), "=m"(p)
+        : "r"(v1 + len), "r"(v2 + len)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",)
+          "memory"
+    );
+
+    return p;
+}
+
+static double scalarproduct_double_fma3(const double *v1, const double *v2,
+                                        int len)
+{
+    x86_reg i = -8 * len;
+    double p;
+
+    __asm__ volatile(
+        "vxorpd         %%ymm0, %%ymm0, %%ymm0      \n\t"
+        "vxorpd         %%ymm1, %%ymm1, %%ymm1      \n\t"
+        "test           %0, %0                      \n\t"
+        "jz             2f                          \n\t"
+        "1:                                         \n\t"
+        "vmovupd          (%2,%0), %%ymm2           \n\t"
+        "vmovupd        32(%2,%0), %%ymm3           \n\t"
+        "vfmadd231pd      (%3,%0), %%ymm2, %%ymm0   \n\t"
+        "vfmadd231pd    32(%3,%0), %%ymm3, %%ymm1   \n\t"
+        "add            $64, %0                     \n\t"
+        "jl             1b                          \n\t"
+        "2:                                         \n\t"
+        "vaddpd         %%ymm1, %%ymm0, %%ymm0      \n\t"
+        "vextractf128   $1, %%ymm0, %%xmm1          \n\t"
+        "vaddpd         %%xmm1, %%xmm0, %%xmm0      \n\t"
+        "vunpckhpd      %%xmm0, %%xmm0, %%xmm1      \n\t"
+        "vaddsd         %%xmm1, %%xmm0, %%xmm0      \n\t"
+        "vmovsd         %%xmm0, %1                  \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i), "=m"(p)
+        : "r"(v1 + len), "r"(v2 + len)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",)
+          "memory"
+    );
+
+    return p;
+}
+
+static void vector_dmac_scalar_fma3(double *dst, const double *src,
+                                    double mul, int len)
+{
+    x86_reg i = -8 * len;
+
+    __asm__ volatile(
+        "vbroadcastsd   %3, %%ymm0                  \n\t"
+        "test           %0, %0                      \n\t"
+        "jz             2f                          \n\t"
+        "1:                                         \n\t"
+        "vmovupd          (%2,%0), %%ymm1           \n\t"
+        "vmovupd        32(%2,%0), %%ymm2           \n\t"
+        "vfmadd213pd      (%1,%0), %%ymm0, %%ymm1   \n\t"
+        "vfmadd213pd    32(%1,%0), %%ymm0, %%ymm2   \n\t"
+        "vmovupd        %%ymm1,   (%1,%0)           \n\t"
+        "vmovupd        %%ymm2, 32(%1,%0)           \n\t"
+        "add            $64, %0                     \n\t"
+        "jl             1b                          \n\t"
+        "2:                                         \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i)
+        : "r"(dst + len), "r"(src + len), "m"(mul)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2",)
+          "memory"
+    );
+}
+#endif /* HAVE_FMA3_INLINE */
+
+#if HAVE_AVX_INLINE
+static void vector_clipf_avx(float *dst, const float *src, int len,
+                             float min, float max)
+{
+    x86_reg i = -4 * len;
+
+    __asm__ volatile(
+        "vbroadcastss   %3, %%ymm0                  \n\t"
+        "vbroadcastss   %4, %%ymm1                  \n\t"
+        "test           %0, %0                      \n\t"
+        "jz             2f                          \n\t"
+        "1:                                         \n\t"
+        "vmaxps           (%2,%0), %%ymm0, %%ymm2   \n\t"
+        "vmaxps         32(%2,%0), %%ymm0, %%ymm3   \n\t"
+        "vminps         %%ymm1, %%ymm2, %%ymm2      \n\t"
+        "vminps         %%ymm1, %%ymm3, %%ymm3      \n\t"
+        "vmovups        %%ymm2,   (%1,%0)           \n\t"
+        "vmovups        %%ymm3, 32(%1,%0)           \n\t"
+        "add            $64, %0                     \n\t"
+        "jl             1b                          \n\t"
+        "2:                                         \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i)
+        : "r"(dst + len), "r"(src + len), "m"(min), "m"(max)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",)
+          "memory"
+    );
+}
+
+static void vector_dminmax_avx(const double *src, int len,
+                               double *min, double *max)
+{
+    x86_reg i = -8 * len;
+
+    __asm__ volatile(
+        "vmovupd          (%1,%0), %%ymm0           \n\t"
+        "vmovapd        %%ymm0, %%ymm1              \n\t"
+        "1:                                         \n\t"
+        "vmovupd          (%1,%0), %%ymm2           \n\t"
+        "vmovupd        32(%1,%0), %%ymm3           \n\t"
+        "vminpd         %%ymm2, %%ymm0, %%ymm0      \n\t"
+        "vmaxpd         %%ymm2, %%ymm1, %%ymm1      \n\t"
+        "vminpd         %%ymm3, %%ymm0, %%ymm0      \n\t"
+        "vmaxpd         %%ymm3, %%ymm1, %%ymm1      \n\t"
+        "add            $64, %0                     \n\t"
+        "jl             1b                          \n\t"
+        "vextractf128   $1, %%ymm0, %%xmm2          \n\t"
+        "vextractf128   $1, %%ymm1, %%xmm3          \n\t"
+        "vminpd         %%xmm2, %%xmm0, %%xmm0      \n\t"
+        "vmaxpd         %%xmm3, %%xmm1, %%xmm1      \n\t"
+        "vunpckhpd      %%xmm0, %%xmm0, %%xmm2      \n\t"
+        "vunpckhpd      %%xmm1, %%xmm1, %%xmm3      \n\t"
+        "vminsd         %%xmm2, %%xmm0, %%xmm0      \n\t"
+        "vmaxsd         %%xmm3, %%xmm1, %%xmm1      \n\t"
+        "vmovsd         %%xmm0, (%2)                \n\t"
+        "vmovsd         %%xmm1, (%3)                \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i)
+        : "r"(src + len), "r"(min), "r"(max)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",)
+          "memory"
+    );
+}
+#endif /* HAVE_AVX_INLINE */
+
 av_cold void ff_float_dsp_init_x86(AVFloatDSPContext *fdsp)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -96,4 +275,17 @@ av_cold void ff_float_dsp_init_x86(AVFloatDSPContext *fdsp)
         fdsp->vector_fmac_scalar = ff_vector_fmac_scalar_fma3;
         fdsp->vector_fmul_add    = ff_vector_fmul_add_fma3;
     }
+#if HAVE_AVX_INLINE
+    if (INLINE_AVX_FAST(cpu_flags)) {
+        fdsp->vector_clipf   = vector_clipf_avx;
+        fdsp->vector_dminmax = vector_dminmax_avx;
+    }
+#endif
+#if HAVE_FMA3_INLINE
+    if (INLINE_FMA3(cpu_flags) && !(cpu_flags & AV_CPU_FLAG_AVXSLOW)) {
+        fdsp->scalarproduct_float  = scalarproduct_float_fma3;
+        fdsp->scalarproduct_double = scalarproduct_double_fma3;
+        fdsp->vector_dmac_scalar   = vector_dmac_scalar_fma3;
+    }
+#endif
 }
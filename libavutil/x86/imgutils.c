@@ -0,0 +1,72 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/imgutils_internal.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+
+int ff_image_copy_plane_nt_x86(uint8_t       *dst, ptrdiff_t dst_linesize,
+                               const uint8_t *src, ptrdiff_t src_linesize,
+                               ptrdiff_t bytewidth, int height)
+{
+#if HAVE_SSE2_INLINE
+    if (!INLINE_SSE2(av_get_cpu_flags()))
+        return 0;
+
+    for (; height > 0; height--) {
+        /* movntdq needs an aligned destination, the unaligned head and
+         * the tail shorter than a cache line go through memcpy() */
+        ptrdiff_t head = FFMIN(-(uintptr_t)dst & 15, bytewidth);
+        ptrdiff_t body = (bytewidth - head) & ~63;
+        x86_reg i = -body;
+
+        memcpy(dst, src, head);
+        if (body)
+            __asm__ volatile (
+                "1:                             \n\t"
+                "movdqu   (%1, %0), %%xmm0      \n\t"
+                "movdqu 16(%1, %0), %%xmm1      \n\t"
+                "movdqu 32(%1, %0), %%xmm2      \n\t"
+                "movdqu 48(%1, %0), %%xmm3      \n\t"
+                "movntdq  %%xmm0,   (%2, %0)    \n\t"
+                "movntdq  %%xmm1, 16(%2, %0)    \n\t"
+                "movntdq  %%xmm2, 32(%2, %0)    \n\t"
+                "movntdq  %%xmm3, 48(%2, %0)    \n\t"
+                "add       $64, %0              \n\t"
+                "jl 1b                          \n\t"
+                : "+r"(i)
+                : "r"(src + head + body), "r"(dst + head + body)
+                : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",)
+                  "memory");
+        memcpy(dst + head + body, src + head + body, bytewidth - head - body);
+
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+    /* order the non-temporal stores before any later store */
+    __asm__ volatile ("sfence" ::: "memory");
+    return 1;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,219 @@
+/*
+ * MD5 of 4 buffers in parallel with SSE2
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each dword lane of the registers runs the MD5 of one buffer. The steps of
+ * a single MD5 depend on each other, so a single buffer leaves most of the
+ * execution units idle, 4 of them fill the vectors.
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/internal.h"
+#include "libavutil/md5_internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+
+#if HAVE_SSE2_INLINE
+
+#define T4(x) x, x, x, x
+
+DECLARE_ASM_CONST(16, uint32_t, T)[64 * 4] = {
+    T4(0xd76aa478), T4(0xe8c7b756), T4(0x242070db), T4(0xc1bdceee),
+    T4(0xf57c0faf), T4(0x4787c62a), T4(0xa8304613), T4(0xfd469501),
+    T4(0x698098d8), T4(0x8b44f7af), T4(0xffff5bb1), T4(0x895cd7be),
+    T4(0x6b901122), T4(0xfd987193), T4(0xa679438e), T4(0x49b40821),
+
+    T4(0xf61e2562), T4(0xc040b340), T4(0x265e5a51), T4(0xe9b6c7aa),
+    T4(0xd62f105d), T4(0x02441453), T4(0xd8a1e681), T4(0xe7d3fbc8),
+    T4(0x21e1cde6), T4(0xc33707d6), T4(0xf4d50d87), T4(0x455a14ed),
+    T4(0xa9e3e905), T4(0xfcefa3f8), T4(0x676f02d9), T4(0x8d2a4c8a),
+
+    T4(0xfffa3942), T4(0x8771f681), T4(0x6d9d6122), T4(0xfde5380c),
+    T4(0xa4beea44), T4(0x4bdecfa9), T4(0xf6bb4b60), T4(0xbebfbc70),
+    T4(0x289b7ec6), T4(0xeaa127fa), T4(0xd4ef3085), T4(0x04881d05),
+    T4(0xd9d4d039), T4(0xe6db99e5), T4(0x1fa27cf8), T4(0xc4ac5665),
+
+    T4(0xf4292244), T4(0x432aff97), T4(0xab9423a7), T4(0xfc93a039),
+    T4(0x655b59c3), T4(0x8f0ccc92), T4(0xffeff47d), T4(0x85845dd1),
+    T4(0x6fa87e4f), T4(0xfe2ce6e0), T4(0xa3014314), T4(0x4e0811a1),
+    T4(0xf7537e82), T4(0xbd3af235), T4(0x2ad7d2bb), T4(0xeb86d391),
+};
+
+/* the round functions, into xmm4, xmm7 is all ones */
+#define F1(b, c, d)                                                     \
+    "movdqa    %%"#c", %%xmm4                   \n\t"                   \
+    "pxor      %%"#d", %%xmm4                   \n\t"                   \
+    "pand      %%"#b", %%xmm4                   \n\t"                   \
+    "pxor      %%"#d", %%xmm4                   \n\t"
+
+#define F2(b, c, d)                                                     \
+    "movdqa    %%"#b", %%xmm4                   \n\t"                   \
+    "pxor      %%"#c", %%xmm4                   \n\t"                   \
+    "pand      %%"#d", %%xmm4                   \n\t"                   \
+    "pxor      %%"#c", %%xmm4                   \n\t"
+
+#define F3(b, c, d)                                                     \
+    "movdqa    %%"#b", %%xmm4                   \n\t"                   \
+    "pxor      %%"#c", %%xmm4                   \n\t"                   \
+    "pxor      %%"#d", %%xmm4                   \n\t"
+
+#define F4(b, c, d)                                                     \
+    "movdqa    %%"#d", %%xmm4                   \n\t"                   \
+    "pxor      %%xmm7, %%xmm4                   \n\t"                   \
+    "por       %%"#b", %%xmm4                   \n\t"                   \
+    "pxor      %%"#c", %%xmm4                   \n\t"
+
+/* a = b + ((a + F(b, c, d) + X[k] + T[i]) <<< s) */
+#define STEP(f, a, b, c, d, x, t, s, rs)                                \
+    f(b, c, d)                                                          \
+    "paddd     "#x"(%1), %%"#a"                 \n\t"                   \
+    "paddd     "#t"(%2), %%"#a"                 \n\t"                   \
+    "paddd     %%xmm4, %%"#a"                   \n\t"                   \
+    "movdqa    %%"#a", %%xmm4                   \n\t"                   \
+    "pslld     $"#s", %%"#a"                    \n\t"                   \
+    "psrld     $"#rs", %%xmm4                   \n\t"                   \
+    "por       %%xmm4, %%"#a"                   \n\t"                   \
+    "paddd     %%"#b", %%"#a"                   \n\t"
+
+static void md5_block_x4(uint32_t *state, const uint32_t *x)
+{
+    __asm__ volatile(
+        "movdqa      (%0), %%xmm0               \n\t"
+        "movdqa    16(%0), %%xmm1               \n\t"
+        "movdqa    32(%0), %%xmm2               \n\t"
+        "movdqa    48(%0), %%xmm3               \n\t"
+        "pcmpeqd   %%xmm7, %%xmm7               \n\t"
+        STEP(F1, xmm0, xmm1, xmm2, xmm3,   0,    0,  7, 25)
+        STEP(F1, xmm3, xmm0, xmm1, xmm2,  16,   16, 12, 20)
+        STEP(F1, xmm2, xmm3, xmm0, xmm1,  32,   32, 17, 15)
+        STEP(F1, xmm1, xmm2, xmm3, xmm0,  48,   48, 22, 10)
+        STEP(F1, xmm0, xmm1, xmm2, xmm3,  64,   64,  7, 25)
+        STEP(F1, xmm3, xmm0, xmm1, xmm2,  80,   80, 12, 20)
+        STEP(F1, xmm2, xmm3, xmm0, xmm1,  96,   96, 17, 15)
+        STEP(F1, xmm1, xmm2, xmm3, xmm0, 112,  112, 22, 10)
+        STEP(F1, xmm0, xmm1, xmm2, xmm3, 128,  128,  7, 25)
+        STEP(F1, xmm3, xmm0, xmm1, xmm2, 144,  144, 12, 20)
+        STEP(F1, xmm2, xmm3, xmm0, xmm1, 160,  160, 17, 15)
+        STEP(F1, xmm1, xmm2, xmm3, xmm0, 176,  176, 22, 10)
+        STEP(F1, xmm0, xmm1, xmm2, xmm3, 192,  192,  7, 25)
+        STEP(F1, xmm3, xmm0, xmm1, xmm2, 208,  208, 12, 20)
+        STEP(F1, xmm2, xmm3, xmm0, xmm1, 224,  224, 17, 15)
+        STEP(F1, xmm1, xmm2, xmm3, xmm0, 240,  240, 22, 10)
+        STEP(F2, xmm0, xmm1, xmm2, xmm3,  16,  256,  5, 27)
+        STEP(F2, xmm3, xmm0, xmm1, xmm2,  96,  272,  9, 23)
+        STEP(F2, xmm2, xmm3, xmm0, xmm1, 176,  288, 14, 18)
+        STEP(F2, xmm1, xmm2, xmm3, xmm0,   0,  304, 20, 12)
+        STEP(F2, xmm0, xmm1, xmm2, xmm3,  80,  320,  5, 27)
+        STEP(F2, xmm3, xmm0, xmm1, xmm2, 160,  336,  9, 23)
+        STEP(F2, xmm2, xmm3, xmm0, xmm1, 240,  352, 14, 18)
+        STEP(F2, xmm1, xmm2, xmm3, xmm0,  64,  368, 20, 12)
+        STEP(F2, xmm0, xmm1, xmm2, xmm3, 144,  384,  5, 27)
+        STEP(F2, xmm3, xmm0, xmm1, xmm2, 224,  400,  9, 23)
+        STEP(F2, xmm2, xmm3, xmm0, xmm1,  48,  416, 14, 18)
+        STEP(F2, xmm1, xmm2, xmm3, xmm0, 128,  432, 20, 12)
+        STEP(F2, xmm0, xmm1, xmm2, xmm3, 208,  448,  5, 27)
+        STEP(F2, xmm3, xmm0, xmm1, xmm2,  32,  464,  9, 23)
+        STEP(F2, xmm2, xmm3, xmm0, xmm1, 112,  480, 14, 18)
+        STEP(F2, xmm1, xmm2, xmm3, xmm0, 192,  496, 20, 12)
+        STEP(F3, xmm0, xmm1, xmm2, xmm3,  80,  512,  4, 28)
+        STEP(F3, xmm3, xmm0, xmm1, xmm2, 128,  528, 11, 21)
+        STEP(F3, xmm2, xmm3, xmm0, xmm1, 176,  544, 16, 16)
+        STEP(F3, xmm1, xmm2, xmm3, xmm0, 224,  560, 23,  9)
+        STEP(F3, xmm0, xmm1, xmm2, xmm3,  16,  576,  4, 28)
+        STEP(F3, xmm3, xmm0, xmm1, xmm2,  64,  592, 11, 21)
+        STEP(F3, xmm2, xmm3, xmm0, xmm1, 112,  608, 16, 16)
+        STEP(F3, xmm1, xmm2, xmm3, xmm0, 160,  624, 23,  9)
+        STEP(F3, xmm0, xmm1, xmm2, xmm3, 208,  640,  4, 28)
+        STEP(F3, xmm3, xmm0, xmm1, xmm2,   0,  656, 11, 21)
+        STEP(F3, xmm2, xmm3, xmm0, xmm1,  48,  672, 16, 16)
+        STEP(F3, xmm1, xmm2, xmm3, xmm0,  96,  688, 23,  9)
+        STEP(F3, xmm0, xmm1, xmm2, xmm3, 144,  704,  4, 28)
+        STEP(F3, xmm3, xmm0, xmm1, xmm2, 192,  720, 11, 21)
+        STEP(F3, xmm2, xmm3, xmm0, xmm1, 240,  736, 16, 16)
+        STEP(F3, xmm1, xmm2, xmm3, xmm0,  32,  752, 23,  9)
+        STEP(F4, xmm0, xmm1, xmm2, xmm3,   0,  768,  6, 26)
+        STEP(F4, xmm3, xmm0, xmm1, xmm2, 112,  784, 10, 22)
+        STEP(F4, xmm2, xmm3, xmm0, xmm1, 224,  800, 15, 17)
+        STEP(F4, xmm1, xmm2, xmm3, xmm0,  80,  816, 21, 11)
+        STEP(F4, xmm0, xmm1, xmm2, xmm3, 192,  832,  6, 26)
+        STEP(F4, xmm3, xmm0, xmm1, xmm2,  48,  848, 10, 22)
+        STEP(F4, xmm2, xmm3, xmm0, xmm1, 160,  864, 15, 17)
+        STEP(F4, xmm1, xmm2, xmm3, xmm0,  16,  880, 21, 11)
+        STEP(F4, xmm0, xmm1, xmm2, xmm3, 128,  896,  6, 26)
+        STEP(F4, xmm3, xmm0, xmm1, xmm2, 240,  912, 10, 22)
+        STEP(F4, xmm2, xmm3, xmm0, xmm1,  96,  928, 15, 17)
+        STEP(F4, xmm1, xmm2, xmm3, xmm0, 208,  944, 21, 11)
+        STEP(F4, xmm0, xmm1, xmm2, xmm3,  64,  960,  6, 26)
+        STEP(F4, xmm3, xmm0, xmm1, xmm2, 176,  976, 10, 22)
+        STEP(F4, xmm2, xmm3, xmm0, xmm1,  32,  992, 15, 17)
+        STEP(F4, xmm1, xmm2, xmm3, xmm0, 144, 1008, 21, 11)
+        "paddd       (%0), %%xmm0               \n\t"
+        "paddd     16(%0), %%xmm1               \n\t"
+        "paddd     32(%0), %%xmm2               \n\t"
+        "paddd     48(%0), %%xmm3               \n\t"
+        "movdqa    %%xmm0,   (%0)               \n\t"
+        "movdqa    %%xmm1, 16(%0)               \n\t"
+        "movdqa    %%xmm2, 32(%0)               \n\t"
+        "movdqa    %%xmm3, 48(%0)               \n\t"
+        :
+        : "r"(state), "r"(x), "r"(T)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm7",)
+          "memory"
+    );
+}
+
+#endif /* HAVE_SSE2_INLINE */
+
+int ff_md5_blocks_x4_x86(uint32_t *abcd[4], const uint8_t *src[4], int nblocks)
+{
+#if HAVE_SSE2_INLINE
+    LOCAL_ALIGNED_16(uint32_t, state, [4 * 4]);
+    LOCAL_ALIGNED_16(uint32_t, x, [16 * 4]);
+    int i, j, n;
+
+    if (!INLINE_SSE2(av_get_cpu_flags()))
+        return 0;
+
+    /* state holds the a, b, c and d vectors, x the message words */
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            state[4 * i + j] = abcd[j][3 - i];
+
+    for (n = 0; n < nblocks; n++) {
+        for (i = 0; i < 16; i++)
+            for (j = 0; j < 4; j++)
+                x[4 * i + j] = AV_RL32(src[j] + 64 * n + 4 * i);
+        md5_block_x4(state, x);
+    }
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            abcd[j][3 - i] = state[4 * i + j];
+
+    return nblocks;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,236 @@
+/*
+ * SHA-1 and SHA-256 with the SHA extensions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/sha_internal.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+
+#if HAVE_SHANI_INLINE
+
+DECLARE_ASM_CONST(16, uint8_t, bswap_128)[16] = {
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+DECLARE_ASM_CONST(16, uint8_t, bswap_32)[16] = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+DECLARE_ASM_CONST(16, uint32_t, K256)[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * SHA-1: xmm0 holds ABCD with A in the top dword, xmm1/xmm2 alternate as
+ * E, xmm3-xmm6 hold the message schedule and xmm7 the byte swap mask.
+ * Group g does rounds 4*g to 4*g+3, the schedule of the groups g+1 to g+3
+ * is advanced along with it.
+ */
+#define SHA1_LOAD(m, off)                                           \
+    "movdqu    "#off"(%1), %%"#m"                       \n\t"       \
+    "pshufb    %%xmm7, %%"#m"                           \n\t"
+
+#define SHA1_ROUNDS(e0, e1, f)                                      \
+    "movdqa    %%xmm0, %%"#e1"                          \n\t"       \
+    "sha1rnds4 $"#f", %%"#e0", %%xmm0                   \n\t"
+
+#define SHA1_GROUP(g, e0, e1, f, m0, m1, m2, m3)                    \
+    "sha1nexte %%"#m0", %%"#e0"                         \n\t"       \
+    "movdqa    %%xmm0, %%"#e1"                          \n\t"       \
+    "sha1msg2  %%"#m0", %%"#m1"                         \n\t"       \
+    "sha1rnds4 $"#f", %%"#e0", %%xmm0                   \n\t"       \
+    "sha1msg1  %%"#m0", %%"#m3"                         \n\t"       \
+    "pxor      %%"#m0", %%"#m2"                         \n\t"
+
+static void sha1_transform_shani(uint32_t *state, const uint8_t buffer[64])
+{
+    __asm__ volatile(
+        "movdqu    (%0), %%xmm0                         \n\t"
+        "movd      16(%0), %%xmm1                       \n\t"
+        "pshufd    $0x1b, %%xmm0, %%xmm0                \n\t"
+        "pslldq    $12, %%xmm1                          \n\t"
+        "movdqa    %2, %%xmm7                           \n\t"
+        /* rounds 0-15, the schedule starts up */
+        SHA1_LOAD(xmm3,  0)
+        "paddd     %%xmm3, %%xmm1                       \n\t"
+        SHA1_ROUNDS(xmm1, xmm2, 0)
+        SHA1_LOAD(xmm4, 16)
+        "sha1nexte %%xmm4, %%xmm2                       \n\t"
+        SHA1_ROUNDS(xmm2, xmm1, 0)
+        "sha1msg1  %%xmm4, %%xmm3                       \n\t"
+        SHA1_LOAD(xmm5, 32)
+        "sha1nexte %%xmm5, %%xmm1                       \n\t"
+        SHA1_ROUNDS(xmm1, xmm2, 0)
+        "sha1msg1  %%xmm5, %%xmm4                       \n\t"
+        "pxor      %%xmm5, %%xmm3                       \n\t"
+        SHA1_LOAD(xmm6, 48)
+        "sha1nexte %%xmm6, %%xmm2                       \n\t"
+        "movdqa    %%xmm0, %%xmm1                       \n\t"
+        "sha1msg2  %%xmm6, %%xmm3                       \n\t"
+        "sha1rnds4 $0, %%xmm2, %%xmm0                   \n\t"
+        "sha1msg1  %%xmm6, %%xmm5                       \n\t"
+        "pxor      %%xmm6, %%xmm4                       \n\t"
+        /* rounds 16-67 */
+        SHA1_GROUP( 4, xmm1, xmm2, 0, xmm3, xmm4, xmm5, xmm6)
+        SHA1_GROUP( 5, xmm2, xmm1, 1, xmm4, xmm5, xmm6, xmm3)
+        SHA1_GROUP( 6, xmm1, xmm2, 1, xmm5, xmm6, xmm3, xmm4)
+        SHA1_GROUP( 7, xmm2, xmm1, 1, xmm6, xmm3, xmm4, xmm5)
+        SHA1_GROUP( 8, xmm1, xmm2, 1, xmm3, xmm4, xmm5, xmm6)
+        SHA1_GROUP( 9, xmm2, xmm1, 1, xmm4, xmm5, xmm6, xmm3)
+        SHA1_GROUP(10, xmm1, xmm2, 2, xmm5, xmm6, xmm3, xmm4)
+        SHA1_GROUP(11, xmm2, xmm1, 2, xmm6, xmm3, xmm4, xmm5)
+        SHA1_GROUP(12, xmm1, xmm2, 2, xmm3, xmm4, xmm5, xmm6)
+        SHA1_GROUP(13, xmm2, xmm1, 2, xmm4, xmm5, xmm6, xmm3)
+        SHA1_GROUP(14, xmm1, xmm2, 2, xmm5, xmm6, xmm3, xmm4)
+        SHA1_GROUP(15, xmm2, xmm1, 3, xmm6, xmm3, xmm4, xmm5)
+        SHA1_GROUP(16, xmm1, xmm2, 3, xmm3, xmm4, xmm5, xmm6)
+        /* rounds 68-79, the schedule winds down */
+        "sha1nexte %%xmm4, %%xmm2                       \n\t"
+        "movdqa    %%xmm0, %%xmm1                       \n\t"
+        "sha1msg2  %%xmm4, %%xmm5                       \n\t"
+        "sha1rnds4 $3, %%xmm2, %%xmm0                   \n\t"
+        "pxor      %%xmm4, %%xmm6                       \n\t"
+        "sha1nexte %%xmm5, %%xmm1                       \n\t"
+        "movdqa    %%xmm0, %%xmm2                       \n\t"
+        "sha1msg2  %%xmm5, %%xmm6                       \n\t"
+        "sha1rnds4 $3, %%xmm1, %%xmm0                   \n\t"
+        "sha1nexte %%xmm6, %%xmm2                       \n\t"
+        "movdqa    %%xmm0, %%xmm1                       \n\t"
+        "sha1rnds4 $3, %%xmm2, %%xmm0                   \n\t"
+        /* add the previous state */
+        "movd      16(%0), %%xmm2                       \n\t"
+        "pslldq    $12, %%xmm2                          \n\t"
+        "sha1nexte %%xmm2, %%xmm1                       \n\t"
+        "movdqu    (%0), %%xmm2                         \n\t"
+        "pshufd    $0x1b, %%xmm0, %%xmm0                \n\t"
+        "paddd     %%xmm2, %%xmm0                       \n\t"
+        "pshufd    $0xff, %%xmm1, %%xmm1                \n\t"
+        "movdqu    %%xmm0, (%0)                         \n\t"
+        "movd      %%xmm1, 16(%0)                       \n\t"
+        :
+        : "r"(state), "r"(buffer), "m"(*bswap_128)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+}
+
+/*
+ * SHA-256: xmm1 holds ABEF and xmm2 CDGH, xmm3-xmm6 hold the message
+ * schedule and sha256rnds2 takes the round inputs in xmm0.
+ */
+#define SHA256_ROUNDS(m, off)                                       \
+    "movdqa    "#off"(%2), %%xmm0                       \n\t"       \
+    "paddd     %%"#m", %%xmm0                           \n\t"       \
+    "sha256rnds2 %%xmm0, %%xmm1, %%xmm2                 \n\t"       \
+    "pshufd    $0x0e, %%xmm0, %%xmm0                    \n\t"       \
+    "sha256rnds2 %%xmm0, %%xmm2, %%xmm1                 \n\t"
+
+#define SHA256_LOAD(m, off)                                         \
+    "movdqu    "#off"(%1), %%"#m"                       \n\t"       \
+    "pshufb    %%xmm7, %%"#m"                           \n\t"       \
+    SHA256_ROUNDS(m, off)
+
+/* m0 holds W[t-16..t-13] and becomes W[t..t+3] */
+#define SHA256_GROUP(m0, m1, m2, m3, off)                           \
+    "sha256msg1 %%"#m1", %%"#m0"                        \n\t"       \
+    "movdqa    %%"#m3", %%xmm7                          \n\t"       \
+    "palignr   $4, %%"#m2", %%xmm7                      \n\t"       \
+    "paddd     %%xmm7, %%"#m0"                          \n\t"       \
+    "sha256msg2 %%"#m3", %%"#m0"                        \n\t"       \
+    SHA256_ROUNDS(m0, off)
+
+static void sha256_transform_shani(uint32_t *state, const uint8_t buffer[64])
+{
+    __asm__ volatile(
+        "movdqu    (%0), %%xmm7                         \n\t"
+        "movdqu    16(%0), %%xmm2                       \n\t"
+        "pshufd    $0xb1, %%xmm7, %%xmm7                \n\t"
+        "pshufd    $0x1b, %%xmm2, %%xmm2                \n\t"
+        "movdqa    %%xmm7, %%xmm1                       \n\t"
+        "palignr   $8, %%xmm2, %%xmm1                   \n\t"
+        "pblendw   $0xf0, %%xmm7, %%xmm2                \n\t"
+        "movdqa    %3, %%xmm7                           \n\t"
+        SHA256_LOAD(xmm3,  0)
+        SHA256_LOAD(xmm4, 16)
+        SHA256_LOAD(xmm5, 32)
+        SHA256_LOAD(xmm6, 48)
+        SHA256_GROUP(xmm3, xmm4, xmm5, xmm6,  64)
+        SHA256_GROUP(xmm4, xmm5, xmm6, xmm3,  80)
+        SHA256_GROUP(xmm5, xmm6, xmm3, xmm4,  96)
+        SHA256_GROUP(xmm6, xmm3, xmm4, xmm5, 112)
+        SHA256_GROUP(xmm3, xmm4, xmm5, xmm6, 128)
+        SHA256_GROUP(xmm4, xmm5, xmm6, xmm3, 144)
+        SHA256_GROUP(xmm5, xmm6, xmm3, xmm4, 160)
+        SHA256_GROUP(xmm6, xmm3, xmm4, xmm5, 176)
+        SHA256_GROUP(xmm3, xmm4, xmm5, xmm6, 192)
+        SHA256_GROUP(xmm4, xmm5, xmm6, xmm3, 208)
+        SHA256_GROUP(xmm5, xmm6, xmm3, xmm4, 224)
+        SHA256_GROUP(xmm6, xmm3, xmm4, xmm5, 240)
+        /* back to ABCD and EFGH and add the previous state */
+        "pshufd    $0x1b, %%xmm1, %%xmm7                \n\t"
+        "pshufd    $0xb1, %%xmm2, %%xmm2                \n\t"
+        "movdqa    %%xmm7, %%xmm1                       \n\t"
+        "pblendw   $0xf0, %%xmm2, %%xmm1                \n\t"
+        "palignr   $8, %%xmm7, %%xmm2                   \n\t"
+        "movdqu    (%0), %%xmm7                         \n\t"
+        "paddd     %%xmm7, %%xmm1                       \n\t"
+        "movdqu    16(%0), %%xmm7                       \n\t"
+        "paddd     %%xmm7, %%xmm2                       \n\t"
+        "movdqu    %%xmm1, (%0)                         \n\t"
+        "movdqu    %%xmm2, 16(%0)                       \n\t"
+        :
+        : "r"(state), "r"(buffer), "r"(K256), "m"(*bswap_32)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+}
+
+#endif /* HAVE_SHANI_INLINE */
+
+av_cold void ff_sha_init_x86(AVSHA *ctx, int bits)
+{
+#if HAVE_SHANI_INLINE
+    int cpu_flags = av_get_cpu_flags();
+
+    if (INLINE_SHANI(cpu_flags))
+        ctx->transform = bits == 160 ? sha1_transform_shani
+                                     : sha256_transform_shani;
+#endif
+}
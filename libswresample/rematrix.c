@@ -390,6 +390,9 @@ av_cold int swri_rematrix_init(SwrContext *s){
         s->mix_1_1_f = (mix_1_1_func_type*)copy_float;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_float;
         s->mix_any_f = (mix_any_func_type*)get_mix_any_func_float(s);
+        s->fdsp = avpriv_float_dsp_alloc(0);
+        if (!s->fdsp)
+            return AVERROR(ENOMEM);
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_DBLP){
         s->native_matrix = av_calloc(nb_in * nb_out, sizeof(double));
         s->native_one    = av_mallocz(sizeof(double));
@@ -402,6 +405,9 @@ av_cold int swri_rematrix_init(SwrContext *s){
         s->mix_1_1_f = (mix_1_1_func_type*)copy_double;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_double;
         s->mix_any_f = (mix_any_func_type*)get_mix_any_func_double(s);
+        s->fdsp = avpriv_float_dsp_alloc(0);
+        if (!s->fdsp)
+            return AVERROR(ENOMEM);
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_S32P){
         // Only for dithering currently
 //         s->native_matrix = av_calloc(nb_in * nb_out, sizeof(double));
@@ -438,9 +444,25 @@ av_cold void swri_rematrix_free(SwrContext *s){
     av_freep(&s->native_matrix);
     av_freep(&s->native_one);
     av_freep(&s->native_simd_matrix);
+    av_freep(&s->fdsp);
     av_freep(&s->native_simd_one);
 }
 
+/**
+ * Return the number of leading samples of output channel out_i that can be
+ * mixed with the float DSP functions, which need aligned planes.
+ */
+static int dsp_mix_len(SwrContext *s, AudioData *out, AudioData *in, int out_i, int len){
+    int j;
+
+    if(!s->fdsp || ((intptr_t)out->ch[out_i] & 31))
+        return 0;
+    for(j=0; j<s->matrix_ch[out_i][0]; j++)
+        if((intptr_t)in->ch[s->matrix_ch[out_i][1+j]] & 31)
+            return 0;
+    return len & ~15;
+}
+
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy){
     int out_i, in_i, i, j;
     int len1 = 0;
@@ -490,7 +512,16 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
             break;}
         default:
             if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP){
-                for(i=0; i<len; i++){
+                int dsp_len = dsp_mix_len(s, out, in, out_i, len);
+                if(dsp_len){
+                    in_i= s->matrix_ch[out_i][1];
+                    s->fdsp->vector_fmul_scalar((float*)out->ch[out_i], (const float*)in->ch[in_i], s->matrix[out_i][in_i], dsp_len);
+                    for(j=1; j<s->matrix_ch[out_i][0]; j++){
+                        in_i= s->matrix_ch[out_i][1+j];
+                        s->fdsp->vector_fmac_scalar((float*)out->ch[out_i], (const float*)in->ch[in_i], s->matrix[out_i][in_i], dsp_len);
+                    }
+                }
+                for(i=dsp_len; i<len; i++){
                     float v=0;
                     for(j=0; j<s->matrix_ch[out_i][0]; j++){
                         in_i= s->matrix_ch[out_i][1+j];
@@ -499,7 +530,16 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
                     ((float*)out->ch[out_i])[i]= v;
                 }
             }else if(s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
-                for(i=0; i<len; i++){
+                int dsp_len = dsp_mix_len(s, out, in, out_i, len);
+                if(dsp_len){
+                    in_i= s->matrix_ch[out_i][1];
+                    s->fdsp->vector_dmul_scalar((double*)out->ch[out_i], (const double*)in->ch[in_i], s->matrix[out_i][in_i], dsp_len);
+                    for(j=1; j<s->matrix_ch[out_i][0]; j++){
+                        in_i= s->matrix_ch[out_i][1+j];
+                        s->fdsp->vector_dmac_scalar((double*)out->ch[out_i], (const double*)in->ch[in_i], s->matrix[out_i][in_i], dsp_len);
+                    }
+                }
+                for(i=dsp_len; i<len; i++){
                     double v=0;
                     for(j=0; j<s->matrix_ch[out_i][0]; j++){
                         in_i= s->matrix_ch[out_i][1+j];
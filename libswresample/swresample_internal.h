@@ -23,6 +23,7 @@
 
 #include "swresample.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/float_dsp.h"
 #include "config.h"
 
 #define SWR_CH_MAX 64
@@ -180,6 +181,7 @@ struct SwrContext {
     mix_2_1_func_type *mix_2_1_simd;
 
     mix_any_func_type *mix_any_f;
+    AVFloatDSPContext *fdsp;                        ///< float DSP functions for the generic FLTP/DBLP mixing paths
 
     /* TODO: callbacks for ASM optimizations */
 };
@@ -249,6 +249,30 @@ gapless(){
     do_md5sum $decfile3
 }
 
+fastinfo(){
+    sample=$(target_path $1)
+    remux_fmt=$2
+
+    if [ -n "$remux_fmt" ]; then
+        remuxed="${outdir}/${test}.${remux_fmt}"
+        cleanfiles="$cleanfiles $remuxed"
+        # put the parameter sets of raw streams into the extradata
+        ffmpeg -i "$sample" -c copy -f $remux_fmt -y $remuxed || return
+        sample=$remuxed
+    fi
+
+    fastlog="${outdir}/${test}.fastlog"
+    cleanfiles="$cleanfiles $fastlog"
+    entries="stream=width,height,pix_fmt,profile,level"
+
+    # the parameters taken from the headers must match the decoded ones
+    slow=$(run ffprobe${PROGSUF} -show_entries $entries -select_streams v -v 0 "$sample")
+    fast=$(run ffprobe${PROGSUF} -show_entries $entries -select_streams v -v debug -fflags fastinfo "$sample" 2>$fastlog)
+    test -n "$slow" || { echo "no video stream found"; return 1; }
+    grep -q "parameters taken from the headers" $fastlog || { echo "fastinfo not used"; return 1; }
+    test "$slow" = "$fast" || printf "normal:\n%s\nfastinfo:\n%s\n" "$slow" "$fast"
+}
+
 mkdir -p "$outdir"
 
 # Disable globbing: command arguments may contain globbing characters and
@@ -199,8 +199,13 @@ FATE_H264-$(call DEMDEC,  MOV, H264) += fate-h264-interlace-crop
 FATE_H264-$(call ALLYES, MOV_DEMUXER H264_MP4TOANNEXB_BSF) += fate-h264-bsf-mp4toannexb
 FATE_H264-$(call DEMDEC, MATROSKA, H264) += fate-h264-direct-bff
 
+FATE_H264_FASTINFO-$(call DEMDEC,  MOV, H264) += fate-h264-fastinfo-crop-to-container
+FATE_H264_FASTINFO-$(call DEMDEC,  MOV, H264) += fate-h264-fastinfo-interlace-crop
+FATE_H264_FASTINFO-$(call DEMDEC, MATROSKA, H264) += fate-h264-fastinfo-direct-bff
+
 FATE_SAMPLES_AVCONV += $(FATE_H264-yes)
-fate-h264: $(FATE_H264-yes)
+FATE_SAMPLES_FFPROBE += $(FATE_H264_FASTINFO-yes)
+fate-h264: $(FATE_H264-yes) $(FATE_H264_FASTINFO-yes)
 
 fate-h264-conformance-aud_mw_e:                   CMD = framecrc -vsync drop -i $(TARGET_SAMPLES)/h264-conformance/AUD_MW_E.264
 fate-h264-conformance-ba1_ft_c:                   CMD = framecrc -vsync drop -i $(TARGET_SAMPLES)/h264-conformance/BA1_FT_C.264
@@ -394,4 +399,9 @@ fate-h264-interlace-crop:                         CMD = framecrc -i $(TARGET_SAM
 fate-h264-lossless:                               CMD = framecrc -i $(TARGET_SAMPLES)/h264/lossless.h264
 fate-h264-direct-bff:                             CMD = framecrc -i $(TARGET_SAMPLES)/h264/direct-bff.mkv
 
+fate-h264-fastinfo-%: REF = /dev/null
+fate-h264-fastinfo-crop-to-container:             CMD = fastinfo $(TARGET_SAMPLES)/h264/crop-to-container-dims-canon.mov
+fate-h264-fastinfo-interlace-crop:                CMD = fastinfo $(TARGET_SAMPLES)/h264/interlaced_crop.mp4
+fate-h264-fastinfo-direct-bff:                    CMD = fastinfo $(TARGET_SAMPLES)/h264/direct-bff.mkv
+
 fate-h264-reinit-%:                               CMD = framecrc -i $(TARGET_SAMPLES)/h264/$(@:fate-h264-%=%).h264 -vf format=yuv444p10le,scale=w=352:h=288
@@ -229,4 +229,18 @@ FATE_HEVC-$(call DEMDEC, HEVC, HEVC) += $(FATE_HEVC)
 
 FATE_SAMPLES_AVCONV += $(FATE_HEVC-yes)
 
-fate-hevc: $(FATE_HEVC-yes)
+# the raw streams are remuxed so that the parameter sets end up in the extradata
+fate-hevc-fastinfo-%: REF = /dev/null
+fate-hevc-fastinfo-%: CMD = fastinfo $(TARGET_SAMPLES)/hevc-conformance/$(@:fate-hevc-fastinfo-%=%).bit matroska
+
+FATE_HEVC_FASTINFO = fate-hevc-fastinfo-AMP_A_Samsung_4                        \
+                     fate-hevc-fastinfo-WPP_A_ericsson_MAIN10_2                \
+                     fate-hevc-fastinfo-ADJUST_IPRED_ANGLE_A_RExt_Mitsubishi_1 \
+                     fate-hevc-fastinfo-IPCM_B_RExt_NEC                        \
+
+FATE_HEVC_FASTINFO-$(call ALLYES, HEVC_DEMUXER HEVC_PARSER HEVC_DECODER MATROSKA_MUXER MATROSKA_DEMUXER) += $(FATE_HEVC_FASTINFO)
+$(FATE_HEVC_FASTINFO-yes): ffmpeg$(PROGSSUF)$(EXESUF)
+
+FATE_SAMPLES_FFPROBE += $(FATE_HEVC_FASTINFO-yes)
+
+fate-hevc: $(FATE_HEVC-yes) $(FATE_HEVC_FASTINFO-yes)
@@ -107,6 +107,14 @@ FATE_LIBAVUTIL += fate-sha512
 fate-sha512: libavutil/sha512-test$(EXESUF)
 fate-sha512: CMD = run libavutil/sha512-test
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-threadmessage
+fate-threadmessage: libavutil/threadmessage-test$(EXESUF)
+fate-threadmessage: CMD = run libavutil/threadmessage-test
+
+FATE_LIBAVUTIL-$(HAVE_PTHREADS) += fate-trace
+fate-trace: libavutil/trace-test$(EXESUF)
+fate-trace: CMD = run libavutil/trace-test
+
 FATE_LIBAVUTIL += fate-tree
 fate-tree: libavutil/tree-test$(EXESUF)
 fate-tree: CMD = run libavutil/tree-test